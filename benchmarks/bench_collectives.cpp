@@ -0,0 +1,183 @@
+// MPI benchmarks; run the same binary on every rank, for example
+//   mpirun -np 4 ./dml_mpi_benchmarks --benchmark_out=np4.json --benchmark_out_format=json
+// Every rank executes each benchmark for a fixed number of iterations so
+// collectives stay matched. The slowest rank's time is reported, and only
+// rank 0 prints or writes results.
+#include <benchmark/benchmark.h>
+#include <mpi.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include "../include/communicator_topology.h"
+#include "../include/distributed_trainer.h"
+#include "../include/gradient_bucketer.h"
+
+namespace DistributedML {
+namespace {
+
+// Bucket settings matching the trainer defaults
+constexpr std::size_t kBucketElements = (1 << 20) / sizeof(double);
+constexpr std::size_t kMaxBucketsInFlight = 8;
+
+std::unique_ptr<CommunicatorTopology> g_topology;
+std::unique_ptr<DistributedTrainer> g_trainer;
+
+// Wall time of one iteration on the slowest rank
+double slowestRank(double seconds) {
+    double slowest = 0.0;
+    MPI_Allreduce(&seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, g_topology->communicator());
+    return slowest;
+}
+
+// Enough iterations for stable numbers without letting large sizes dominate
+int64_t iterationsFor(std::size_t bytes) {
+    return std::clamp<int64_t>(static_cast<int64_t>((std::size_t{256} << 20) / std::max<std::size_t>(bytes, 1)),
+                               5, 500);
+}
+
+// What DistributedTrainer::aggregateGradients waits on: one step's gradient
+// streamed through the bucketer and reduced across all ranks. Reports
+// algorithm bandwidth (gradient bytes / time) and bus bandwidth, which
+// scales it by 2(n-1)/n to compare with the link speed.
+void BM_AggregateGradients(benchmark::State& state, CompressionMode mode) {
+    const auto elements = static_cast<Eigen::Index>(state.range(0));
+    GradientBucketer bucketer(*g_topology, kBucketElements, kMaxBucketsInFlight, mode);
+
+    std::mt19937 generator(static_cast<uint32_t>(g_topology->rank()));
+    std::normal_distribution<double> value(0.0, 1e-3);
+    Eigen::VectorXd gradient(elements);
+    for (Eigen::Index i = 0; i < elements; ++i) {
+        gradient[i] = value(generator);
+    }
+
+    MPI_Barrier(g_topology->communicator());
+    for (auto _ : state) {
+        double start = MPI_Wtime();
+        bucketer.beginStep(elements);
+        bucketer.append(gradient);
+        const Eigen::VectorXd& sum = bucketer.finishStep();
+        benchmark::DoNotOptimize(sum.data());
+        state.SetIterationTime(slowestRank(MPI_Wtime() - start));
+    }
+
+    const double ranks = g_topology->size();
+    const double bytes = static_cast<double>(elements) * sizeof(double);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes) * state.iterations());
+    state.counters["ranks"] = ranks;
+    state.counters["nodes"] = g_topology->nodeCount();
+    state.counters["bus_bandwidth"] = benchmark::Counter(
+        bytes * 2.0 * (ranks - 1.0) / ranks,
+        benchmark::Counter::kIsIterationInvariantRate,
+        benchmark::Counter::kIs1024
+    );
+}
+
+// Root packs and scatters N 28x28 grayscale images with labels
+void BM_DistributeData(benchmark::State& state) {
+    const auto samples = static_cast<size_t>(state.range(0));
+    std::vector<cv::Mat> images;
+    std::vector<int32_t> labels;
+    if (g_topology->rank() == 0) {
+        images.reserve(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            images.emplace_back(28, 28, CV_8UC1);
+            cv::randu(images.back(), 0, 255);
+        }
+        labels.assign(samples, 0);
+    }
+
+    MPI_Barrier(g_topology->communicator());
+    for (auto _ : state) {
+        double start = MPI_Wtime();
+        g_trainer->distributeData(images, labels);
+        state.SetIterationTime(slowestRank(MPI_Wtime() - start));
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(samples) * state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(samples * 28 * 28 * sizeof(float)) * state.iterations());
+    state.counters["ranks"] = g_topology->size();
+}
+
+void registerBenchmarks() {
+    const std::pair<const char*, CompressionMode> modes[] = {
+        {"none", CompressionMode::None},
+        {"fp16", CompressionMode::FP16},
+        {"int8", CompressionMode::Int8},
+        {"topk", CompressionMode::TopK}
+    };
+    for (const auto& [name, mode] : modes) {
+        // 8 KiB to 32 MiB of gradient per step
+        for (int64_t elements = 1 << 10; elements <= (1 << 22); elements *= 4) {
+            benchmark::RegisterBenchmark(
+                (std::string("BM_AggregateGradients/") + name).c_str(),
+                BM_AggregateGradients,
+                mode
+            )
+                ->Arg(elements)
+                ->Iterations(iterationsFor(static_cast<std::size_t>(elements) * sizeof(double)))
+                ->UseManualTime()
+                ->Unit(benchmark::kMicrosecond);
+        }
+    }
+
+    for (int64_t samples : {1000, 10000, 60000}) {
+        benchmark::RegisterBenchmark("BM_DistributeData", BM_DistributeData)
+            ->Arg(samples)
+            ->Iterations(iterationsFor(static_cast<std::size_t>(samples) * 28 * 28 * sizeof(float)))
+            ->UseManualTime()
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+// Swallows output on ranks other than 0
+class NullReporter : public benchmark::BenchmarkReporter {
+public:
+    bool ReportContext(const Context&) override { return true; }
+    void ReportRuns(const std::vector<Run>&) override {}
+};
+
+} // namespace
+} // namespace DistributedML
+
+int main(int argc, char** argv) {
+    using namespace DistributedML;
+
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &threadSupport);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Only rank 0 may write the --benchmark_out file
+    std::vector<char*> arguments;
+    for (int i = 0; i < argc; ++i) {
+        if (rank == 0 || std::strncmp(argv[i], "--benchmark_out", 15) != 0) {
+            arguments.push_back(argv[i]);
+        }
+    }
+    int argumentCount = static_cast<int>(arguments.size());
+    benchmark::Initialize(&argumentCount, arguments.data());
+
+    g_topology = std::make_unique<CommunicatorTopology>(MPI_COMM_WORLD);
+    g_trainer = std::make_unique<DistributedTrainer>(argc, argv);
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+
+    registerBenchmarks();
+    if (rank == 0) {
+        benchmark::RunSpecifiedBenchmarks();
+    } else {
+        NullReporter reporter;
+        benchmark::RunSpecifiedBenchmarks(&reporter);
+    }
+    benchmark::Shutdown();
+
+    g_trainer.reset();
+    g_topology.reset();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+#include <cpprest/http_client.h>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include "../include/dashboard_server.h"
+
+namespace DistributedML {
+namespace {
+
+// Tasks created before timing, so /tasks returns a realistic payload
+constexpr int kPreloadedTasks = 100;
+
+// Listening address; override with DML_BENCH_DASHBOARD_URL when the
+// default port is taken
+std::string dashboardUrl() {
+    const char* url = std::getenv("DML_BENCH_DASHBOARD_URL");
+    return url ? url : "http://127.0.0.1:18080";
+}
+
+// One server and client shared by every dashboard benchmark
+struct DashboardFixture {
+    TaskManager tasks;
+    DashboardServer server;
+    web::http::client::http_client client;
+
+    DashboardFixture()
+        : server(dashboardUrl(), tasks),
+          client(dashboardUrl()) {
+        server.start();
+        for (int i = 0; i < kPreloadedTasks; ++i) {
+            web::json::value body;
+            body[U("type")] = web::json::value::string(U("training"));
+            client.request(web::http::methods::POST, U("/tasks"), body).wait();
+        }
+    }
+
+    ~DashboardFixture() {
+        server.stop();
+    }
+};
+
+DashboardFixture& fixture() {
+    static DashboardFixture instance;
+    return instance;
+}
+
+// Round trip of one request over loopback, body included
+void requestLatency(benchmark::State& state, const web::http::method& method, const std::string& path) {
+    auto& client = fixture().client;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        web::http::http_response response = client.request(method, path).get();
+        if (response.status_code() != web::http::status_codes::OK) {
+            state.SkipWithError("dashboard returned an error status");
+            break;
+        }
+        bytes += response.extract_string().get().size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+void BM_DashboardGetTasks(benchmark::State& state) {
+    requestLatency(state, web::http::methods::GET, "/tasks");
+}
+BENCHMARK(BM_DashboardGetTasks)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Repeated poll by a client that already holds the current ETag
+void BM_DashboardGetTasksNotModified(benchmark::State& state) {
+    auto& client = fixture().client;
+    web::http::http_response first = client.request(web::http::methods::GET, U("/tasks")).get();
+    std::string etag = first.headers()[web::http::header_names::etag];
+    for (auto _ : state) {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(U("/tasks"));
+        request.headers().add(web::http::header_names::if_none_match, etag);
+        web::http::http_response response = client.request(request).get();
+        if (response.status_code() != web::http::status_codes::NotModified) {
+            state.SkipWithError("dashboard did not answer 304");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DashboardGetTasksNotModified)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+void BM_DashboardGetPerformance(benchmark::State& state) {
+    requestLatency(state, web::http::methods::GET, "/performance");
+}
+BENCHMARK(BM_DashboardGetPerformance)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+void BM_DashboardCreateTask(benchmark::State& state) {
+    auto& client = fixture().client;
+    web::json::value body;
+    body[U("type")] = web::json::value::string(U("benchmark"));
+    for (auto _ : state) {
+        web::http::http_response response = client.request(web::http::methods::POST, U("/tasks"), body).get();
+        if (response.status_code() != web::http::status_codes::Created) {
+            state.SkipWithError("dashboard did not create the task");
+            break;
+        }
+        benchmark::DoNotOptimize(response.extract_json().get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DashboardCreateTask)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+} // namespace
+} // namespace DistributedML
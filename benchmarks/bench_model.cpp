@@ -0,0 +1,120 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include "../include/batch_tensor.h"
+#include "../include/mlp_model.h"
+#include "../include/optimizer.h"
+
+namespace DistributedML {
+namespace {
+
+// MNIST-sized input with the trainer's default hidden width
+constexpr Eigen::Index kFeatures = 28 * 28;
+constexpr Eigen::Index kHiddenUnits = 128;
+constexpr Eigen::Index kClasses = 10;
+
+struct ModelFixture {
+    BatchTensor samples;
+    std::vector<int32_t> labels;
+    MlpModel model;
+    MlpModel::Workspace workspace;
+
+    explicit ModelFixture(Eigen::Index batchSize, KernelPrecision precision = KernelPrecision::Float64,
+                          bool specialized = true)
+        : samples(batchSize, kFeatures),
+          labels(static_cast<size_t>(batchSize)),
+          model(kFeatures, kHiddenUnits, kClasses, precision) {
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+        std::uniform_int_distribution<int32_t> label(0, kClasses - 1);
+        for (Eigen::Index i = 0; i < batchSize; ++i) {
+            float* row = samples.sample(i);
+            for (Eigen::Index j = 0; j < kFeatures; ++j) {
+                row[j] = pixel(generator);
+            }
+            labels[static_cast<size_t>(i)] = label(generator);
+        }
+        model.initialize(7);
+        if (!specialized) {
+            model.setKernel(dynamicMlpKernel(kFeatures, kHiddenUnits, kClasses, precision));
+        }
+        workspace = model.createWorkspace(batchSize);
+    }
+};
+
+// The single-threaded body of DistributedTrainer::processLocalBatch: one
+// batched forward and backward pass producing the summed gradient
+void BM_ProcessLocalBatch(benchmark::State& state) {
+    ModelFixture fixture(state.range(0));
+    const BatchView batch = fixture.samples.view();
+
+    for (auto _ : state) {
+        double loss = fixture.model.computeGradient(batch, fixture.labels.data(), fixture.workspace);
+        benchmark::DoNotOptimize(loss);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["parameters"] = static_cast<double>(fixture.model.parameterCount());
+}
+BENCHMARK(BM_ProcessLocalBatch)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+// The same step in each kernel: args are the batch size, the precision
+// (0 = f64, 1 = f32) and whether the compile-time shape is used
+void BM_ProcessLocalBatchKernel(benchmark::State& state) {
+    const KernelPrecision precision = state.range(1) ? KernelPrecision::Float32 : KernelPrecision::Float64;
+    ModelFixture fixture(state.range(0), precision, state.range(2) != 0);
+    const BatchView batch = fixture.samples.view();
+
+    for (auto _ : state) {
+        double loss = fixture.model.computeGradient(batch, fixture.labels.data(), fixture.workspace);
+        benchmark::DoNotOptimize(loss);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetLabel(fixture.model.kernel().name());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ProcessLocalBatchKernel)
+    ->ArgsProduct({{32, 256}, {0, 1}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Inference pass only, for comparison with the training step
+void BM_Predict(benchmark::State& state) {
+    ModelFixture fixture(state.range(0));
+    const BatchView batch = fixture.samples.view();
+
+    for (auto _ : state) {
+        fixture.model.predict(batch, fixture.workspace);
+        benchmark::DoNotOptimize(fixture.workspace.output.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Predict)->RangeMultiplier(4)->Range(16, 1024)->Unit(benchmark::kMicrosecond);
+
+// One optimizer step over the full parameter vector, as applied after each
+// gradient reduction
+void BM_OptimizerStep(benchmark::State& state) {
+    MlpModel model(kFeatures, kHiddenUnits, kClasses);
+    model.initialize(7);
+    OptimizerOptions options;
+    options.kind = static_cast<OptimizerKind>(state.range(0));
+    options.momentum = 0.9;
+    options.weightDecay = 1e-4;
+    Optimizer optimizer(options, model.blocks());
+    Eigen::VectorXd gradient = Eigen::VectorXd::Random(model.parameterCount());
+
+    for (auto _ : state) {
+        optimizer.step(model.parameters(), gradient, 1e-3);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetLabel(optimizerKindName(options.kind));
+    state.SetItemsProcessed(state.iterations() * model.parameterCount());
+}
+BENCHMARK(BM_OptimizerStep)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+} // namespace DistributedML
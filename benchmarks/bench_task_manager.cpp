@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../include/task_manager.h"
+
+namespace DistributedML {
+namespace {
+
+// Tasks present before timing starts, so lookups walk a realistic list
+constexpr int kPreloadedTasks = 1000;
+
+// Shared by every benchmark thread; Setup and Teardown run once per
+// benchmark run, outside the threads
+std::unique_ptr<TaskManager> g_taskManager;
+std::vector<std::string> g_taskIds;
+
+void setUp(const benchmark::State&) {
+    g_taskManager = std::make_unique<TaskManager>();
+    g_taskIds.clear();
+    for (int i = 0; i < kPreloadedTasks; ++i) {
+        g_taskIds.push_back(g_taskManager->addTask("training", {{"epoch", i}}));
+    }
+}
+
+void tearDown(const benchmark::State&) {
+    g_taskManager.reset();
+}
+
+// Writers only: every thread keeps registering tasks
+void BM_TaskManagerAddTask(benchmark::State& state) {
+    const nlohmann::json metadata = {{"epoch", 1}, {"rank", state.thread_index()}};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(g_taskManager->addTask("training", metadata));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskManagerAddTask)
+    ->Setup(setUp)
+    ->Teardown(tearDown)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Status updates and lookups by id, the trainer's steady-state traffic
+void BM_TaskManagerUpdateStatus(benchmark::State& state) {
+    size_t next = static_cast<size_t>(state.thread_index());
+    for (auto _ : state) {
+        const std::string& id = g_taskIds[next % g_taskIds.size()];
+        g_taskManager->updateTaskStatus(id, TaskStatus::RUNNING);
+        benchmark::DoNotOptimize(g_taskManager->getTaskById(id));
+        next += 7;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskManagerUpdateStatus)
+    ->Setup(setUp)
+    ->Teardown(tearDown)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// One dashboard-style reader taking full snapshots while the other
+// threads update statuses
+void BM_TaskManagerSnapshotUnderWrites(benchmark::State& state) {
+    size_t next = static_cast<size_t>(state.thread_index());
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            benchmark::DoNotOptimize(g_taskManager->getAllTasks());
+        } else {
+            g_taskManager->updateTaskStatus(g_taskIds[next % g_taskIds.size()], TaskStatus::COMPLETED);
+            next += 7;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskManagerSnapshotUnderWrites)
+    ->Setup(setUp)
+    ->Teardown(tearDown)
+    ->ThreadRange(2, 16)
+    ->UseRealTime();
+
+// Dashboard paging: one filtered page of running tasks while others update
+void BM_TaskManagerListPage(benchmark::State& state) {
+    TaskManager::TaskQuery query;
+    query.status = TaskStatus::RUNNING;
+    query.limit = 100;
+    size_t next = static_cast<size_t>(state.thread_index());
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            benchmark::DoNotOptimize(g_taskManager->listTasks(query));
+        } else {
+            g_taskManager->updateTaskStatus(g_taskIds[next % g_taskIds.size()], TaskStatus::RUNNING);
+            next += 7;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskManagerListPage)
+    ->Setup(setUp)
+    ->Teardown(tearDown)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+} // namespace
+} // namespace DistributedML
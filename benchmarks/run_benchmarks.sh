@@ -0,0 +1,31 @@
+#!/bin/bash
+# Run the benchmark suites and store JSON results per commit, so two
+# commits can be compared with Google Benchmark's tools/compare.py:
+#   compare.py benchmarks <old>/micro.json <new>/micro.json
+#
+# Usage: run_benchmarks.sh <binary dir> <results dir> [rank counts...]
+set -euo pipefail
+
+BIN_DIR=${1:?binary directory}
+RESULTS_ROOT=${2:?results directory}
+shift 2
+RANKS=${*:-1 2 4}
+
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+OUT_DIR="${RESULTS_ROOT}/${COMMIT}"
+mkdir -p "${OUT_DIR}"
+
+# Pin BLAS/OpenMP threads so compute numbers are comparable across runs
+export OMP_NUM_THREADS=${OMP_NUM_THREADS:-1}
+
+"${BIN_DIR}/dml_benchmarks" \
+    --benchmark_out="${OUT_DIR}/micro.json" \
+    --benchmark_out_format=json
+
+for NP in ${RANKS}; do
+    mpirun ${MPIRUN_FLAGS:-} -np "${NP}" "${BIN_DIR}/dml_mpi_benchmarks" \
+        --benchmark_out="${OUT_DIR}/mpi_np${NP}.json" \
+        --benchmark_out_format=json
+done
+
+echo "Results written to ${OUT_DIR}"
@@ -1,81 +1,499 @@
+// Eigen must come before cpprest, whose U() macro breaks Eigen's headers
+#include "../include/inference_service.h"
 #include "../include/dashboard_server.h"
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 namespace DistributedML {
 
-DashboardServer::DashboardServer(const std::string& address) 
-    : m_listener(address) {
-    
+namespace {
+
+// Page size of /tasks when the client gives none, and the largest allowed
+constexpr size_t kDefaultTaskLimit = 500;
+constexpr size_t kMaxTaskLimit = 5000;
+
+// Metric events kept for clients that fall behind
+constexpr size_t kMaxEvents = 1024;
+
+// Longest a long poll is held open, and how often timeouts are checked
+constexpr std::chrono::milliseconds kDefaultPollTimeout(25000);
+constexpr std::chrono::milliseconds kMaxPollTimeout(60000);
+constexpr std::chrono::milliseconds kPollSweepInterval(250);
+
+// Furthest ahead a task deadline may be set
+constexpr std::chrono::milliseconds kMaxTaskDeadline(std::chrono::hours(24 * 30));
+
+const char kJsonContentType[] = "application/json";
+const char kPrometheusContentType[] = "text/plain; version=0.0.4; charset=utf-8";
+
+void replyBusy(const web::http::http_request& request) {
+    web::http::http_response busy(web::http::status_codes::ServiceUnavailable);
+    busy.headers().add(U("Retry-After"), U("1"));
+    request.reply(busy);
+}
+
+// Reads a JSON integer in [minValue, maxValue]; floats, booleans and
+// strings are rejected rather than converted
+long long integerField(const nlohmann::json& value, const char* name, long long minValue, long long maxValue) {
+    if (!value.is_number_integer()) {
+        throw std::invalid_argument(std::string(name) + " must be an integer");
+    }
+    // Non-negative numbers parse as unsigned and may not fit a long long
+    bool inRange = value.is_number_unsigned()
+        ? value.get<unsigned long long>() <= static_cast<unsigned long long>(maxValue) &&
+              static_cast<long long>(value.get<unsigned long long>()) >= minValue
+        : value.get<long long>() >= minValue && value.get<long long>() <= maxValue;
+    if (!inRange) {
+        throw std::invalid_argument(std::string(name) + " is out of range");
+    }
+    return value.get<long long>();
+}
+
+nlohmann::json taskToJson(const TaskManager::Task& task) {
+    return {
+        {"id", task.id},
+        {"type", task.type},
+        {"status", std::to_string(static_cast<int>(task.status))},
+        {"progress", task.progress}
+    };
+}
+
+std::string serializeTasks(const std::vector<TaskManager::TaskPtr>& tasks) {
+    nlohmann::json response = nlohmann::json::array();
+    for (const auto& task : tasks) {
+        response.push_back(taskToJson(*task));
+    }
+    return response.dump();
+}
+
+} // namespace
+
+DashboardServer::DashboardServer(const std::string& address, TaskManager& taskManager, TaskExecutor* executor)
+    : m_listener(address),
+      m_taskManager(taskManager),
+      m_executor(executor) {
+
+    auto metrics = std::make_shared<Snapshot>();
+    metrics->etag = "\"m0\"";
+    metrics->body = "{\"metrics\":{}}";
+    m_metricsSnapshot = std::move(metrics);
+
     // Setup routes
-    m_listener.support(web::http::methods::GET, 
+    m_listener.support(web::http::methods::GET,
         [this](web::http::http_request request) {
-            if (request.request_uri().path() == "/tasks") {
+            const std::string path = request.request_uri().path();
+            if (path == "/tasks") {
                 handleGetTasks(request);
-            } else if (request.request_uri().path() == "/performance") {
+            } else if (path == "/performance") {
                 handleGetPerformance(request);
+            } else if (path == "/events") {
+                handleGetEvents(request);
+            } else if (path == "/metrics") {
+                handleGetMetrics(request);
+            } else {
+                request.reply(web::http::status_codes::NotFound);
             }
         });
 
-    m_listener.support(web::http::methods::POST, 
+    m_listener.support(web::http::methods::POST,
         [this](web::http::http_request request) {
-            if (request.request_uri().path() == "/tasks") {
+            const std::string path = request.request_uri().path();
+            if (path == "/tasks") {
                 handleCreateTask(request);
+            } else if (path == "/predict") {
+                handlePredict(request);
+            } else {
+                request.reply(web::http::status_codes::NotFound);
             }
         });
+
+    m_listener.support(web::http::methods::DEL,
+        [this](web::http::http_request request) {
+            handleCancelTask(request);
+        });
+}
+
+DashboardServer::~DashboardServer() {
+    try {
+        stop();
+    } catch (const std::exception& e) {
+        std::cerr << "Error stopping dashboard server: " << e.what() << std::endl;
+    }
 }
 
 void DashboardServer::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+    }
+    m_eventThread = std::thread([this]() { eventLoop(); });
+
     m_listener.open().wait();
-    std::cout << "Dashboard server listening on: " 
+    std::cout << "Dashboard server listening on: "
               << m_listener.uri().to_string() << std::endl;
 }
 
 void DashboardServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_eventSignal.notify_all();
+    m_eventThread.join();
     m_listener.close().wait();
 }
 
+void DashboardServer::publishMetrics(const nlohmann::json& metrics) {
+    std::string serialized = metrics.dump();
+
+    uint64_t sequence = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        sequence = ++m_eventSequence;
+        m_events.emplace_back(sequence, serialized);
+        if (m_events.size() > kMaxEvents) {
+            m_events.pop_front();
+        }
+    }
+
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->version = sequence;
+    snapshot->etag = "\"m" + std::to_string(sequence) + "\"";
+    snapshot->body = "{\"metrics\":" + serialized + "}";
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        m_metricsSnapshot = std::move(snapshot);
+    }
+    m_eventSignal.notify_all();
+}
+
+void DashboardServer::replyWithEtag(const web::http::http_request& request, const std::string& etag,
+                                    const std::string& body, const std::string& nextCursor) {
+    const auto& headers = request.headers();
+    auto match = headers.find(web::http::header_names::if_none_match);
+    if (match != headers.end() && match->second == etag) {
+        web::http::http_response notModified(web::http::status_codes::NotModified);
+        notModified.headers().add(web::http::header_names::etag, etag);
+        request.reply(notModified);
+        return;
+    }
+
+    web::http::http_response response(web::http::status_codes::OK);
+    response.headers().add(web::http::header_names::etag, etag);
+    response.headers().add(web::http::header_names::cache_control, U("no-cache"));
+    if (!nextCursor.empty()) {
+        response.headers().add(U("X-Next-Cursor"), nextCursor);
+    }
+    response.set_body(body, kJsonContentType);
+    request.reply(response);
+}
+
+DashboardServer::SnapshotPtr DashboardServer::tasksSnapshot() {
+    const uint64_t version = m_taskManager.version();
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    if (m_tasksSnapshot && m_tasksSnapshot->version == version) {
+        return m_tasksSnapshot;
+    }
+
+    // Built under the lock so concurrent polls serialize the store once
+    TaskManager::TaskQuery query;
+    query.limit = kDefaultTaskLimit;
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->version = version;
+    snapshot->etag = "\"t" + std::to_string(version) + "\"";
+    TaskManager::TaskPage page = m_taskManager.listTasks(query);
+    snapshot->body = serializeTasks(page.tasks);
+    if (page.hasMore) {
+        snapshot->nextCursor = std::to_string(page.nextCursor);
+    }
+    m_tasksSnapshot = snapshot;
+    return snapshot;
+}
+
 void DashboardServer::handleGetTasks(web::http::http_request request) {
-    auto tasks = m_taskManager.getAllTasks();
-    web::json::value response = web::json::value::array();
+    // Paged listing: ?cursor=<n>&limit=<n>&status=<0-4>&type=<name>. The
+    // cursor for the next page is returned in X-Next-Cursor when there is one.
 
-    for (const auto& task : tasks) {
-        web::json::value taskJson;
-        taskJson[U"id"] = web::json::value::string(task.id);
-        taskJson[U"type"] = web::json::value::string(task.type);
-        taskJson[U"status"] = web::json::value::string(
-            std::to_string(static_cast<int>(task.status))
-        );
-        taskJson[U"progress"] = web::json::value::number(task.progress);
-        
-        response[response.size()] = taskJson;
+    const std::string rawQuery = request.request_uri().query();
+    if (rawQuery.empty()) {
+        SnapshotPtr snapshot = tasksSnapshot();
+        replyWithEtag(request, snapshot->etag, snapshot->body, snapshot->nextCursor);
+        return;
+    }
+
+    TaskManager::TaskQuery query;
+    query.limit = kDefaultTaskLimit;
+    try {
+        auto parameters = web::uri::split_query(rawQuery);
+        for (const auto& [key, value] : parameters) {
+            std::string decoded = web::uri::decode(value);
+            if (key == "cursor") {
+                query.cursor = std::stoull(decoded);
+            } else if (key == "limit") {
+                query.limit = std::clamp<size_t>(std::stoull(decoded), 1, kMaxTaskLimit);
+            } else if (key == "status") {
+                int status = std::stoi(decoded);
+                if (status < static_cast<int>(TaskStatus::PENDING) || status > static_cast<int>(TaskStatus::CANCELLED)) {
+                    throw std::out_of_range("status");
+                }
+                query.status = static_cast<TaskStatus>(status);
+            } else if (key == "type") {
+                query.type = decoded;
+            }
+        }
+    } catch (const std::exception&) {
+        request.reply(web::http::status_codes::BadRequest);
+        return;
+    }
+
+    // The store version and the query identify the page, so an unchanged
+    // page is answered without listing anything
+    const std::string etag = "\"t" + std::to_string(m_taskManager.version()) + "-" +
+                             std::to_string(std::hash<std::string>{}(rawQuery)) + "\"";
+    const auto& headers = request.headers();
+    auto match = headers.find(web::http::header_names::if_none_match);
+    if (match != headers.end() && match->second == etag) {
+        replyWithEtag(request, etag, "");
+        return;
     }
 
-    request.reply(web::http::status_codes::OK, response);
+    TaskManager::TaskPage page = m_taskManager.listTasks(query);
+    replyWithEtag(request, etag, serializeTasks(page.tasks),
+                  page.hasMore ? std::to_string(page.nextCursor) : "");
 }
 
 void DashboardServer::handleGetPerformance(web::http::http_request request) {
-    auto metrics = m_performanceTracker.getMetrics();
-    web::json::value response;
+    SnapshotPtr snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        snapshot = m_metricsSnapshot;
+    }
+    replyWithEtag(request, snapshot->etag, snapshot->body);
+}
 
-    for (const auto& metric : metrics) {
-        response[U"metrics"][metric["name"].get<std::string>()] = 
-            web::json::value::number(metric["duration_ms"].get<double>());
+void DashboardServer::handleGetMetrics(web::http::http_request request) {
+    if (!m_metricsRegistry) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
     }
+    request.reply(web::http::status_codes::OK, m_metricsRegistry->renderPrometheus(), kPrometheusContentType);
+}
 
-    request.reply(web::http::status_codes::OK, response);
+std::string DashboardServer::eventsAfter(uint64_t since, uint64_t& next) const {
+    // Caller holds m_eventMutex
+    std::string body = "{\"events\":[";
+    bool first = true;
+    next = since;
+    for (const auto& [sequence, event] : m_events) {
+        if (sequence <= since) {
+            continue;
+        }
+        if (!first) {
+            body += ',';
+        }
+        body += "{\"seq\":" + std::to_string(sequence) + ",\"metrics\":" + event + "}";
+        first = false;
+        next = sequence;
+    }
+    body += "],\"next\":" + std::to_string(next) + "}";
+    return body;
+}
+
+void DashboardServer::handleGetEvents(web::http::http_request request) {
+    // Long poll: GET /events?since=<seq>&timeout_ms=<n> answers as soon as
+    // there are events after seq, or with an empty list at the timeout
+    uint64_t since = 0;
+    std::chrono::milliseconds timeout = kDefaultPollTimeout;
+    try {
+        auto parameters = web::uri::split_query(request.request_uri().query());
+        for (const auto& [key, value] : parameters) {
+            if (key == "since") {
+                since = std::stoull(web::uri::decode(value));
+            } else if (key == "timeout_ms") {
+                timeout = std::min(kMaxPollTimeout, std::chrono::milliseconds(std::stoll(web::uri::decode(value))));
+            }
+        }
+    } catch (const std::exception&) {
+        request.reply(web::http::status_codes::BadRequest);
+        return;
+    }
+
+    std::string body;
+    {
+        std::lock_guard<std::mutex> lock(m_eventMutex);
+        if (m_eventSequence <= since && m_running) {
+            // Parked; the event thread replies
+            m_waiters.push_back({request, since, std::chrono::steady_clock::now() + timeout});
+            return;
+        }
+        uint64_t next = 0;
+        body = eventsAfter(since, next);
+    }
+    request.reply(web::http::status_codes::OK, body, kJsonContentType);
+}
+
+void DashboardServer::eventLoop() {
+    std::unique_lock<std::mutex> lock(m_eventMutex);
+    uint64_t seen = m_eventSequence;
+    while (m_running) {
+        m_eventSignal.wait_for(lock, kPollSweepInterval,
+            [this, seen]() { return !m_running || m_eventSequence != seen; });
+        seen = m_eventSequence;
+
+        // Reply to every waiter with news or past its deadline
+        auto now = std::chrono::steady_clock::now();
+        std::vector<std::pair<web::http::http_request, std::string>> replies;
+        auto ready = [&](EventWaiter& waiter) {
+            if (m_running && m_eventSequence <= waiter.since && now < waiter.deadline) {
+                return false;
+            }
+            uint64_t next = 0;
+            replies.emplace_back(waiter.request, eventsAfter(waiter.since, next));
+            return true;
+        };
+        m_waiters.erase(std::remove_if(m_waiters.begin(), m_waiters.end(), ready), m_waiters.end());
+
+        lock.unlock();
+        for (auto& [request, body] : replies) {
+            request.reply(web::http::status_codes::OK, body, kJsonContentType);
+        }
+        lock.lock();
+    }
+
+    // Release anything still parked when the server stops
+    for (auto& waiter : m_waiters) {
+        uint64_t next = 0;
+        waiter.request.reply(web::http::status_codes::OK, eventsAfter(waiter.since, next), kJsonContentType);
+    }
+    m_waiters.clear();
 }
 
 void DashboardServer::handleCreateTask(web::http::http_request request) {
-    request.extract_json().then([this, request](web::json::value body) {
-        std::string taskType = body[U"type"].as_string();
-        nlohmann::json metadata = nlohmann::json::parse(body.serialize());
-
-        std::string taskId = m_taskManager.addTask(taskType, metadata);
-        
-        web::json::value response;
-        response[U"task_id"] = web::json::value::string(taskId);
-        request.reply(web::http::status_codes::Created, response);
-    }).wait();
+    // Continues on a pplx thread once the body arrives; the listener thread
+    // returns immediately
+    request.extract_string().then([this, request](pplx::task<std::string> bodyTask) {
+        nlohmann::json metadata;
+        std::string taskType;
+        // Optional scheduling fields: priority and deadline_ms from now
+        TaskOptions options;
+        try {
+            metadata = nlohmann::json::parse(bodyTask.get());
+            taskType = metadata.at("type").get<std::string>();
+            if (metadata.contains("priority")) {
+                options.priority = static_cast<int>(integerField(metadata["priority"], "priority",
+                    std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+            }
+            if (metadata.contains("deadline_ms")) {
+                options.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(
+                    integerField(metadata["deadline_ms"], "deadline_ms", 0, kMaxTaskDeadline.count()));
+            }
+        } catch (const std::exception& e) {
+            request.reply(web::http::status_codes::BadRequest, std::string("Invalid task: ") + e.what());
+            return;
+        }
+
+        std::string taskId;
+        if (m_executor) {
+            if (!m_executor->hasHandler(taskType)) {
+                request.reply(web::http::status_codes::BadRequest, "No handler for task type " + taskType);
+                return;
+            }
+
+            try {
+                taskId = m_executor->submit(taskType, metadata, options);
+            } catch (const std::invalid_argument& e) {
+                // The handler was unregistered after the check above
+                request.reply(web::http::status_codes::BadRequest, e.what());
+                return;
+            }
+            if (taskId.empty()) {
+                // Back-pressure: the queue is full
+                replyBusy(request);
+                return;
+            }
+        } else {
+            taskId = m_taskManager.addTask(taskType, metadata);
+        }
+
+        nlohmann::json response = {{"task_id", taskId}};
+        request.reply(web::http::status_codes::Created, response.dump(), kJsonContentType);
+    });
+}
+
+void DashboardServer::handlePredict(web::http::http_request request) {
+    if (!m_inference) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+
+    // The reply is sent from the batch worker that ran the request, so
+    // neither the listener nor the pplx thread waits for the forward pass
+    request.extract_string().then([this, request](pplx::task<std::string> bodyTask) {
+        std::vector<float> features;
+        try {
+            features = nlohmann::json::parse(bodyTask.get()).at("features").get<std::vector<float>>();
+        } catch (const std::exception& e) {
+            request.reply(web::http::status_codes::BadRequest, std::string("Invalid prediction request: ") + e.what());
+            return;
+        }
+
+        // No model until the first epoch finishes
+        if (!m_inference->ready()) {
+            replyBusy(request);
+            return;
+        }
+
+        auto done = [request](const InferenceService::Prediction* prediction, std::exception_ptr error) {
+            if (!prediction) {
+                std::string message = "Prediction failed";
+                try {
+                    std::rethrow_exception(error);
+                } catch (const std::exception& e) {
+                    message += std::string(": ") + e.what();
+                } catch (...) {
+                }
+                request.reply(web::http::status_codes::InternalError, message);
+                return;
+            }
+            nlohmann::json response = {
+                {"label", prediction->label},
+                {"probabilities", prediction->probabilities}
+            };
+            request.reply(web::http::status_codes::OK, response.dump(), kJsonContentType);
+        };
+
+        try {
+            if (!m_inference->submit(std::move(features), std::move(done))) {
+                // Back-pressure: the inference queue is full
+                replyBusy(request);
+            }
+        } catch (const std::invalid_argument& e) {
+            request.reply(web::http::status_codes::BadRequest, e.what());
+        }
+    });
+}
+
+void DashboardServer::handleCancelTask(web::http::http_request request) {
+    // DELETE /tasks/<id>
+    const std::string prefix = "/tasks/";
+    std::string path = request.request_uri().path();
+    if (!m_executor || path.compare(0, prefix.size(), prefix) != 0) {
+        request.reply(web::http::status_codes::NotFound);
+        return;
+    }
+
+    std::string taskId = path.substr(prefix.size());
+    request.reply(m_executor->cancel(taskId) ? web::http::status_codes::Accepted
+                                             : web::http::status_codes::NotFound);
 }
 
 } // namespace DistributedML
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DistributedML {
+
+// Whether heap allocations are being counted. Counting needs the malloc
+// interposer, which is only linked into the application when it is built
+// with -DDML_COUNT_ALLOCATIONS=ON, on glibc, without sanitizers (they
+// interpose malloc themselves).
+bool allocationCountingEnabled();
+
+// Heap allocations made so far by the calling thread (always 0 when
+// counting is disabled). Per-thread, so a loop can measure its own
+// allocations while other threads allocate freely.
+uint64_t threadHeapAllocations();
+
+} // namespace DistributedML
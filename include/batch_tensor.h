@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <Eigen/Dense>
+
+namespace DistributedML {
+
+// Alignment of sample rows in every batch buffer (one cache line)
+constexpr std::size_t kBatchAlignment = 64;
+
+// Row-major float matrix used for batches of samples
+using SampleMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// Non-owning view of N samples laid out row-major, one sample per row.
+// Rows are `stride` floats apart so every sample starts on a cache line.
+struct BatchView {
+    using ConstMap = Eigen::Map<const SampleMatrix, Eigen::Aligned64, Eigen::OuterStride<>>;
+
+    const float* data = nullptr;
+    Eigen::Index samples = 0;
+    Eigen::Index features = 0;
+    Eigen::Index stride = 0;
+
+    bool empty() const { return samples == 0; }
+
+    // Pointer to the first feature of a sample
+    const float* sample(Eigen::Index index) const { return data + index * stride; }
+
+    // Sub-view of samples [begin, end); no data is touched
+    BatchView slice(Eigen::Index begin, Eigen::Index end) const {
+        return {sample(begin), end - begin, features, stride};
+    }
+
+    // N x D Eigen map over the view
+    ConstMap matrix() const {
+        return ConstMap(data, samples, features, Eigen::OuterStride<>(stride));
+    }
+};
+
+// Owning, 64-byte aligned N x D block of float samples
+class BatchTensor {
+public:
+    BatchTensor() = default;
+    BatchTensor(Eigen::Index samples, Eigen::Index features);
+
+    // Reallocate for a new shape; contents are zeroed
+    void resize(Eigen::Index samples, Eigen::Index features);
+
+    // Release the storage
+    void clear();
+
+    float* data() { return m_storage.get(); }
+    const float* data() const { return m_storage.get(); }
+
+    float* sample(Eigen::Index index) { return data() + index * m_stride; }
+    const float* sample(Eigen::Index index) const { return data() + index * m_stride; }
+
+    Eigen::Index samples() const { return m_samples; }
+    Eigen::Index features() const { return m_features; }
+    Eigen::Index stride() const { return m_stride; }
+
+    // Non-owning view of the whole tensor
+    BatchView view() const { return {data(), m_samples, m_features, m_stride}; }
+
+    // Floats per sample row rounded up to the alignment
+    static Eigen::Index alignedStride(Eigen::Index features);
+
+private:
+    struct AlignedDeleter {
+        void operator()(float* pointer) const { std::free(pointer); }
+    };
+
+    std::unique_ptr<float[], AlignedDeleter> m_storage;
+    Eigen::Index m_samples = 0;
+    Eigen::Index m_features = 0;
+    Eigen::Index m_stride = 0;
+};
+
+} // namespace DistributedML
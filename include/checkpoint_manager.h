@@ -0,0 +1,99 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <Eigen/Dense>
+
+namespace DistributedML {
+
+// On-disk header of a checkpoint file, followed by the parameter vector
+// and then each optimizer state vector, all as contiguous doubles
+struct CheckpointHeader {
+    char magic[8];              // "DMLCKPT\0"
+    uint32_t version;
+    uint32_t stateVectors;      // optimizer state vectors after the parameters
+    uint64_t parameterCount;
+    int64_t epoch;              // epochs completed when the checkpoint was taken
+    uint64_t dataOffset;        // byte offset of the parameter vector
+    uint64_t optimizerSteps;    // steps the optimizer state has seen
+    uint64_t reserved[2];
+};
+
+// Model and optimizer state restored from a checkpoint
+struct CheckpointState {
+    int64_t epoch = 0;
+    Eigen::VectorXd parameters;
+    std::vector<Eigen::VectorXd> optimizerState;
+    uint64_t optimizerSteps = 0;
+};
+
+// Writes and reads checkpoints as a single shared file with collective
+// MPI-IO. Each rank owns an even slice of every vector and writes only
+// that slice, so I/O scales with the number of ranks. Files are written
+// to a temporary name and renamed once complete, so a crash mid-write
+// leaves the previous checkpoint intact.
+//
+// save, exists and restore are collective over the communicator
+// given at construction.
+class CheckpointManager {
+public:
+    // With background set, save() copies this rank's slice and returns;
+    // a writer thread does the I/O on a private duplicate communicator.
+    // That requires MPI_THREAD_MULTIPLE.
+    CheckpointManager(MPI_Comm communicator, const std::string& path, bool background);
+    ~CheckpointManager();
+
+    // Prevent copying (owns a communicator and a writer thread)
+    CheckpointManager(const CheckpointManager&) = delete;
+    CheckpointManager& operator=(const CheckpointManager&) = delete;
+
+    // Snapshot the state and write it; waits for the previous write first
+    void save(int64_t epoch, const Eigen::VectorXd& parameters,
+              const std::vector<const Eigen::VectorXd*>& optimizerState, uint64_t optimizerSteps = 0);
+
+    // Block until the last save has reached the file system
+    void wait();
+
+    // Whether a checkpoint file is present (checked on rank 0)
+    bool exists() const;
+
+    // Read a checkpoint written by any number of ranks. Every rank reads
+    // its slice and the slices are gathered on rank 0, which receives the
+    // full state; other ranks only receive the epoch.
+    // Throws if the file does not hold expectedParameters parameters, is
+    // shorter than its header says, or cannot be read on some rank.
+    CheckpointState restore(uint64_t expectedParameters) const;
+
+    const std::string& path() const { return m_path; }
+
+    // Wall time of the last completed write, in seconds
+    double lastWriteSeconds() const;
+
+private:
+    // Contiguous slice [begin, end) of a vector of the given size owned by rank
+    static std::pair<uint64_t, uint64_t> sliceOf(uint64_t size, int rank, int worldSize);
+
+    // Collective write of the pending snapshot
+    void write();
+
+    MPI_Comm m_communicator;
+    std::string m_path;
+    bool m_background;
+    int m_rank;
+    int m_worldSize;
+
+    // Snapshot of this rank's slices, in file order
+    CheckpointHeader m_header;
+    std::vector<double> m_snapshot;
+
+    std::thread m_writer;
+    mutable std::mutex m_statsMutex;
+    double m_lastWriteSeconds;
+};
+
+} // namespace DistributedML
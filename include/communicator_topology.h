@@ -0,0 +1,53 @@
+#pragma once
+
+#include <mpi.h>
+
+namespace DistributedML {
+
+// Two-level view of a communicator: ranks sharing a node form a node
+// communicator, and local rank 0 of every node joins a leader communicator.
+// Collectives run inside the node first, then across leaders only.
+//
+// Nodes are discovered with MPI_Comm_split_type(MPI_COMM_TYPE_SHARED). Set
+// DML_RANKS_PER_NODE to further split each host's ranks into simulated
+// nodes of that many consecutive ranks, which exercises the inter-node path
+// on a single host.
+class CommunicatorTopology {
+public:
+    explicit CommunicatorTopology(MPI_Comm communicator);
+    ~CommunicatorTopology();
+
+    // Prevent copying (owns communicators)
+    CommunicatorTopology(const CommunicatorTopology&) = delete;
+    CommunicatorTopology& operator=(const CommunicatorTopology&) = delete;
+
+    MPI_Comm communicator() const { return m_communicator; }
+    MPI_Comm nodeCommunicator() const { return m_nodeCommunicator; }
+
+    // MPI_COMM_NULL on ranks that are not node leaders
+    MPI_Comm leaderCommunicator() const { return m_leaderCommunicator; }
+
+    int rank() const { return m_rank; }
+    int size() const { return m_size; }
+    int localRank() const { return m_localRank; }
+    int localSize() const { return m_localSize; }
+    int nodeIndex() const { return m_nodeIndex; }
+    int nodeCount() const { return m_nodeCount; }
+    bool isLeader() const { return m_localRank == 0; }
+
+    // Broadcast from rank 0 across leaders, then inside every node
+    void broadcast(void* buffer, int count, MPI_Datatype type) const;
+
+private:
+    MPI_Comm m_communicator;
+    MPI_Comm m_nodeCommunicator;
+    MPI_Comm m_leaderCommunicator;
+    int m_rank;
+    int m_size;
+    int m_localRank;
+    int m_localSize;
+    int m_nodeIndex;
+    int m_nodeCount;
+};
+
+} // namespace DistributedML
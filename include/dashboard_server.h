@@ -1,26 +1,114 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <cpprest/http_listener.h>
 #include <cpprest/json.h>
 #include <nlohmann/json.hpp>
+#include "metrics_registry.h"
 #include "task_manager.h"
-#include "performance_tracker.h"
+#include "task_executor.h"
 
 namespace DistributedML {
 
+class InferenceService;
+
+// HTTP front end for the task store and training metrics. Responses are
+// serialized once per change: the server keeps versioned, pre-serialized
+// snapshots and answers repeated polls with 304 Not Modified via ETags.
+// Training metrics are also kept as a sequence of events that clients
+// long-poll with GET /events?since=<n>, so they receive only what is new.
+// No handler blocks a listener thread.
 class DashboardServer {
 public:
-    DashboardServer(const std::string& address);
-    
+    // Serves the given task store. With an executor, POST /tasks queues
+    // tasks of types it has handlers for and DELETE /tasks/<id> cancels;
+    // without one, posted tasks are only recorded.
+    DashboardServer(const std::string& address, TaskManager& taskManager, TaskExecutor* executor = nullptr);
+    ~DashboardServer();
+
+    // Prevent copying (listener callbacks capture this)
+    DashboardServer(const DashboardServer&) = delete;
+    DashboardServer& operator=(const DashboardServer&) = delete;
+
     void start();
     void stop();
 
+    // Publish the latest training metrics; served by /performance and
+    // appended to the /events stream. Thread-safe.
+    void publishMetrics(const nlohmann::json& metrics);
+
+    // Serve a registry on GET /metrics in the Prometheus text format.
+    // Call before start(); the registry must outlive the server.
+    void exposeMetrics(const MetricsRegistry& registry) { m_metricsRegistry = &registry; }
+
+    // Answer POST /predict with {"features": [...]} from a batched
+    // inference service. Call before start(); the service must outlive the
+    // server.
+    void exposeInference(InferenceService& service) { m_inference = &service; }
+
 private:
+    // Serialized response body with its ETag
+    struct Snapshot {
+        uint64_t version = 0;
+        std::string etag;
+        std::string body;
+        std::string nextCursor;
+    };
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    // Long-poll request waiting for events after `since`
+    struct EventWaiter {
+        web::http::http_request request;
+        uint64_t since;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
     web::http::experimental::listener::http_listener m_listener;
-    TaskManager m_taskManager;
-    PerformanceTracker m_performanceTracker;
+    TaskManager& m_taskManager;
+    TaskExecutor* m_executor;
+    const MetricsRegistry* m_metricsRegistry = nullptr;
+    InferenceService* m_inference = nullptr;
+
+    // Unfiltered first page of /tasks, rebuilt when the store's version moves
+    std::mutex m_snapshotMutex;
+    SnapshotPtr m_tasksSnapshot;
+    SnapshotPtr m_metricsSnapshot;
+
+    // Recent metric events (sequence, serialized) and pending long polls
+    std::mutex m_eventMutex;
+    std::condition_variable m_eventSignal;
+    std::deque<std::pair<uint64_t, std::string>> m_events;
+    uint64_t m_eventSequence = 0;
+    std::vector<EventWaiter> m_waiters;
+    bool m_running = false;
+    std::thread m_eventThread;
 
     void handleGetTasks(web::http::http_request request);
     void handleGetPerformance(web::http::http_request request);
+    void handleGetEvents(web::http::http_request request);
+    void handleGetMetrics(web::http::http_request request);
     void handleCreateTask(web::http::http_request request);
+    void handleCancelTask(web::http::http_request request);
+    void handlePredict(web::http::http_request request);
+
+    // Current /tasks snapshot, rebuilt if the task store changed
+    SnapshotPtr tasksSnapshot();
+
+    // Reply 304 when the client already holds the ETag, else the body
+    static void replyWithEtag(const web::http::http_request& request, const std::string& etag,
+                              const std::string& body, const std::string& nextCursor = "");
+
+    // Answer long polls that have new events or have timed out
+    void eventLoop();
+    std::string eventsAfter(uint64_t since, uint64_t& next) const;
 };
+
+} // namespace DistributedML
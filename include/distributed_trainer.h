@@ -1,17 +1,42 @@
 #pragma once
 
 #include <mpi.h>
+#include <chrono>
+#include <functional>
 #include <vector>
 #include <memory>
+#include <string>
 #include <limits>
 #include <Eigen/Dense>
 #include <opencv2/opencv.hpp>
 #include <nlohmann/json.hpp>
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
+#include "batch_tensor.h"
+#include "checkpoint_manager.h"
+#include "communicator_topology.h"
+#include "elastic_coordinator.h"
+#include "gradient_bucketer.h"
+#include "input_pipeline.h"
+#include "optimizer.h"
+#include "metrics_registry.h"
+#include "mlp_model.h"
+#include "performance_tracker.h"
+#include "result_sink.h"
+#include "timeline_recorder.h"
+#include "thread_pool.h"
+#include "sample_shard.h"
+#include "step_arena.h"
+#include "task_executor.h"
 
 namespace DistributedML {
 
+// How ranks combine their work
+enum class ExecutionMode {
+    Synchronous,  // globally reduced gradient steps, one per accumulationSteps batches
+    LocalSGD      // per-batch local steps, models averaged every few steps
+};
+
 class DistributedTrainer {
 public:
     // Training hyperparameters
@@ -19,6 +44,51 @@ public:
         double learningRate;
         int epochs;
         int batchSize;
+        // Width of the MLP hidden layer
+        int hiddenUnits = 128;
+        // Scalar type of the forward and backward passes
+        KernelPrecision precision = KernelPrecision::Float64;
+        // Update rule for the reduced gradient (local steps in local SGD)
+        OptimizerOptions optimizer = {};
+        // Mini-batches whose gradients are summed into one optimizer step;
+        // in synchronous mode also one allreduce. 0 = a step per epoch in
+        // synchronous mode and a step per batch in local SGD
+        int accumulationSteps = 0;
+        // Intra-node worker threads per rank (0 = all hardware threads)
+        int numThreads = 1;
+        // Gradient bucket size for overlapped allreduce
+        std::size_t gradientBucketBytes = 1 << 20;
+        // Buckets allowed in flight before the oldest is waited on
+        int maxBucketsInFlight = 8;
+        // Wire format for gradient buckets
+        CompressionMode gradientCompression = CompressionMode::None;
+        // Fraction of each bucket sent in TopK mode
+        double topKRatio = 0.01;
+        // Bulk-synchronous training or local SGD with periodic averaging
+        ExecutionMode executionMode = ExecutionMode::Synchronous;
+        // Local SGD: local steps between model averages
+        int averagingInterval = 8;
+        // Local SGD: steps an average may stay in flight before it is waited on
+        int maxStaleness = 2;
+        // Checkpoint file; empty disables checkpointing. An existing file
+        // is resumed from at the start of train()
+        std::string checkpointPath = "";
+        // Epochs between checkpoints (0 = only when training ends)
+        int checkpointInterval = 1;
+        // Chrome trace of every rank's spans, written when training ends;
+        // empty disables timeline recording
+        std::string traceFile = "";
+        // Input pipeline: batches prepared ahead of compute, augmenter
+        // threads, and the per-epoch shuffle (seeded with the rank too)
+        int prefetchBatches = 4;
+        int inputWorkers = 2;
+        bool shuffle = true;
+        uint64_t shuffleSeed = 0;
+        AugmentationOptions augmentation = {};
+        // Between epochs, move samples toward faster ranks when the slowest
+        // rank's compute time exceeds the mean by more than this fraction;
+        // 0 keeps the initial even split
+        double rebalanceThreshold = 0.0;
     };
 
     DistributedTrainer(int argc, char** argv);
@@ -33,49 +103,379 @@ public:
     // Validate and set training configuration
     void validateAndSetConfig(const TrainingConfig& config);
 
-    // Distribute training data across nodes
-    void distributeData(const std::vector<cv::Mat>& trainingData);
+    // Scatter labelled training data from rank 0 so each node holds only its
+    // shard. Only the root's arguments are read; other ranks may pass empty vectors.
+    void distributeData(const std::vector<cv::Mat>& trainingData, const std::vector<int32_t>& labels);
+
+    // Map a binary shard file and take this node's range of samples
+    // without reading or copying them up front
+    void loadShard(const std::string& shardPath);
+
+    // Make the world size elastic: found a job through the store or join
+    // the running one, which admits this process at its next epoch
+    // boundary. Call before loading data. Training then needs a shard file,
+    // which ranks re-partition whenever membership changes. Collective over
+    // the processes started together.
+    void enableElastic(std::unique_ptr<RendezvousStore> store);
 
     // Perform distributed training
     void train();
 
-    // Aggregate results from all nodes
+    // Score every rank's samples with its trained model (the same model on
+    // all ranks in synchronous mode) and stream the class probabilities to
+    // sink on rank 0, one row per sample in global sample order. At most
+    // chunkRows rows are in memory at a time on any rank. Collective; sink
+    // may be null on ranks other than 0.
+    void aggregateResults(ResultSink* sink, Eigen::Index chunkRows = 4096);
+
+    // Same, collected into a matrix on rank 0; empty on other ranks
     Eigen::MatrixXd aggregateResults();
 
     // Get performance metrics
     nlohmann::json getPerformanceMetrics() const;
 
+    // Rank of this process in the training communicator
+    int getRank() const { return m_rank; }
+
+    // Active training configuration
+    const TrainingConfig& getConfig() const { return m_config; }
+
+    // Span timings of the training loop
+    PerformanceTracker& getTracker() { return m_tracker; }
+
+    // Live counters and histograms of this rank, for scraping
+    const MetricsRegistry& getMetricsRegistry() const { return m_metrics; }
+    MetricsRegistry& getMetricsRegistry() { return m_metrics; }
+
+    // This rank's model; in local SGD mode it is only averaged at rounds
+    const MlpModel& getModel() const { return m_model; }
+
+    // Report batches and epochs done to a running task, and stop at the
+    // next epoch boundary once it is cancelled on any rank. Null detaches.
+    void setTaskContext(TaskContext* context) { m_taskContext = context; }
+
+    // Called on every rank after each epoch with its epoch, loss and
+    // throughput, e.g. to stream them to the dashboard. Empty detaches.
+    using EpochCallback = std::function<void(const nlohmann::json&)>;
+    void setEpochCallback(EpochCallback callback) { m_epochCallback = std::move(callback); }
+
+    // Gather the recorded spans of every rank into one Chrome trace file
+    // on rank 0. Collective.
+    void exportTimeline(const std::string& path);
+
 private:
-    // Local batch processing
-    Eigen::VectorXd processLocalBatch(const std::vector<cv::Mat>& localBatch);
+    // Split the training communicator into nodes and node leaders
+    void setupCommunicators();
+
+    // Build the model once the input shape and class count are known
+    void buildModel();
+
+    // Allocate the model, its workspaces and the thread pool for a class
+    // count; parameters are left uninitialized
+    void createModel(Eigen::Index classes);
+
+    // Forward/backward pass over a local batch; the summed gradient is left
+    // in m_workspace.gradient and the summed loss is returned
+    double processLocalBatch(const BatchView& localBatch, const int32_t* labels);
+
+    // One globally averaged gradient step per epoch, reduced in overlapped
+    // buckets. Returns the number of epochs completed.
+    int trainSynchronous(int firstEpoch, int batchesPerEpoch);
 
-    // Compute local loss
-    double computeLocalLoss(const Eigen::VectorXd& localGradient);
+    // Local steps on every batch; models are averaged every averagingInterval
+    // steps without blocking, and each average is applied within maxStaleness
+    // steps. Returns the number of epochs completed.
+    int trainLocalSgd(int firstEpoch, int batchesPerEpoch);
 
-    // Aggregate gradients across nodes
-    Eigen::VectorXd aggregateGradients(const std::vector<Eigen::VectorXd>& localGradients);
+    // Replace every rank's parameters with their exact mean
+    void averageModels();
 
-    // Aggregate loss across nodes
-    double aggregateLoss(double localLoss);
+    // Load the checkpoint into the root's model, if one exists; returns
+    // the number of epochs it had completed
+    int restoreCheckpoint();
 
-    // Update model parameters
-    void updateModelParameters(const Eigen::VectorXd& globalGradient, double globalLoss);
+    // Whether a checkpoint is due after the given number of epochs
+    bool checkpointDue(int completedEpochs) const;
+    void saveCheckpoint(int completedEpochs);
 
-    // Synchronize initial model parameters
+    // Snapshot the parameters and start summing them across ranks
+    void startModelAveraging(long long step);
+
+    // Apply a finished average (waiting for it when wait is set); returns
+    // whether an average was applied
+    bool completeModelAveraging(bool wait);
+
+    // Start preparing batchesPerEpoch batches per epoch from firstEpoch on
+    void startInputPipeline(int firstEpoch, int batchesPerEpoch);
+
+    // Next prepared batch, recording how long the loop waited for it
+    InputBatch nextInputBatch();
+
+    // Split a batch into micro-batches across the thread pool and reduce the
+    // per-thread gradients into m_workspace.gradient
+    double processBatchParallel(const BatchView& localBatch, const int32_t* labels);
+
+    // Pairwise tree reduction of per-thread gradients into thread 0
+    void reduceThreadGradients();
+
+    // Wait for outstanding gradient buckets and average over all samples;
+    // the result lives in the step arena
+    StepArena::VectorMap aggregateGradients(double globalSamples);
+
+    // Samples in mini-batches [firstBatch, endBatch) summed over all ranks,
+    // from the counts gathered by agreeOnBatchesPerEpoch
+    double globalSamplesInBatches(int firstBatch, int endBatch) const;
+
+    // Aggregate summed loss and sample count across nodes; returns the
+    // mean loss per sample. Also agrees on whether any rank's task was
+    // cancelled (m_stopRequested) and shares every rank's compute and wait
+    // time for the epoch (m_rankLoads).
+    double aggregateLoss(double localLoss, double localSamples, double& globalSamples);
+
+    // One optimizer step with the globally averaged gradient
+    void updateModelParameters(const Eigen::Ref<const Eigen::VectorXd>& globalGradient);
+
+    // Allocations counted so far: this thread's heap allocations when
+    // counting is enabled, otherwise the step arena's heap blocks
+    uint64_t stepAllocationCount() const;
+
+    // Add what was counted since the last call to the step allocation count
+    void countStepAllocations();
+
+    // Broadcast the root's parameters and optimizer state
     void synchronizeModelParameters();
 
     // Early stopping condition
     bool shouldStopTraining(double globalLoss);
 
+    // Take this node's range of the mapped shard for the current world size
+    void assignShardRange();
+    void mapShardRange(size_t begin, size_t end);
+
+    // Batch size this rank trains with; scaled with its share of the
+    // samples once the load has been rebalanced
+    int localBatchSize() const { return m_localBatchSize > 0 ? m_localBatchSize : m_config.batchSize; }
+
+    // Size the batch scratch space for the local batch size
+    void allocateWorkspaces();
+
+    // Move samples toward faster ranks when the last epoch's compute times
+    // diverge by more than the configured threshold. Stops the input
+    // pipeline and updates batchesPerEpoch when data moved; the caller
+    // restarts the pipeline. Collective.
+    bool rebalanceLoad(int& batchesPerEpoch);
+
+    // Hand samples between ranks so that rank r holds counts[r] of them,
+    // keeping global sample order. Point-to-point exchange with the ranks
+    // whose ranges overlap; shard ranges are simply remapped. Collective.
+    void migrateSamples(const std::vector<long long>& counts);
+
+    // Ranks agree on the mini-batches per epoch, the maximum over ranks,
+    // and learn every rank's sample count
+    int agreeOnBatchesPerEpoch();
+
+    // Membership change pending at an epoch boundary
+    enum class MembershipChange {
+        None,
+        Join,     // groups are waiting to be admitted
+        Failure   // a rank was lost
+    };
+
+    // Admit waiting groups or shrink to the survivors, then resume
+    // training on the new communicator. Collective.
+    void changeMembership(int& completedEpochs, int& batchesPerEpoch);
+
+    // Drop everything built on the current communicator
+    void releaseCommunicatorState();
+
+    // Bring every member of a new communicator to the same state: agree on
+    // the epochs completed, re-broadcast the survivors' parameters (newcomers
+    // build their model first), re-partition the shard and rebuild the
+    // collectives. After a failure, steps of the interrupted epoch are
+    // undone. Collective.
+    void resumeWithMembers(bool newcomer, bool afterFailure, int& completedEpochs, int& batchesPerEpoch);
+
+    // Publish the rank loads shared by the last loss reduction and fold
+    // them into the smoothed per-rank throughput
+    void updateRankLoads(const double* loads);
+
+    // Publish one epoch's loss and throughput to the live metrics and the
+    // epoch callback, if set
+    void reportEpoch(int completedEpochs, double globalLoss, double globalSamples,
+                     std::chrono::steady_clock::time_point epochStart);
+
     int m_rank;
     int m_worldSize;
     MPI_Comm m_communicator;
+    // Whether this trainer initialized MPI and must finalize it
+    bool m_ownsMpi = true;
+
+    // Node-local and leader communicators for two-level collectives
+    std::unique_ptr<CommunicatorTopology> m_topology;
+
+    // Local training data (view into m_localStorage or m_shard)
+    BatchView m_localData;
+
+    // Contiguous aligned storage for this node's shard
+    BatchTensor m_localStorage;
+
+    // Class label of each local sample
+    std::vector<int32_t> m_localLabels;
+
+    // Memory-mapped shard file, when data comes from disk
+    std::unique_ptr<ShardReader> m_shard;
+
+    // Image shape of one sample, for augmentation
+    int m_sampleRows = 0;
+    int m_sampleCols = 0;
+    int m_sampleChannels = 1;
+
+    // Batches prepared ahead of the training loop
+    std::unique_ptr<InputPipeline> m_input;
 
-    // Local training data
-    std::vector<cv::Mat> m_localData;
+    // Number of samples across all nodes
+    size_t m_totalDataSize = 0;
 
     // Training configuration
     TrainingConfig m_config;
+
+    // Model with flat parameter vector and its batch scratch space
+    MlpModel m_model;
+    MlpModel::Workspace m_workspace;
+    std::unique_ptr<Optimizer> m_optimizer;
+    // Gradient summed over the micro-batches of a step
+    Eigen::VectorXd m_accumulatedGradient;
+    // Buffers that live for one optimizer step, rewound at each step
+    StepArena m_stepArena;
+    // Heap allocations made inside the step loop: the training thread's
+    // count at the last mark, this epoch's total and the last epoch's
+    uint64_t m_allocationMark = 0;
+    uint64_t m_epochStepAllocations = 0;
+    uint64_t m_lastEpochStepAllocations = 0;
+    // Local sample count and batch size of every rank
+    std::vector<long long> m_rankSamples;
+    std::vector<long long> m_rankBatchSizes;
+    // 0 until rebalancing gives this rank its own batch size
+    int m_localBatchSize = 0;
+
+    // Straggler tracking: this rank's time in forward/backward passes and
+    // blocked on gradient or model reductions during the current epoch,
+    // and every rank's figures for the last epoch
+    struct RankLoad {
+        double computeSeconds = 0.0;
+        double waitSeconds = 0.0;
+        double samples = 0.0;
+    };
+    uint64_t m_epochComputeNanos = 0;
+    uint64_t m_epochWaitNanos = 0;
+    double m_epochComputedSamples = 0.0;
+    std::vector<RankLoad> m_rankLoads;
+    // Samples per second of compute per rank, smoothed over epochs
+    std::vector<double> m_rankRates;
+    int m_rebalances = 0;
+    uint64_t m_samplesMigrated = 0;
+
+    // Per-worker gradient accumulators for hybrid MPI + threads mode
+    struct alignas(64) ThreadState {
+        MlpModel::Workspace workspace;
+        double loss = 0.0;
+        bool touched = false;
+        uint64_t allocations = 0;
+    };
+    std::unique_ptr<ThreadPool> m_threadPool;
+    std::vector<ThreadState> m_threadStates;
+    // Busy fraction of each worker over the last completed epoch
+    std::vector<double> m_epochThreadUtilization;
+    std::vector<size_t> m_reduceTargets;
+
+    // Overlapped gradient reduction engine
+    std::unique_ptr<GradientBucketer> m_gradientBucketer;
+
+    // Local SGD model averaging in flight: the parameters at launch and
+    // the buffer being summed across ranks
+    Eigen::VectorXd m_averagingSnapshot;
+    Eigen::VectorXd m_averagingBuffer;
+    MPI_Request m_averagingRequest = MPI_REQUEST_NULL;
+    long long m_averagingStep = 0;
+    int m_averagingRounds = 0;
+    double m_averagingWaitSeconds = 0.0;
+
+    // Training loop tracing; span ids are interned once at startup
+    PerformanceTracker m_tracker;
+    struct SpanIds {
+        MetricId epoch;
+        MetricId batch;
+        MetricId forwardBackward;
+        MetricId microBatch;
+        MetricId bucketAppend;
+        MetricId lossAllreduce;
+        MetricId gradientAllreduce;
+        MetricId optimizerStep;
+        MetricId averagingWait;
+        MetricId checkpoint;
+        MetricId inputWait;
+    } m_spans{};
+
+    // Live metrics, registered at startup; the training loop updates them
+    // through these pointers with relaxed atomics
+    MetricsRegistry m_metrics;
+    struct LiveMetrics {
+        Counter* samples;
+        Counter* allreduceBytes;
+        Histogram* stepSeconds;
+        Histogram* gradientAllreduceSeconds;
+        Histogram* lossAllreduceSeconds;
+        Histogram* averagingWaitSeconds;
+        Gauge* globalLoss;
+        Gauge* samplesPerSecond;
+        Gauge* epochsDone;
+        Gauge* computeSeconds;
+        Gauge* rankSkewSeconds;
+        Gauge* loadImbalance;
+        Counter* rebalances;
+        Gauge* worldSize;
+        Counter* membershipChanges;
+        Histogram* inputWaitSeconds;
+        Counter* inputStarvedBatches;
+        Counter* optimizerSteps;
+        Counter* stepAllocations;
+    } m_live{};
+    uint64_t m_reportedWireBytes = 0;
+
+    // Cross-rank clock alignment for timeline export, when traceFile is set
+    std::unique_ptr<TimelineRecorder> m_timeline;
+
+    // Task this training run reports progress to, if any
+    TaskContext* m_taskContext = nullptr;
+    bool m_stopRequested = false;
+    EpochCallback m_epochCallback;
+
+    // Periodic model snapshots, when checkpointPath is set
+    std::unique_ptr<CheckpointManager> m_checkpoints;
+    int m_resumedEpoch = 0;
+
+    // Early stopping state
+    double m_bestLoss = std::numeric_limits<double>::max();
+    int m_epochsWithoutImprovement = 0;
+
+    // Elastic membership, when enabled. In synchronous mode the model and
+    // optimizer state at the start of the current and the previous epoch
+    // are kept, so ranks can undo the steps of an epoch that was abandoned.
+    struct TrainingSnapshot {
+        Eigen::VectorXd parameters;
+        std::vector<Eigen::VectorXd> optimizerState;
+        uint64_t optimizerSteps = 0;
+    };
+    TrainingSnapshot captureState() const;
+    void restoreState(const TrainingSnapshot& snapshot);
+
+    std::unique_ptr<ElasticCoordinator> m_elastic;
+    MembershipChange m_membershipChange = MembershipChange::None;
+    // Joined a running job and still needs its state
+    bool m_newcomer = false;
+    int m_pendingJoins = 0;
+    TrainingSnapshot m_epochStartState;
+    TrainingSnapshot m_previousEpochState;
 };
 
 } // namespace DistributedML
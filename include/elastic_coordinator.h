@@ -0,0 +1,90 @@
+#pragma once
+
+#include <mpi.h>
+#include <memory>
+#include <string>
+#include "rendezvous_store.h"
+
+namespace DistributedML {
+
+// Membership of an elastic training job. The job's ranks share one
+// intracommunicator, which is replaced whenever ranks join or fail:
+//
+// - The first group to start founds the job: its rank 0 claims the store's
+//   leader key and publishes an MPI port. Groups started later (e.g. pods
+//   added by the autoscaler) register a join request and connect to that
+//   port; at the next epoch boundary the job accepts them and merges them
+//   into a new communicator.
+// - With ULFM (MPIX_Comm_shrink), a collective that fails because a rank
+//   died revokes the communicator, and the survivors shrink it to the
+//   ranks still alive. Without ULFM a rank loss stays fatal; relaunch the
+//   job and it resumes from its checkpoint at the new size.
+//
+// The coordinator owns the communicators it creates; the trainer rebuilds
+// everything derived from them after each change.
+class ElasticCoordinator {
+public:
+    // Found the job or join the running one, as decided by the store.
+    // Collective over world; joiners return once they have been admitted.
+    ElasticCoordinator(MPI_Comm world, std::unique_ptr<RendezvousStore> store);
+    ~ElasticCoordinator();
+
+    // Prevent copying (owns communicators and the port)
+    ElasticCoordinator(const ElasticCoordinator&) = delete;
+    ElasticCoordinator& operator=(const ElasticCoordinator&) = delete;
+
+    // Communicator holding every current member
+    MPI_Comm communicator() const { return m_communicator; }
+
+    // Whether this process joined a running job, as opposed to founding it
+    bool joinedRunningJob() const { return m_joined; }
+
+    // Join requests not admitted yet. Reads the store; only meaningful on rank 0.
+    int pendingJoins() const;
+
+    // Accept pending join requests and merge them in, replacing
+    // communicator(). The count is read on rank 0. Collective.
+    void admit(int pending);
+
+    // Whether a collective reported a failed or revoked peer since the
+    // last shrink. Always false without ULFM.
+    bool failureDetected() const;
+
+    // Interrupt collectives still pending on a communicator derived from
+    // ours, so that no rank waits on a peer that has given up. No-op
+    // without ULFM.
+    void revoke(MPI_Comm communicator) const;
+
+    // Replace communicator() by one holding only the live ranks. Collective
+    // over the survivors; throws when MPI lacks ULFM.
+    void shrink();
+
+    // Whether this MPI library can survive rank loss
+    static bool faultTolerant();
+
+    // Number of membership changes so far
+    int generation() const { return m_generation; }
+
+private:
+    // Take ownership of a new member communicator, freeing the previous one
+    void adopt(MPI_Comm communicator);
+
+    // Open a port on rank 0 and publish it, unless this rank already has
+    void publishPort();
+
+    // Port of the running job, polled from the store
+    std::string waitForPort() const;
+
+    std::unique_ptr<RendezvousStore> m_store;
+    MPI_Comm m_communicator;
+    bool m_ownsCommunicator;
+    MPI_Errhandler m_errorHandler;
+    bool m_joined;
+    int m_generation;
+
+    // Rank 0 only: port new groups connect to
+    char m_portName[MPI_MAX_PORT_NAME];
+    bool m_portOpen;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include "communicator_topology.h"
+#include "gradient_compressor.h"
+
+namespace DistributedML {
+
+// Streams gradients into fixed-size contiguous buckets and reduces each
+// bucket with non-blocking collectives as soon as it fills, so the reduction
+// of early buckets overlaps with filling and reducing the later ones.
+// Buckets can optionally travel in a compressed wire format.
+//
+// Reduction is hierarchical. Bucket buffers live in a node-shared memory
+// window: the node leader sums its node's buckets in place, runs the
+// (possibly compressed) allreduce with the other leaders, and publishes the
+// result back through the window. Buckets move through these stages in
+// launch order on every rank, so collectives on each communicator match.
+//
+// Every rank must append the same number of gradients per step so that the
+// sequence of collectives matches; ranks that run out of data append zeros.
+class GradientBucketer {
+public:
+    GradientBucketer(const CommunicatorTopology& topology, std::size_t bucketElements, std::size_t maxInFlight,
+                     CompressionMode compression = CompressionMode::None, double topKRatio = 0.01);
+    ~GradientBucketer();
+
+    // Prevent copying (buffers are referenced by outstanding MPI requests)
+    GradientBucketer(const GradientBucketer&) = delete;
+    GradientBucketer& operator=(const GradientBucketer&) = delete;
+
+    // Start a new step whose gradients all have the given length
+    void beginStep(Eigen::Index gradientSize);
+
+    // Append one gradient to the stream, launching buckets as they fill
+    void append(const Eigen::VectorXd& gradient);
+
+    // Append an all-zero gradient to keep collective calls aligned across ranks
+    void appendZeros();
+
+    // Flush the partial bucket, wait for outstanding reductions and return
+    // the element-wise sum of every gradient appended on every rank
+    const Eigen::VectorXd& finishStep();
+
+    // Number of buckets launched during the current step
+    std::size_t bucketsLaunched() const { return m_bucketsLaunched; }
+
+    // Inter-node compressor; null on ranks that are not node leaders
+    const GradientCompressor* compressor() const { return m_compressor.get(); }
+
+private:
+    // Stages of a launched bucket, in the order it passes through them
+    enum class Stage {
+        NodeReduce,     // waiting for every local rank to publish its bucket
+        InterNode,      // leader allreduce in flight
+        NodeBroadcast,  // waiting for the leader to publish the result
+        Idle            // folded into the step result, or never launched
+    };
+
+    struct Bucket {
+        double* buffer = nullptr;   // this rank's slot in the shared window
+        double* result = nullptr;   // slot where the leader publishes the reduced bucket
+        std::size_t size = 0;
+        std::size_t streamOffset = 0;
+        Stage stage = Stage::Idle;
+        MPI_Request request = MPI_REQUEST_NULL;
+    };
+
+    // Copy (or zero-fill) values into the stream
+    void write(const double* values, std::size_t count);
+
+    // Start the reduction of the current bucket and advance to the next slot
+    void launchCurrent();
+
+    // Move in-flight buckets forward without blocking, oldest first
+    void progress();
+
+    // Finish the current stage of a bucket once its request completes
+    // (immediately when wait is set); returns whether the bucket moved on
+    bool advance(Bucket& bucket, bool wait);
+
+    // Drive a bucket to completion and add its reduced values into the step result
+    void retire(Bucket& bucket);
+    void fold(const Bucket& bucket, const double* values);
+
+    std::size_t slotIndex(const Bucket& bucket) const {
+        return static_cast<std::size_t>(&bucket - m_buckets.data());
+    }
+
+    const CommunicatorTopology& m_topology;
+    MPI_Comm m_resultCommunicator;
+    MPI_Win m_window;
+    std::size_t m_bucketElements;
+    std::vector<Bucket> m_buckets;
+    // Base of every local rank's bucket slots (leader only)
+    std::vector<const double*> m_nodeBuffers;
+    std::size_t m_current;
+    bool m_filling;
+    std::size_t m_streamOffset;
+    std::size_t m_bucketsLaunched;
+    Eigen::VectorXd m_result;
+    std::unique_ptr<GradientCompressor> m_compressor;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+namespace DistributedML {
+
+// Wire formats for gradient buckets
+enum class CompressionMode {
+    None,   // full MPI_DOUBLE allreduce
+    FP16,   // IEEE half precision of each rank's share, summed in float by a custom MPI op
+    BF16,   // bfloat16, summed in float by a custom MPI op
+    TopK,   // largest-magnitude fraction of each bucket, exchanged with allgather
+    Int8    // 8-bit blocks with a per-block scale, requantized by a custom MPI op
+            // (adds up to (ranks - 1) / 254 of each block's largest sum)
+};
+
+// Parse "none", "fp16", "bf16", "topk" or "int8"
+CompressionMode parseCompressionMode(const std::string& name);
+const char* compressionModeName(CompressionMode mode);
+
+// Encodes gradient buckets for the wire, starts their non-blocking
+// reduction and decodes the result. Lossy modes use error feedback: the
+// part of each value that was not transmitted is kept in a per-parameter
+// residual on this rank and added back the next time that parameter is sent.
+class GradientCompressor {
+public:
+    GradientCompressor(MPI_Comm communicator, CompressionMode mode, size_t bucketElements,
+                       size_t slots, double topKRatio);
+    ~GradientCompressor();
+
+    // Prevent copying (owns MPI datatypes and operations)
+    GradientCompressor(const GradientCompressor&) = delete;
+    GradientCompressor& operator=(const GradientCompressor&) = delete;
+
+    // Size the residual for gradients of the given length
+    void setGradientSize(Eigen::Index gradientSize);
+
+    // Encode count values whose first element is gradient index
+    // gradientOffset (wrapping at the gradient size) and start reducing
+    // them. The values buffer is used as scratch until finish().
+    void start(size_t slot, double* values, size_t count, size_t gradientOffset, MPI_Request* request);
+
+    // Decode the completed reduction of a slot back into values
+    void finish(size_t slot, double* values, size_t count);
+
+    CompressionMode mode() const { return m_mode; }
+
+    // Bytes this rank handed to MPI, and what they would have been uncompressed
+    uint64_t wireBytes() const { return m_wireBytes; }
+    uint64_t rawBytes() const { return m_rawBytes; }
+
+private:
+    struct Slot {
+        std::vector<unsigned char> send;
+        std::vector<unsigned char> receive;
+    };
+
+    // Add residuals into values and clear them (so duplicates telescope)
+    void applyResidual(double* values, size_t count, size_t gradientOffset);
+
+    // Add the untransmitted part of each value back into the residual
+    void storeResidual(const double* errors, size_t count, size_t gradientOffset);
+
+    size_t topKCount(size_t count) const;
+
+    MPI_Comm m_communicator;
+    CompressionMode m_mode;
+    double m_topKRatio;
+    int m_worldSize;
+    std::vector<Slot> m_slots;
+    Eigen::VectorXd m_residual;
+    std::vector<uint32_t> m_indexScratch;
+    MPI_Datatype m_wireType;
+    MPI_Op m_sumOp;
+    uint64_t m_wireBytes;
+    uint64_t m_rawBytes;
+};
+
+} // namespace DistributedML
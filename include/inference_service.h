@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "metrics_registry.h"
+#include "mlp_model.h"
+
+namespace DistributedML {
+
+// Serves class predictions from a trained model with dynamic batching.
+// Requests queue up and a pool of batch workers takes turns collecting
+// them: the collecting worker holds a batch open until it reaches
+// maxBatch requests or its oldest request has waited maxWait, then runs
+// the whole batch as one forward pass (one GEMM per layer) while the next
+// worker starts collecting. Results are delivered through callbacks, so
+// callers such as HTTP handlers never block on a prediction.
+//
+// The model can be replaced at any time, e.g. after every training epoch;
+// batches already running finish on the model they started with.
+class InferenceService {
+public:
+    struct Options {
+        // Largest batch run as one forward pass
+        Eigen::Index maxBatch = 32;
+        // Longest a request waits for others to share its batch
+        std::chrono::microseconds maxWait{2000};
+        // Batch worker threads
+        int workers = 2;
+        // Requests allowed to wait before submit() refuses more
+        size_t maxQueue = 1024;
+    };
+
+    struct Prediction {
+        int32_t label = 0;
+        std::vector<double> probabilities;
+    };
+
+    // Receives the prediction, or an error with a null prediction
+    using Callback = std::function<void(const Prediction* prediction, std::exception_ptr error)>;
+
+    // Latency and batch-fill metrics are registered in metrics
+    InferenceService(const Options& options, MetricsRegistry& metrics);
+    ~InferenceService();
+
+    // Prevent copying (workers capture this)
+    InferenceService(const InferenceService&) = delete;
+    InferenceService& operator=(const InferenceService&) = delete;
+
+    // Serve predictions from a copy of model
+    void setModel(const MlpModel& model);
+
+    // Whether a model has been set
+    bool ready() const;
+
+    // Input features the current model expects (0 before the first model)
+    Eigen::Index inputSize() const;
+
+    // Queue one sample. Returns false when the queue is full; throws
+    // std::invalid_argument when no model is set or the feature count does
+    // not match it. done runs on a batch worker thread.
+    bool submit(std::vector<float> features, Callback done);
+
+    // Fail queued requests and join the workers
+    void stop();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::vector<float> features;
+        Callback done;
+        Clock::time_point arrival;
+    };
+
+    void workerLoop();
+
+    // Forward pass over a collected batch, then answer every request in it
+    void runBatch(std::vector<Request>& batch, const MlpModel& model, BatchTensor& staging,
+                  MlpModel::Workspace& workspace);
+
+    const Options m_options;
+
+    mutable std::mutex m_mutex;
+    // Idle workers wait for requests and for the collector role to be free
+    std::condition_variable m_work;
+    // The collecting worker waits for its batch to fill
+    std::condition_variable m_fill;
+    std::deque<Request> m_queue;
+    std::shared_ptr<const MlpModel> m_model;
+    bool m_collecting = false;
+    bool m_stop = false;
+
+    Counter& m_requests;
+    Counter& m_rejected;
+    Histogram& m_latencySeconds;
+    Histogram& m_batchFill;
+
+    std::vector<std::thread> m_workers;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "batch_tensor.h"
+
+namespace DistributedML {
+
+// Per-sample preprocessing applied while batches are prepared
+struct AugmentationOptions {
+    // Every feature becomes (x - mean) / std
+    float normalizeMean = 0.0f;
+    float normalizeStd = 1.0f;
+    // Chance of mirroring an image left to right
+    double flipProbability = 0.0;
+    // Random translation of up to this many pixels along each axis,
+    // filling the uncovered border with zeros
+    int maxShift = 0;
+
+    bool enabled() const {
+        return normalizeMean != 0.0f || normalizeStd != 1.0f || flipProbability > 0.0 || maxShift > 0;
+    }
+};
+
+// One prepared mini-batch; valid until the next call to InputPipeline::next()
+struct InputBatch {
+    BatchView samples;
+    const int32_t* labels = nullptr;
+    // Time the consumer waited for the batch (0 when it was already ready)
+    uint64_t waitNanos = 0;
+};
+
+// Prepares mini-batches ahead of the training loop in three stages:
+//
+//   reader thread   draws the epoch's shuffled order and gathers the raw
+//                   sample rows (and page faults on a mapped shard) into a
+//                   free slot
+//   augmenters      worker threads that normalize and augment the slot's
+//                   samples in place
+//   ready ring      bounded ring of prefetchDepth slots the trainer takes
+//                   batches from, in order
+//
+// Slots move between stages through a per-slot atomic stamp holding the
+// batch sequence number and stage, so hand-offs take no locks and each
+// transition has exactly one writer. Waiting stages spin briefly, then back
+// off to short sleeps.
+//
+// Each epoch's order is a shuffle seeded by (seed, rank, epoch), and each
+// batch's augmentation draws from (seed, rank, epoch, batch), so a run is
+// reproducible regardless of thread timing.
+class InputPipeline {
+public:
+    struct Options {
+        Eigen::Index batchSize = 32;
+        // Batches prepared ahead of the consumer
+        int prefetchDepth = 4;
+        // Augmenter threads
+        int workers = 2;
+        bool shuffle = true;
+        uint64_t seed = 0;
+        int rank = 0;
+        // Image shape of one sample (features = rows * cols * channels),
+        // needed for flips and shifts
+        int rows = 0;
+        int cols = 0;
+        int channels = 1;
+        AugmentationOptions augmentation;
+    };
+
+    // Counters for telling input-bound from compute-bound runs
+    struct Stats {
+        uint64_t batches = 0;
+        // Batches the consumer had to wait for, and the total wait
+        uint64_t starvedBatches = 0;
+        double starvedSeconds = 0.0;
+        // Time the reader waited for a free slot (the consumer was behind)
+        double readerBlockedSeconds = 0.0;
+    };
+
+    // Serve batchesPerEpoch batches for each epoch in [firstEpoch, lastEpoch).
+    // Batches past the end of the source wrap around to its start. The
+    // source and labels must outlive the pipeline.
+    InputPipeline(const BatchView& source, const int32_t* labels, int firstEpoch, int lastEpoch,
+                  int batchesPerEpoch, const Options& options);
+    ~InputPipeline();
+
+    // Prevent copying (owns threads that reference the slots)
+    InputPipeline(const InputPipeline&) = delete;
+    InputPipeline& operator=(const InputPipeline&) = delete;
+
+    // Block until the next batch in order is ready and release the previous
+    // one. Rethrows a failure from any stage.
+    InputBatch next();
+
+    // Stop and join the threads; batches not yet taken are discarded
+    void stop();
+
+    Stats stats() const;
+
+private:
+    // Stage a slot is in, packed with the batch sequence into its stamp
+    enum Stage : uint64_t {
+        Free = 0,
+        Read = 1,
+        Ready = 2
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> stamp{0};
+        BatchTensor tensor;
+        std::vector<int32_t> labels;
+        Eigen::Index samples = 0;
+    };
+
+    static uint64_t stampOf(uint64_t sequence, Stage stage) { return sequence * 4 + stage; }
+
+    // Spin, then sleep, until the slot reaches the stamp; false once stopped
+    bool waitFor(const Slot& slot, uint64_t stamp) const;
+
+    void readLoop();
+    void augmentLoop();
+    void augment(Slot& slot, uint64_t sequence);
+    void fail(std::exception_ptr error);
+
+    const BatchView m_source;
+    const int32_t* m_labels;
+    const int m_firstEpoch;
+    const int m_batchesPerEpoch;
+    const uint64_t m_totalBatches;
+    const Options m_options;
+    const bool m_augmenting;
+
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    std::atomic<uint64_t> m_nextAugment{0};
+    uint64_t m_nextConsume = 0;
+    bool m_holdingSlot = false;
+
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_failed{false};
+    std::mutex m_errorMutex;
+    std::exception_ptr m_error;
+
+    std::atomic<uint64_t> m_starvedBatches{0};
+    std::atomic<uint64_t> m_starvedNanos{0};
+    std::atomic<uint64_t> m_readerBlockedNanos{0};
+
+    std::thread m_reader;
+    std::vector<std::thread> m_augmenters;
+};
+
+} // namespace DistributedML
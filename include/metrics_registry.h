@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace DistributedML {
+
+// Monotonic count, e.g. samples or bytes processed
+class Counter {
+public:
+    void inc(uint64_t amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value{0};
+};
+
+// Value that is set, e.g. the latest loss
+class Gauge {
+public:
+    void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+    double value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> m_value{0.0};
+};
+
+// Prometheus histogram with bucket bounds fixed at registration. Observing
+// is a short scan of the bounds and three relaxed atomic updates.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> upperBounds);
+
+    void observe(double value);
+
+    // Bounds in ascending order; one count per bound plus the +Inf bucket,
+    // not cumulative
+    const std::vector<double>& upperBounds() const { return m_upperBounds; }
+    uint64_t bucketCount(size_t bucket) const { return m_counts[bucket].load(std::memory_order_relaxed); }
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    double sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+    // count bounds growing by factor from start, e.g. 1ms, 2ms, 4ms, ...
+    static std::vector<double> exponentialBounds(double start, double factor, size_t count);
+
+private:
+    const std::vector<double> m_upperBounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<double> m_sum{0.0};
+};
+
+// Named counters, gauges and histograms for scraping. Metrics are created
+// once, off the hot path, and the returned references stay valid for the
+// registry's lifetime, so writers update them with plain atomics: no lock,
+// no allocation. Only registration and rendering take the registry lock.
+class MetricsRegistry {
+public:
+    MetricsRegistry() = default;
+
+    // Prevent copying (callers hold references to metrics)
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // Metric with a name, help text and optional label set such as
+    // op="gradient". Registering an existing name and labels returns the
+    // same metric; reusing a name with another type throws.
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help,
+                         const std::vector<double>& upperBounds, const std::string& labels = "");
+
+    // All metrics in the Prometheus text exposition format (version 0.0.4)
+    std::string renderPrometheus() const;
+
+private:
+    enum class MetricType { Counter, Gauge, Histogram };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    // Series of name and labels, creating the family and series if needed
+    Series& findOrCreate(const std::string& name, const std::string& help, MetricType type,
+                         const std::string& labels, bool& created);
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Family>> m_families;
+    std::unordered_map<std::string, Family*> m_byName;
+};
+
+} // namespace DistributedML
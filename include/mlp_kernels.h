@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <Eigen/Dense>
+#include "batch_tensor.h"
+
+namespace DistributedML {
+
+// Scalar type the forward and backward passes run in. Parameters,
+// gradients and optimizer state stay double either way; Float32 reads a
+// single-precision copy of the weights and widens its gradient on the way
+// out.
+enum class KernelPrecision {
+    Float64,
+    Float32
+};
+
+// Parse "f64" or "f32"
+KernelPrecision parseKernelPrecision(const std::string& name);
+const char* kernelPrecisionName(KernelPrecision precision);
+
+// Model parameters as kernels read them. Float32 kernels need the
+// single-precision copy; Float64 kernels read the doubles.
+struct KernelParameters {
+    const double* f64 = nullptr;
+    const float* f32 = nullptr;
+};
+
+// Per-workspace buffers of one kernel, created by that kernel
+struct KernelScratch {
+    virtual ~KernelScratch() = default;
+
+    // Kernel the buffers were sized and typed for
+    const void* owner = nullptr;
+};
+
+// Forward and backward passes of the two-layer perceptron over the flat
+// parameter layout described in MlpModel. Kernels hold no mutable state, so
+// one kernel is shared by every copy of a model and every thread; each
+// caller brings its own scratch.
+class MlpKernel {
+public:
+    virtual ~MlpKernel() = default;
+
+    // e.g. "f32 784x128x10", or "f64 dynamic" for the fallback
+    virtual std::string name() const = 0;
+    virtual KernelPrecision precision() const = 0;
+
+    // Whether the layer widths are compile-time constants
+    virtual bool specialized() const = 0;
+
+    Eigen::Index inputSize() const { return m_inputSize; }
+    Eigen::Index hiddenSize() const { return m_hiddenSize; }
+    Eigen::Index outputSize() const { return m_outputSize; }
+
+    // Buffers for batches of up to maxBatch samples
+    virtual std::unique_ptr<KernelScratch> createScratch(Eigen::Index maxBatch) const = 0;
+
+    // Class probabilities for the batch into the top rows of output
+    virtual void predict(const KernelParameters& parameters, const BatchView& batch, KernelScratch& scratch,
+                         Eigen::MatrixXd& output) const = 0;
+
+    // Gradient summed over the batch, added to the previous one when
+    // accumulate is set; returns the summed cross-entropy loss. Float64
+    // kernels write it into gradient. Float32 kernels sum it in single
+    // precision in the scratch and write it into gradient only when widen
+    // is set, so several batches can share one conversion.
+    virtual double computeGradient(const KernelParameters& parameters, const BatchView& batch, const int32_t* labels,
+                                   KernelScratch& scratch, double* gradient, bool accumulate, bool widen) const = 0;
+
+    // Write a gradient the scratch holds in single precision into gradient
+    // (nothing to do for Float64)
+    virtual void widenGradient(const KernelScratch& scratch, double* gradient) const = 0;
+
+protected:
+    MlpKernel(Eigen::Index inputSize, Eigen::Index hiddenSize, Eigen::Index outputSize)
+        : m_inputSize(inputSize), m_hiddenSize(hiddenSize), m_outputSize(outputSize) {}
+
+    Eigen::Index m_inputSize;
+    Eigen::Index m_hiddenSize;
+    Eigen::Index m_outputSize;
+};
+
+// Kernel for a model shape: the compile-time specialization registered for
+// that shape and precision when there is one, otherwise the dynamic-shape
+// kernel of that precision
+std::shared_ptr<const MlpKernel> selectMlpKernel(Eigen::Index inputSize, Eigen::Index hiddenSize,
+                                                 Eigen::Index outputSize, KernelPrecision precision);
+
+// The dynamic-shape kernel, whatever specializations exist
+std::shared_ptr<const MlpKernel> dynamicMlpKernel(Eigen::Index inputSize, Eigen::Index hiddenSize,
+                                                  Eigen::Index outputSize, KernelPrecision precision);
+
+} // namespace DistributedML
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <Eigen/Dense>
+#include "batch_tensor.h"
+#include "mlp_kernels.h"
+
+namespace DistributedML {
+
+// One weight matrix or bias vector within a flat parameter vector
+struct ParameterBlock {
+    Eigen::Index offset = 0;
+    Eigen::Index size = 0;
+    bool bias = false;
+};
+
+// Two-layer perceptron (input -> ReLU hidden -> softmax output) trained
+// with cross-entropy. All weights and biases live in one flat parameter
+// vector so they can be broadcast, reduced and updated as a single buffer:
+//
+//   [W1 (hidden x input)][b1 (hidden)][W2 (output x hidden)][b2 (output)]
+//
+// Weight blocks are column-major Eigen maps into that vector. The passes
+// themselves run in an MlpKernel picked for the model's shape and precision.
+class MlpModel {
+public:
+    // Per-thread scratch space for one batch; reused across steps
+    struct Workspace {
+        Eigen::MatrixXd output;
+        Eigen::VectorXd gradient;
+        // Buffers of the kernel the workspace was created for
+        std::unique_ptr<KernelScratch> scratch;
+    };
+
+    MlpModel() = default;
+    MlpModel(Eigen::Index inputSize, Eigen::Index hiddenSize, Eigen::Index outputSize,
+             KernelPrecision precision = KernelPrecision::Float64);
+
+    // Random initialization (He for the hidden layer, Xavier for the output)
+    void initialize(uint32_t seed);
+
+    // Allocate scratch space for batches of up to maxBatch samples.
+    // Workspaces only fit the kernel that was active when they were created.
+    Workspace createWorkspace(Eigen::Index maxBatch) const;
+
+    // Run the passes in another kernel of the same shape, e.g. one from
+    // dynamicMlpKernel() for comparison
+    void setKernel(std::shared_ptr<const MlpKernel> kernel);
+    const MlpKernel& kernel() const { return *m_kernel; }
+
+    // Forward and backward pass over a batch. Writes the gradient summed
+    // over samples into workspace.gradient (or adds the previous call's on
+    // this workspace when accumulate is set) and returns the summed loss.
+    // Without widen, a Float32 kernel leaves the gradient in single
+    // precision until widenGradient() is called.
+    double computeGradient(const BatchView& batch, const int32_t* labels, Workspace& workspace,
+                           bool accumulate = false, bool widen = true) const;
+    void widenGradient(Workspace& workspace) const;
+
+    // Class probabilities for a batch (rows of workspace.output)
+    void predict(const BatchView& batch, Workspace& workspace) const;
+
+    // Layout of the parameter vector, in order: W1, b1, W2, b2
+    std::vector<ParameterBlock> blocks() const;
+
+    // Mutable access marks the parameters changed, so Float32 kernels
+    // convert them again on their next pass
+    Eigen::VectorXd& parameters() {
+        ++m_parametersVersion;
+        return m_parameters;
+    }
+    const Eigen::VectorXd& parameters() const { return m_parameters; }
+    Eigen::Index parameterCount() const { return m_parameters.size(); }
+
+    Eigen::Index inputSize() const { return m_inputSize; }
+    Eigen::Index hiddenSize() const { return m_hiddenSize; }
+    Eigen::Index outputSize() const { return m_outputSize; }
+
+private:
+    // Single-precision copy of the parameters for Float32 kernels. It is
+    // converted on the first pass after the parameters change and shared
+    // by every thread running the model. Copies start out stale.
+    class ParameterMirror {
+    public:
+        ParameterMirror() = default;
+        ParameterMirror(const ParameterMirror&) {}
+        ParameterMirror& operator=(const ParameterMirror&) {
+            m_version.store(kStale, std::memory_order_relaxed);
+            return *this;
+        }
+
+        const float* get(const Eigen::VectorXd& parameters, uint64_t version);
+
+    private:
+        static constexpr uint64_t kStale = ~uint64_t(0);
+
+        std::mutex m_mutex;
+        // Parameter version the values were converted from
+        std::atomic<uint64_t> m_version{kStale};
+        Eigen::VectorXf m_values;
+    };
+
+    KernelParameters kernelParameters() const;
+
+    Eigen::Index m_inputSize = 0;
+    Eigen::Index m_hiddenSize = 0;
+    Eigen::Index m_outputSize = 0;
+
+    // Offsets of each block within the flat parameter vector
+    Eigen::Index m_w1Offset = 0;
+    Eigen::Index m_b1Offset = 0;
+    Eigen::Index m_w2Offset = 0;
+    Eigen::Index m_b2Offset = 0;
+
+    Eigen::VectorXd m_parameters;
+    uint64_t m_parametersVersion = 0;
+    mutable ParameterMirror m_mirror;
+    // Stateless, so shared by copies of the model
+    std::shared_ptr<const MlpKernel> m_kernel;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include "mlp_model.h"
+
+namespace DistributedML {
+
+// Update rules for the flat parameter vector
+enum class OptimizerKind {
+    SGD,    // gradient descent, with heavy-ball momentum when momentum > 0
+    Adam,   // Adam with decoupled weight decay (AdamW)
+    LAMB,   // Adam update rescaled per layer by ||w|| / ||update||
+    LARS    // momentum SGD rescaled per layer by ||w|| / ||gradient||
+};
+
+// Parse "sgd", "adam", "lamb" or "lars"
+OptimizerKind parseOptimizerKind(const std::string& name);
+const char* optimizerKindName(OptimizerKind kind);
+
+struct OptimizerOptions {
+    OptimizerKind kind = OptimizerKind::SGD;
+    // SGD and LARS
+    double momentum = 0.0;
+    // Adam and LAMB moment decay rates and denominator epsilon
+    double beta1 = 0.9;
+    double beta2 = 0.999;
+    double epsilon = 1e-8;
+    // Weight decay; never applied to bias blocks
+    double weightDecay = 0.0;
+    // LARS: scale of the per-layer trust ratio
+    double trustCoefficient = 0.001;
+};
+
+// Applies optimizer steps to a flat parameter vector. Blocks are walked in
+// chunks small enough to stay in L1, and every state update for a chunk
+// runs as vectorized Eigen array expressions before moving on, so SGD and
+// Adam make one pass over memory. LAMB and LARS need each layer's norms
+// before they can scale its step: LARS reads the block once more for the
+// weight and gradient norms, and LAMB writes the moments and the update
+// norm in one pass and applies the scaled update in a second. Bias blocks
+// keep a trust ratio of 1.
+//
+// State vectors have the length of the parameter vector, so checkpoints
+// can store them next to the parameters.
+class Optimizer {
+public:
+    Optimizer(const OptimizerOptions& options, std::vector<ParameterBlock> blocks);
+
+    // One update from gradient (averaged over the step's samples)
+    void step(Eigen::VectorXd& parameters, const Eigen::Ref<const Eigen::VectorXd>& gradient, double learningRate);
+
+    // Clear moments and velocity and restart the step count
+    void reset();
+
+    // Velocity (SGD with momentum, LARS) or first and second moments (Adam,
+    // LAMB); empty for plain SGD
+    std::vector<Eigen::VectorXd>& state() { return m_state; }
+    const std::vector<Eigen::VectorXd>& state() const { return m_state; }
+
+    // Steps taken, used for Adam's bias correction
+    uint64_t steps() const { return m_steps; }
+    void setSteps(uint64_t steps) { m_steps = steps; }
+
+    const OptimizerOptions& options() const { return m_options; }
+
+    // Whether the hyperparameters are in range: decay rates in [0, 1),
+    // positive epsilon and trust coefficient, non-negative weight decay
+    static bool valid(const OptimizerOptions& options);
+
+private:
+    void sgdBlock(const ParameterBlock& block, double* parameters, const double* gradient, double learningRate);
+    void adamBlock(const ParameterBlock& block, double* parameters, const double* gradient, double learningRate);
+    void larsBlock(const ParameterBlock& block, double* parameters, const double* gradient, double learningRate);
+
+    OptimizerOptions m_options;
+    std::vector<ParameterBlock> m_blocks;
+    Eigen::Index m_parameterCount;
+    std::vector<Eigen::VectorXd> m_state;
+    // LAMB: update direction, rescaled once the block's norms are known
+    Eigen::VectorXd m_update;
+    uint64_t m_steps;
+};
+
+} // namespace DistributedML
@@ -1,29 +1,205 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <nlohmann/json.hpp>
 
 namespace DistributedML {
 
+// Interned metric name
+using MetricId = uint32_t;
+
+// Log-linear latency histogram in the style of HdrHistogram: every power of
+// two is split into 32 linear sub-buckets, so any recorded nanosecond value
+// is reported within about 3% across the full 64-bit range in fixed memory.
+class LatencyHistogram {
+public:
+    void record(uint64_t nanos);
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const { return m_count; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_count ? static_cast<double>(m_total) / m_count : 0.0; }
+    uint64_t total() const { return m_total; }
+
+    // Value at quantile q in [0, 1], in nanoseconds
+    uint64_t percentile(double q) const;
+
+private:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr uint64_t kSubBuckets = 1u << kSubBucketBits;
+    static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t nanos);
+    static uint64_t bucketMidpoint(size_t bucket);
+
+    std::array<uint64_t, kBucketCount> m_counts{};
+    uint64_t m_count = 0;
+    uint64_t m_total = 0;
+    uint64_t m_max = 0;
+};
+
+// Span tracer for hot paths. Metric names are interned once; each thread
+// then records spans into its own lock-free single-producer ring buffer
+// through ScopedSpan, costing two clock reads and one ring write. Rings are
+// drained into per-metric histograms when metrics are read, so recording
+// never contends with readers. Spans nest; each records its depth.
 class PerformanceTracker {
 public:
+    // Span as recorded by a thread
+    struct SpanEvent {
+        uint64_t startNanos;
+        uint64_t durationNanos;
+        MetricId id;
+        uint32_t depth;
+    };
+
+    // Span kept for timeline export, tagged with the recording thread
+    struct TimelineEvent {
+        uint64_t startNanos;
+        uint64_t durationNanos;
+        MetricId id;
+        uint32_t depth;
+        uint32_t thread;
+        uint32_t reserved;
+    };
+
+    // Events per thread ring; spans are dropped (and counted) when full
+    static constexpr size_t kRingCapacity = 1u << 14;
+
+    PerformanceTracker();
+    ~PerformanceTracker();
+
+    // Prevent copying (threads cache pointers into the tracker)
+    PerformanceTracker(const PerformanceTracker&) = delete;
+    PerformanceTracker& operator=(const PerformanceTracker&) = delete;
+
+    // Id for a metric name, registering it on first use
+    MetricId intern(const std::string& metricName);
+
+    // Record a finished span directly
+    void record(MetricId id, uint64_t startNanos, uint64_t durationNanos);
+
     // Start tracking a specific metric
     void startTracking(const std::string& metricName);
 
     // Stop tracking and record metric
     void stopTracking(const std::string& metricName);
 
-    // Get performance metrics as JSON
+    // Get performance metrics as JSON: one entry per metric with count,
+    // mean and p50/p99/p999 latencies in milliseconds
     nlohmann::json getMetrics() const;
 
+    // Spans lost because a thread's ring was full
+    uint64_t droppedSpans() const;
+
+    // Drain the rings into the histograms now; call from a cold path (for
+    // example once per epoch) so rings never fill up between reads
+    void flush();
+
+    // Also keep up to maxEvents individual spans as they are drained
+    void enableTimeline(size_t maxEvents);
+
+    // Spans kept so far, in drain order, and metric names indexed by id
+    std::vector<TimelineEvent> timeline() const;
+    std::vector<std::string> metricNames() const;
+
+    // Monotonic clock used for spans, in nanoseconds
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
 private:
-    struct PerformanceMetric {
+    friend class ScopedSpan;
+
+    struct alignas(64) ThreadBuffer {
+        std::atomic<uint64_t> head{0};          // written by the owning thread
+        alignas(64) std::atomic<uint64_t> tail{0};  // written by the collector
+        alignas(64) std::vector<SpanEvent> events;
+        std::atomic<uint64_t> dropped{0};
+        uint32_t depth = 0;                     // owning thread only
+    };
+
+    struct MetricState {
         std::string name;
-        std::chrono::high_resolution_clock::time_point startTime;
-        std::chrono::high_resolution_clock::time_point endTime;
-        double duration;
+        LatencyHistogram histogram;
+        uint32_t depth = 0;
     };
 
-    std::vector<PerformanceMetric> m_metrics;
+    // This thread's ring, registering it on first use
+    ThreadBuffer& localBuffer();
+    ThreadBuffer& registerThread();
+
+    static void push(ThreadBuffer& buffer, const SpanEvent& event);
+
+    // Drain every ring into the histograms
+    void collect() const;
+
+    const uint64_t m_serial;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, MetricId> m_ids;
+    mutable std::vector<MetricState> m_metrics;
+    mutable std::vector<TimelineEvent> m_timeline;
+    size_t m_timelineCapacity = 0;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    std::unordered_map<std::thread::id, ThreadBuffer*> m_threadBuffers;
+    std::unordered_map<MetricId, uint64_t> m_openSpans;
 };
+
+// RAII timer: records a span for the enclosing scope
+class ScopedSpan {
+public:
+    ScopedSpan(PerformanceTracker& tracker, MetricId id)
+        : m_buffer(tracker.localBuffer()),
+          m_id(id),
+          m_depth(m_buffer.depth++),
+          m_start(PerformanceTracker::now()) {}
+
+    ~ScopedSpan() {
+        uint64_t end = PerformanceTracker::now();
+        --m_buffer.depth;
+        PerformanceTracker::push(m_buffer, {m_start, end - m_start, m_id, m_depth});
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    PerformanceTracker::ThreadBuffer& m_buffer;
+    MetricId m_id;
+    uint32_t m_depth;
+    uint64_t m_start;
+};
+
+inline PerformanceTracker::ThreadBuffer& PerformanceTracker::localBuffer() {
+    // Cache the last tracker this thread recorded into
+    thread_local uint64_t cachedSerial = 0;
+    thread_local ThreadBuffer* cachedBuffer = nullptr;
+    if (cachedSerial != m_serial) {
+        cachedBuffer = &registerThread();
+        cachedSerial = m_serial;
+    }
+    return *cachedBuffer;
+}
+
+inline void PerformanceTracker::push(ThreadBuffer& buffer, const SpanEvent& event) {
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >= kRingCapacity) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[head & (kRingCapacity - 1)] = event;
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+} // namespace DistributedML
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace DistributedML {
+
+// Small key-value store that processes use to find each other outside of
+// MPI, e.g. to publish the port a running job accepts new ranks on. Values
+// are short strings and every operation is atomic with respect to the
+// others. Keys may only contain letters, digits, '_', '-' and '.'.
+class RendezvousStore {
+public:
+    virtual ~RendezvousStore() = default;
+
+    virtual void set(const std::string& key, const std::string& value) = 0;
+
+    // Value of key, if present
+    virtual std::optional<std::string> get(const std::string& key) const = 0;
+
+    // Set key only when it is absent; returns whether it was set
+    virtual bool setIfAbsent(const std::string& key, const std::string& value) = 0;
+
+    // Add delta to an integer key (absent reads as 0) and return the new value
+    virtual int64_t add(const std::string& key, int64_t delta) = 0;
+
+    virtual void remove(const std::string& key) = 0;
+};
+
+// Store kept as one file per key in a directory, on the local host or a
+// volume shared by all pods. Operations serialize on an flock()ed lock
+// file in the directory; values are replaced by rename so readers never
+// see a partial write. A network store can take its place behind the
+// RendezvousStore interface.
+class FileRendezvousStore : public RendezvousStore {
+public:
+    // Creates the directory if needed
+    explicit FileRendezvousStore(const std::string& directory);
+    ~FileRendezvousStore() override;
+
+    // Prevent copying (owns the lock file descriptor)
+    FileRendezvousStore(const FileRendezvousStore&) = delete;
+    FileRendezvousStore& operator=(const FileRendezvousStore&) = delete;
+
+    void set(const std::string& key, const std::string& value) override;
+    std::optional<std::string> get(const std::string& key) const override;
+    bool setIfAbsent(const std::string& key, const std::string& value) override;
+    int64_t add(const std::string& key, int64_t delta) override;
+    void remove(const std::string& key) override;
+
+    const std::string& directory() const { return m_directory; }
+
+private:
+    // File holding a key; throws on keys that are not file-name safe
+    std::string pathOf(const std::string& key) const;
+
+    // Unlocked helpers; callers hold the lock
+    std::optional<std::string> read(const std::string& key) const;
+    void write(const std::string& key, const std::string& value);
+
+    std::string m_directory;
+    int m_lockFd;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <Eigen/Dense>
+
+namespace DistributedML {
+
+// Destination for result rows collected on rank 0. Rows arrive in chunks,
+// in global row order, as they come off the wire, so a sink that does not
+// keep them in memory bounds rank 0's footprint to one chunk.
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+
+    // Called once, before any rows, with the shape of the whole result
+    virtual void begin(Eigen::Index rows, Eigen::Index cols) = 0;
+
+    // count rows starting at global row firstRow, row-major
+    virtual void write(Eigen::Index firstRow, const double* rows, Eigen::Index count) = 0;
+
+    // Called once after the last row
+    virtual void finish() {}
+};
+
+// Collects the rows into an in-memory matrix
+class MatrixResultSink : public ResultSink {
+public:
+    void begin(Eigen::Index rows, Eigen::Index cols) override;
+    void write(Eigen::Index firstRow, const double* rows, Eigen::Index count) override;
+
+    const Eigen::MatrixXd& result() const { return m_result; }
+    Eigen::MatrixXd release() { return std::move(m_result); }
+
+private:
+    Eigen::MatrixXd m_result;
+};
+
+// On-disk layout of a result file:
+//
+//   [ResultFileHeader][row 0][row 1]...[row N-1]
+//
+// Rows are cols float64 values each, stored back to back.
+struct ResultFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t rows;
+    uint64_t cols;
+};
+
+constexpr char kResultMagic[8] = {'D', 'M', 'L', 'R', 'E', 'S', 'U', 'L'};
+constexpr uint32_t kResultVersion = 1;
+
+// Writes rows straight into a memory-mapped result file sized up front.
+// Each chunk's pages are sent to disk as it arrives and dropped from memory
+// once written, so dirty and resident pages stay bounded by two chunks.
+class MappedFileResultSink : public ResultSink {
+public:
+    explicit MappedFileResultSink(const std::string& path);
+    ~MappedFileResultSink() override;
+
+    // Prevent copying (owns the mapping)
+    MappedFileResultSink(const MappedFileResultSink&) = delete;
+    MappedFileResultSink& operator=(const MappedFileResultSink&) = delete;
+
+    void begin(Eigen::Index rows, Eigen::Index cols) override;
+    void write(Eigen::Index firstRow, const double* rows, Eigen::Index count) override;
+    void finish() override;
+
+private:
+    void unmap();
+
+    std::string m_path;
+    void* m_mapping;
+    size_t m_mappingBytes;
+    int m_fd;
+    // Byte range of the last chunk, whose write-back is in progress
+    size_t m_flushingBegin = 0;
+    size_t m_flushingEnd = 0;
+    double* m_rows;
+    Eigen::Index m_rowCount = 0;
+    Eigen::Index m_cols = 0;
+};
+
+// Writes the result file format to a stream as rows arrive; the stream
+// may be a pipe or socket since nothing is ever seeked
+class StreamResultSink : public ResultSink {
+public:
+    explicit StreamResultSink(std::ostream& stream) : m_stream(stream) {}
+
+    void begin(Eigen::Index rows, Eigen::Index cols) override;
+    void write(Eigen::Index firstRow, const double* rows, Eigen::Index count) override;
+    void finish() override;
+
+private:
+    std::ostream& m_stream;
+    Eigen::Index m_cols = 0;
+    Eigen::Index m_nextRow = 0;
+};
+
+// Fills count local rows starting at local row first, row-major, into rows
+using ResultProducer = std::function<void(Eigen::Index first, Eigen::Index count, double* rows)>;
+
+// Stream localRows rows of cols values from every rank to sink on rank 0,
+// in rank order. Row counts are gathered first so the sink learns the
+// total shape; then rank 0 asks each rank in turn for its rows, which
+// arrive in chunks of at most chunkRows with the next chunk's receive
+// already posted. Only one rank sends at a time, so neither rank 0 nor any
+// sender holds more than two chunks, however large the result. Rows are
+// produced chunk by chunk as well. Collective over communicator; sink is
+// only used on rank 0 and may be null elsewhere.
+void gatherResults(MPI_Comm communicator, Eigen::Index localRows, Eigen::Index cols,
+                   const ResultProducer& produce, ResultSink* sink, Eigen::Index chunkRows);
+
+} // namespace DistributedML
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace DistributedML {
+
+// On-disk layout of a training shard:
+//
+//   [ShardHeader][padding][sample 0][sample 1]...[sample N-1][ShardIndexEntry x N]
+//
+// Samples are float32 tensors of rows x cols x channels, each padded to a
+// fixed stride that is a multiple of 64 bytes so every sample starts on a
+// cache-line boundary once the file is mapped.
+struct ShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t sampleCount;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t channels;
+    uint32_t strideFloats;
+    uint64_t dataOffset;
+    uint64_t indexOffset;
+};
+
+// Per-sample index record
+struct ShardIndexEntry {
+    int32_t label;
+    uint32_t reserved;
+};
+
+constexpr char kShardMagic[8] = {'D', 'M', 'L', 'S', 'H', 'A', 'R', 'D'};
+constexpr uint32_t kShardVersion = 1;
+constexpr size_t kShardAlignment = 64;
+
+// Streams samples into a shard file without holding them in memory
+class ShardWriter {
+public:
+    ShardWriter(const std::string& path, int rows, int cols, int channels);
+    ~ShardWriter();
+
+    // Prevent copying
+    ShardWriter(const ShardWriter&) = delete;
+    ShardWriter& operator=(const ShardWriter&) = delete;
+
+    // Append one sample; it is converted to float32 if necessary
+    void append(const cv::Mat& sample, int label);
+
+    // Write the index and final header; called by the destructor if needed
+    void finish();
+
+    uint64_t sampleCount() const { return m_header.sampleCount; }
+
+private:
+    std::ofstream m_stream;
+    ShardHeader m_header;
+    std::vector<ShardIndexEntry> m_index;
+    std::vector<float> m_scratch;
+    bool m_finished;
+};
+
+// Read-only memory mapping of a shard file. Samples are exposed as pointers
+// into the mapping, so nothing is decoded or copied up front.
+class ShardReader {
+public:
+    explicit ShardReader(const std::string& path);
+    ~ShardReader();
+
+    // Prevent copying (owns the mapping)
+    ShardReader(const ShardReader&) = delete;
+    ShardReader& operator=(const ShardReader&) = delete;
+
+    size_t sampleCount() const { return m_header->sampleCount; }
+    int rows() const { return static_cast<int>(m_header->rows); }
+    int cols() const { return static_cast<int>(m_header->cols); }
+    int channels() const { return static_cast<int>(m_header->channels); }
+    size_t strideFloats() const { return m_header->strideFloats; }
+
+    // Pointer to the first float of a sample
+    const float* sample(size_t index) const;
+
+    // Class label of a sample
+    int label(size_t index) const;
+
+    // Contiguous [begin, end) sample range owned by a rank
+    std::pair<size_t, size_t> partition(int rank, int worldSize) const;
+
+    // Hint the kernel to read ahead a sample range
+    void prefetch(size_t begin, size_t end) const;
+
+private:
+    std::string m_path;
+    void* m_mapping;
+    size_t m_mappingBytes;
+    const ShardHeader* m_header;
+    const float* m_data;
+    const ShardIndexEntry* m_index;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+
+namespace DistributedML {
+
+// Monotonic allocator for buffers that live for one training step.
+// Allocation bumps a pointer; nothing is freed until reset() rewinds the
+// whole arena at the next step boundary. A step that outgrows the current
+// block chains on extra blocks, and the following reset() replaces them
+// with one block of the high-water size, so once steps have settled the
+// arena never touches the heap and hands out the same addresses every
+// step (which keeps MPI's registration caches warm).
+class StepArena {
+public:
+    using VectorMap = Eigen::Map<Eigen::VectorXd, Eigen::Aligned64>;
+
+    // Every allocation is aligned to a cache line
+    static constexpr std::size_t kAlignment = 64;
+
+    explicit StepArena(std::size_t initialBytes = 0);
+
+    // Prevent copying (hands out pointers into its blocks)
+    StepArena(const StepArena&) = delete;
+    StepArena& operator=(const StepArena&) = delete;
+
+    // Uninitialized storage valid until the next reset()
+    void* allocate(std::size_t bytes);
+
+    template <typename T>
+    T* allocateArray(std::size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    // Uninitialized vector of size doubles valid until the next reset()
+    VectorMap vector(Eigen::Index size) {
+        return VectorMap(allocateArray<double>(static_cast<std::size_t>(size)), size);
+    }
+
+    // Step boundary: forget every allocation
+    void reset();
+
+    // Bytes handed out since the last reset, and the most any step used
+    std::size_t used() const { return m_used; }
+    std::size_t highWater() const { return m_highWater; }
+    std::size_t capacity() const;
+
+    // Blocks taken from the heap so far
+    uint64_t blockAllocations() const { return m_blockAllocations; }
+
+private:
+    struct AlignedDeleter {
+        void operator()(unsigned char* pointer) const { std::free(pointer); }
+    };
+    struct Block {
+        std::unique_ptr<unsigned char[], AlignedDeleter> data;
+        std::size_t size = 0;
+    };
+
+    void addBlock(std::size_t minimumBytes);
+
+    std::vector<Block> m_blocks;
+    // Block being bumped and the offset of its free space
+    std::size_t m_current = 0;
+    std::size_t m_offset = 0;
+    std::size_t m_used = 0;
+    std::size_t m_highWater = 0;
+    uint64_t m_blockAllocations = 0;
+};
+
+} // namespace DistributedML
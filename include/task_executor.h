@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "task_manager.h"
+
+namespace DistributedML {
+
+// Handle passed to a running task. Progress counters are relaxed atomics so
+// a task can report from its inner loop for the cost of an increment; the
+// executor reads them from another thread and publishes them.
+class TaskContext {
+public:
+    explicit TaskContext(std::string taskId) : m_taskId(std::move(taskId)) {}
+
+    const std::string& taskId() const { return m_taskId; }
+
+    // Set once the task is cancelled; long-running tasks should poll it and
+    // return early
+    bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    // Mark the task cancelled from inside, e.g. when a peer was cancelled
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+
+    // Work expected and done so far, in steps (training batches)
+    void setTotalSteps(uint64_t steps) { m_totalSteps.store(steps, std::memory_order_relaxed); }
+    void advanceSteps(uint64_t steps = 1) { m_steps.fetch_add(steps, std::memory_order_relaxed); }
+    void setEpochsDone(uint64_t epochs) { m_epochs.store(epochs, std::memory_order_relaxed); }
+
+    uint64_t stepsDone() const { return m_steps.load(std::memory_order_relaxed); }
+    uint64_t totalSteps() const { return m_totalSteps.load(std::memory_order_relaxed); }
+    uint64_t epochsDone() const { return m_epochs.load(std::memory_order_relaxed); }
+
+    // Percentage of steps done; 0 until a total is set
+    double progress() const;
+
+private:
+    std::string m_taskId;
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<uint64_t> m_steps{0};
+    std::atomic<uint64_t> m_totalSteps{0};
+    std::atomic<uint64_t> m_epochs{0};
+};
+
+using TaskFunction = std::function<void(TaskContext&)>;
+
+// Scheduling parameters of a submitted task
+struct TaskOptions {
+    // Higher priorities run first
+    int priority = 0;
+    // Among equal priorities the earliest deadline runs first. A task still
+    // queued when its deadline passes fails without running.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Runs tasks on a fixed set of worker threads, so at most `workers` tasks
+// execute at once. Queued tasks are ordered by priority, then deadline, then
+// submission order. The queue is bounded: submit() refuses work once it is
+// full instead of letting the backlog grow without limit. Every task is
+// registered in the TaskManager, which is kept up to date with its status
+// and, while it runs, its progress.
+class TaskExecutor {
+public:
+    TaskExecutor(TaskManager& tasks, size_t workers, size_t maxQueued = 1024,
+                 std::chrono::milliseconds publishInterval = std::chrono::milliseconds(250));
+
+    // Cancels queued and running tasks and joins the workers
+    ~TaskExecutor();
+
+    // Prevent copying (workers hold a pointer to the executor)
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    // Create a task and queue fn to run it. Returns the task id, or an
+    // empty string when the queue is full.
+    std::string submit(const std::string& type, const nlohmann::json& metadata, TaskFunction fn,
+                       const TaskOptions& options = {});
+
+    // Queue a task of a type with a registered handler; throws
+    // std::invalid_argument for unknown types
+    std::string submit(const std::string& type, const nlohmann::json& metadata, const TaskOptions& options = {});
+
+    // Function that runs tasks of a type submitted without one, such as
+    // those created through the dashboard
+    void registerHandler(const std::string& type, TaskFunction handler);
+    bool hasHandler(const std::string& type) const;
+
+    // Cancel a queued task, or ask a running one to stop. Returns false when
+    // the task is unknown or has already finished.
+    bool cancel(const std::string& taskId);
+
+    // Block until a task has finished and return its final status
+    TaskStatus wait(const std::string& taskId);
+
+    size_t workerCount() const { return m_workers.size(); }
+    size_t queuedTasks() const;
+    size_t runningTasks() const;
+
+private:
+    struct Job {
+        explicit Job(const std::string& id) : context(id) {}
+
+        TaskFunction function;
+        TaskOptions options;
+        uint64_t sequence = 0;
+        bool running = false;
+        TaskContext context;
+        // Serializes the publisher's progress updates with the final one;
+        // once finished is set only the final status remains
+        std::mutex publishMutex;
+        bool finished = false;
+    };
+    using JobPtr = std::shared_ptr<Job>;
+
+    // Heap order: true when a should run after b
+    struct JobOrder {
+        bool operator()(const JobPtr& a, const JobPtr& b) const;
+    };
+
+    void workerLoop();
+    void publisherLoop();
+
+    // Copy a job's counters into the TaskManager; the caller holds the
+    // job's publishMutex
+    void publishProgress(const Job& job, const nlohmann::json& extra = nlohmann::json::object());
+
+    // Record the final status and wake waiters
+    void finish(const JobPtr& job, TaskStatus status, const std::string& error = "");
+
+    TaskManager& m_tasks;
+    const size_t m_maxQueued;
+    const std::chrono::milliseconds m_publishInterval;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_jobFinished;
+    std::condition_variable m_publisherWake;
+    std::priority_queue<JobPtr, std::vector<JobPtr>, JobOrder> m_queue;
+    // Queued and running jobs by task id
+    std::unordered_map<std::string, JobPtr> m_jobs;
+    std::unordered_map<std::string, TaskFunction> m_handlers;
+    size_t m_queued = 0;
+    size_t m_running = 0;
+    uint64_t m_sequence = 0;
+    bool m_stopping = false;
+
+    std::vector<std::thread> m_workers;
+    std::thread m_publisher;
+};
+
+} // namespace DistributedML
@@ -3,6 +3,14 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <array>
+#include <set>
+#include <functional>
+#include <unordered_map>
 #include <algorithm>
 #include <nlohmann/json.hpp>
 
@@ -17,9 +25,16 @@ enum class TaskStatus {
     PENDING,
     RUNNING,
     COMPLETED,
-    FAILED
+    FAILED,
+    CANCELLED
 };
 
+// Task store split into independently locked shards. Tasks are immutable
+// snapshots behind shared pointers: readers copy a pointer under a shared
+// lock and never copy task data while holding it, and writers publish a new
+// snapshot instead of modifying one in place. Ids are "task_<sequence>", so
+// a task's shard and slot follow from its id without a search. Every shard
+// indexes its tasks by status and by type for filtered, cursor-paged listing.
 class TaskManager {
 public:
     struct Task {
@@ -30,6 +45,26 @@ public:
         double progress;
     };
 
+    // Published task snapshot; stays valid after later updates
+    using TaskPtr = std::shared_ptr<const Task>;
+
+    // Filter and position for listTasks
+    struct TaskQuery {
+        std::optional<TaskStatus> status;
+        std::optional<string> type;
+        // Only tasks added after the cursor (0 = from the first task)
+        uint64_t cursor = 0;
+        size_t limit = 100;
+    };
+
+    // One page of tasks, oldest first
+    struct TaskPage {
+        vector<TaskPtr> tasks;
+        // Cursor for the following page
+        uint64_t nextCursor = 0;
+        bool hasMore = false;
+    };
+
     // Constructor and destructor
     TaskManager() : m_taskCounter(0) {}
     ~TaskManager() = default;
@@ -40,14 +75,69 @@ public:
 
     // Task management methods
     string addTask(const string& taskType, const nlohmann::json& metadata);
+
+    // Set the status; COMPLETED also sets progress to 100, other statuses
+    // keep the last reported progress
     void updateTaskStatus(const string& taskId, TaskStatus status);
-    vector<Task> getAllTasks() const;
+
+    // Set progress (0-100) and store execution details under
+    // metadata["execution"]
+    void updateTaskProgress(const string& taskId, double progress, const nlohmann::json& execution);
+
+    // Every task, oldest first; shares the snapshots rather than copying them
+    vector<TaskPtr> getAllTasks() const;
+
+    // Copy of a task, or an empty Task when the id is unknown
     Task getTaskById(const string& taskId) const;
 
+    // Snapshot of a task, or null when the id is unknown
+    TaskPtr findTask(const string& taskId) const;
+
+    // Up to query.limit matching tasks added after query.cursor
+    TaskPage listTasks(const TaskQuery& query) const;
+
+    // Number of tasks currently in a status
+    size_t countTasks(TaskStatus status) const;
+
+    // Increases with every added or updated task, so readers can cache
+    // views of the store and rebuild them only after a change
+    uint64_t version() const { return m_version.load(std::memory_order_acquire); }
+
 private:
-    mutable mutex m_taskMutex;
-    vector<Task> m_tasks;
-    size_t m_taskCounter;
+    static constexpr size_t kShardCount = 16;
+    static constexpr size_t kStatusCount = 5;
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        // Slot i holds the task with sequence i * kShardCount + shard + 1;
+        // null while a concurrent addTask is still filling it
+        vector<TaskPtr> tasks;
+        // Leading slots that are all filled
+        size_t filledSlots = 0;
+        // Sequences of this shard's tasks by status and by type
+        std::array<std::set<uint64_t>, kStatusCount> byStatus;
+        std::unordered_map<string, std::set<uint64_t>> byType;
+    };
+
+    // Sequence number encoded in a task id; 0 when malformed
+    static uint64_t sequenceOf(const string& taskId);
+
+    // Publish a modified copy of a task, retrying if another update got
+    // there first
+    void replaceTask(const string& taskId, const std::function<void(Task&)>& update);
+
+    Shard& shardOf(uint64_t sequence) { return m_shards[(sequence - 1) % kShardCount]; }
+    const Shard& shardOf(uint64_t sequence) const { return m_shards[(sequence - 1) % kShardCount]; }
+    static size_t slotOf(uint64_t sequence) { return static_cast<size_t>((sequence - 1) / kShardCount); }
+
+    // Matching tasks of one shard after the cursor and up to the committed
+    // sequence, at most limit of them, oldest first
+    void collectShard(size_t shardIndex, const TaskQuery& query, uint64_t committed, size_t limit,
+                      vector<std::pair<uint64_t, TaskPtr>>& output) const;
+
+    std::array<Shard, kShardCount> m_shards;
+    std::atomic<uint64_t> m_taskCounter;
+    std::atomic<uint64_t> m_version{0};
 }; // class TaskManager
 
 } // namespace DistributedML
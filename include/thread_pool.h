@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace DistributedML {
+
+// Fixed-size pool of worker threads with per-worker task queues. Tasks are
+// dealt out evenly; a worker that drains its own queue steals from the
+// front of its peers' queues, so uneven task costs even out.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    // Prevent copying
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return m_workers.size(); }
+
+    // Run fn(index, workerId) for every index in [0, count) and block until
+    // all calls have returned. No allocation happens per task. If calls
+    // throw, the rest still run and the first exception is rethrown here.
+    template <typename Fn>
+    void parallelFor(size_t count, Fn&& fn);
+
+    // Fraction of wall time each worker spent running tasks since the last reset
+    std::vector<double> utilization() const;
+    void resetUtilization();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        void (*invoke)(const void* context, size_t index, size_t workerId);
+        const void* context;
+        std::atomic<size_t> remaining;
+        // First exception thrown by a call; set once, by whoever claims failed
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        Job* job;
+        size_t index;
+    };
+
+    // Double-ended queue: the owner pops from the back, thieves take the front
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head = 0;
+        std::atomic<uint64_t> busyNanos{0};
+        std::thread thread;
+    };
+
+    void dispatch(Job& job, size_t count);
+    bool popLocal(size_t workerId, Task& task);
+    bool steal(size_t thiefId, Task& task);
+    void execute(const Task& task, size_t workerId);
+    void run(size_t workerId);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<size_t> m_pending;
+    std::atomic<bool> m_stop;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::mutex m_doneMutex;
+    std::condition_variable m_done;
+    Clock::time_point m_utilizationStart;
+};
+
+template <typename Fn>
+void ThreadPool::parallelFor(size_t count, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    using Callable = typename std::remove_reference<Fn>::type;
+    Job job;
+    job.invoke = [](const void* context, size_t index, size_t workerId) {
+        (*static_cast<Callable*>(const_cast<void*>(context)))(index, workerId);
+    };
+    job.context = &fn;
+    job.remaining.store(count, std::memory_order_relaxed);
+
+    dispatch(job, count);
+
+    std::unique_lock<std::mutex> lock(m_doneMutex);
+    m_done.wait(lock, [&job]() {
+        return job.remaining.load(std::memory_order_acquire) == 0;
+    });
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
+} // namespace DistributedML
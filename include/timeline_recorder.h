@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstdint>
+#include <string>
+#include "performance_tracker.h"
+
+namespace DistributedML {
+
+// Merges the span timelines of every rank into one Chrome trace file
+// (chrome://tracing, ui.perfetto.dev). Each rank becomes a process and each
+// recording thread a track. Timestamps are shifted onto rank 0's clock
+// using offsets estimated by MPI ping-pong.
+class TimelineRecorder {
+public:
+    explicit TimelineRecorder(MPI_Comm communicator);
+
+    // Estimate every rank's clock offset to rank 0. Each rank exchanges
+    // rounds ping-pongs with rank 0 and keeps the one with the smallest
+    // round trip, assuming the reply was timestamped halfway. Collective.
+    void synchronizeClocks(int rounds = 16);
+
+    // Nanoseconds to add to local timestamps to land on rank 0's clock
+    int64_t clockOffsetNanos() const { return m_clockOffset; }
+
+    // Round trip of the exchange the offset came from
+    uint64_t clockRoundTripNanos() const { return m_roundTrip; }
+
+    // Gather the tracker's timeline from every rank and write the merged
+    // trace on rank 0. Collective; returns the number of events written
+    // (zero on other ranks).
+    size_t write(const std::string& path, const PerformanceTracker& tracker) const;
+
+private:
+    MPI_Comm m_communicator;
+    int m_rank;
+    int m_worldSize;
+    int64_t m_clockOffset;
+    uint64_t m_roundTrip;
+};
+
+} // namespace DistributedML
@@ -0,0 +1,23 @@
+#include "../include/allocation_counter.h"
+
+namespace DistributedML {
+
+namespace detail {
+
+// Set and bumped by the interposer in allocation_interposer.cpp
+bool g_countingHeapAllocations = false;
+
+// Static TLS, so counting never calls into the TLS allocator
+__attribute__((tls_model("initial-exec"))) thread_local uint64_t t_heapAllocations = 0;
+
+} // namespace detail
+
+bool allocationCountingEnabled() {
+    return detail::g_countingHeapAllocations;
+}
+
+uint64_t threadHeapAllocations() {
+    return detail::t_heapAllocations;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,102 @@
+#include "../include/allocation_counter.h"
+#include <cerrno>
+#include <cstdlib>
+#include <malloc.h>
+
+// Counts every heap allocation per thread by replacing glibc's allocation
+// entry points. Linked only into binaries built with DML_COUNT_ALLOCATIONS,
+// never into dml_core itself.
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define DML_SANITIZED 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define DML_SANITIZED 1
+#endif
+
+#if defined(__GLIBC__) && !defined(DML_SANITIZED)
+
+namespace DistributedML {
+namespace detail {
+
+// Defined in allocation_counter.cpp
+extern bool g_countingHeapAllocations;
+extern __attribute__((tls_model("initial-exec"))) thread_local uint64_t t_heapAllocations;
+
+} // namespace detail
+} // namespace DistributedML
+
+using DistributedML::detail::t_heapAllocations;
+
+namespace {
+
+struct EnableCounting {
+    EnableCounting() { DistributedML::detail::g_countingHeapAllocations = true; }
+} enableCounting;
+
+} // namespace
+
+// Every allocation entry point forwards to glibc's allocator after counting;
+// free and malloc_usable_size need no wrapper since the chunks are glibc's
+extern "C" {
+
+void* __libc_malloc(size_t size) noexcept;
+void* __libc_calloc(size_t count, size_t size) noexcept;
+void* __libc_realloc(void* pointer, size_t size) noexcept;
+void* __libc_memalign(size_t alignment, size_t size) noexcept;
+void* __libc_valloc(size_t size) noexcept;
+void* __libc_pvalloc(size_t size) noexcept;
+
+void* malloc(size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_memalign(alignment, size);
+}
+
+void* valloc(size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) noexcept {
+    ++t_heapAllocations;
+    return __libc_pvalloc(size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    ++t_heapAllocations;
+    void* result = __libc_memalign(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *pointer = result;
+    return 0;
+}
+
+} // extern "C"
+
+#endif
@@ -0,0 +1,49 @@
+#include "../include/batch_tensor.h"
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+namespace DistributedML {
+
+BatchTensor::BatchTensor(Eigen::Index samples, Eigen::Index features) {
+    resize(samples, features);
+}
+
+Eigen::Index BatchTensor::alignedStride(Eigen::Index features) {
+    const Eigen::Index floatsPerLine = kBatchAlignment / sizeof(float);
+    return (features + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+}
+
+void BatchTensor::resize(Eigen::Index samples, Eigen::Index features) {
+    if (samples < 0 || features < 0) {
+        throw std::invalid_argument("Batch tensor dimensions must be non-negative");
+    }
+
+    m_samples = samples;
+    m_features = features;
+    m_stride = alignedStride(features);
+
+    std::size_t bytes = static_cast<std::size_t>(m_samples * m_stride) * sizeof(float);
+    if (bytes == 0) {
+        m_storage.reset();
+        return;
+    }
+
+    // aligned_alloc requires the size to be a multiple of the alignment,
+    // which the padded stride already guarantees
+    float* storage = static_cast<float*>(std::aligned_alloc(kBatchAlignment, bytes));
+    if (!storage) {
+        throw std::bad_alloc();
+    }
+    std::fill(storage, storage + m_samples * m_stride, 0.0f);
+    m_storage.reset(storage);
+}
+
+void BatchTensor::clear() {
+    m_storage.reset();
+    m_samples = 0;
+    m_features = 0;
+    m_stride = 0;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,317 @@
+#include "../include/checkpoint_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+constexpr char kCheckpointMagic[8] = {'D', 'M', 'L', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t kCheckpointVersion = 1;
+
+} // namespace
+
+CheckpointManager::CheckpointManager(MPI_Comm communicator, const std::string& path, bool background)
+    : m_communicator(MPI_COMM_NULL),
+      m_path(path),
+      m_background(background),
+      m_rank(0),
+      m_worldSize(1),
+      m_header{},
+      m_lastWriteSeconds(0.0) {
+
+    // Private communicator so background collectives never interleave with training
+    MPI_Comm_dup(communicator, &m_communicator);
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_worldSize);
+
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Query_thread(&threadSupport);
+    if (m_background && threadSupport < MPI_THREAD_MULTIPLE) {
+        if (m_rank == 0) {
+            BOOST_LOG_TRIVIAL(warning) << "MPI lacks MPI_THREAD_MULTIPLE; checkpoints will be written synchronously";
+        }
+        m_background = false;
+    }
+}
+
+CheckpointManager::~CheckpointManager() {
+    wait();
+
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (!finalized && m_communicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&m_communicator);
+    }
+}
+
+std::pair<uint64_t, uint64_t> CheckpointManager::sliceOf(uint64_t size, int rank, int worldSize) {
+    return {size * rank / worldSize, size * (rank + 1) / worldSize};
+}
+
+void CheckpointManager::save(int64_t epoch, const Eigen::VectorXd& parameters,
+                             const std::vector<const Eigen::VectorXd*>& optimizerState, uint64_t optimizerSteps) {
+    // The snapshot buffer is reused, so the previous write must be done
+    wait();
+
+    const uint64_t parameterCount = static_cast<uint64_t>(parameters.size());
+    for (const Eigen::VectorXd* state : optimizerState) {
+        if (static_cast<uint64_t>(state->size()) != parameterCount) {
+            throw std::invalid_argument("Optimizer state does not match parameter count");
+        }
+    }
+
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    m_header.version = kCheckpointVersion;
+    m_header.stateVectors = static_cast<uint32_t>(optimizerState.size());
+    m_header.parameterCount = parameterCount;
+    m_header.epoch = epoch;
+    m_header.dataOffset = sizeof(CheckpointHeader);
+    m_header.optimizerSteps = optimizerSteps;
+
+    // Copying only this rank's slices keeps the pause short
+    auto [begin, end] = sliceOf(parameterCount, m_rank, m_worldSize);
+    const uint64_t sliceSize = end - begin;
+    m_snapshot.resize(sliceSize * (1 + optimizerState.size()));
+    std::copy(parameters.data() + begin, parameters.data() + end, m_snapshot.begin());
+    for (size_t i = 0; i < optimizerState.size(); ++i) {
+        std::copy(optimizerState[i]->data() + begin, optimizerState[i]->data() + end,
+                  m_snapshot.begin() + (i + 1) * sliceSize);
+    }
+
+    if (m_background) {
+        m_writer = std::thread([this]() { write(); });
+    } else {
+        write();
+    }
+}
+
+void CheckpointManager::wait() {
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+}
+
+void CheckpointManager::write() {
+    auto start = std::chrono::steady_clock::now();
+    const std::string temporaryPath = m_path + ".tmp";
+
+    MPI_File file;
+    int result = MPI_File_open(
+        m_communicator,
+        temporaryPath.c_str(),
+        MPI_MODE_CREATE | MPI_MODE_WRONLY,
+        MPI_INFO_NULL,
+        &file
+    );
+    if (result != MPI_SUCCESS) {
+        // A missed checkpoint should not take training down with it
+        BOOST_LOG_TRIVIAL(error) << "Failed to open checkpoint file " << temporaryPath;
+        return;
+    }
+
+    // Every rank issues every collective whatever fails, so the ranks stay
+    // in step; the outcome is agreed on once the file is closed
+    int written = 1;
+    const uint64_t parameterCount = m_header.parameterCount;
+    const uint64_t vectors = 1 + m_header.stateVectors;
+    if (MPI_File_set_size(file, static_cast<MPI_Offset>(
+            m_header.dataOffset + vectors * parameterCount * sizeof(double))) != MPI_SUCCESS) {
+        written = 0;
+    }
+
+    if (m_rank == 0 &&
+        MPI_File_write_at(file, 0, &m_header, sizeof(m_header), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+        written = 0;
+    }
+
+    // One collective write per vector; each rank contributes its slice
+    auto [begin, end] = sliceOf(parameterCount, m_rank, m_worldSize);
+    const uint64_t sliceSize = end - begin;
+    for (uint64_t vector = 0; vector < vectors; ++vector) {
+        MPI_Offset offset = static_cast<MPI_Offset>(
+            m_header.dataOffset + (vector * parameterCount + begin) * sizeof(double));
+        result = MPI_File_write_at_all(
+            file,
+            offset,
+            m_snapshot.data() + vector * sliceSize,
+            static_cast<int>(sliceSize),
+            MPI_DOUBLE,
+            MPI_STATUS_IGNORE
+        );
+        if (result != MPI_SUCCESS) {
+            written = 0;
+        }
+    }
+
+    if (MPI_File_sync(file) != MPI_SUCCESS) {
+        written = 0;
+    }
+    MPI_File_close(&file);
+
+    int allWritten = 0;
+    MPI_Allreduce(&written, &allWritten, 1, MPI_INT, MPI_MIN, m_communicator);
+    if (!allWritten) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to write checkpoint " << temporaryPath
+                                 << (written ? " on another rank" : "");
+        return;
+    }
+
+    // Publish atomically once every rank's slice is on disk
+    if (m_rank == 0 && std::rename(temporaryPath.c_str(), m_path.c_str()) != 0) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to move checkpoint into place at " << m_path;
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_lastWriteSeconds = seconds;
+    }
+
+    if (m_rank == 0) {
+        BOOST_LOG_TRIVIAL(info) << "Checkpoint for epoch " << m_header.epoch << " written to " << m_path
+                                << " in " << seconds << "s";
+    }
+}
+
+bool CheckpointManager::exists() const {
+    int present = 0;
+    if (m_rank == 0) {
+        present = std::ifstream(m_path, std::ios::binary).good() ? 1 : 0;
+    }
+    MPI_Bcast(&present, 1, MPI_INT, 0, m_communicator);
+    return present != 0;
+}
+
+CheckpointState CheckpointManager::restore(uint64_t expectedParameters) const {
+    MPI_File file;
+    int result = MPI_File_open(m_communicator, m_path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to open checkpoint " << m_path;
+        throw std::runtime_error("Checkpoint open failed");
+    }
+
+    // Root validates the header; every rank needs it to locate its slice.
+    // A short read leaves it zeroed, which fails the magic check below.
+    CheckpointHeader header{};
+    if (m_rank == 0) {
+        MPI_Status status;
+        int received = 0;
+        if (MPI_File_read_at(file, 0, &header, sizeof(header), MPI_BYTE, &status) != MPI_SUCCESS ||
+            MPI_Get_count(&status, MPI_BYTE, &received) != MPI_SUCCESS ||
+            received != static_cast<int>(sizeof(header))) {
+            std::memset(&header, 0, sizeof(header));
+        }
+    }
+    MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, m_communicator);
+
+    if (std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0 ||
+        header.version != kCheckpointVersion) {
+        MPI_File_close(&file);
+        BOOST_LOG_TRIVIAL(error) << "Not a checkpoint file: " << m_path;
+        throw std::runtime_error("Invalid checkpoint file");
+    }
+    if (header.parameterCount != expectedParameters ||
+        header.parameterCount > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        MPI_File_close(&file);
+        BOOST_LOG_TRIVIAL(error) << "Checkpoint holds " << header.parameterCount
+                                 << " parameters, model has " << expectedParameters;
+        throw std::runtime_error("Checkpoint does not match model");
+    }
+
+    // The header is untrusted: the vectors it announces must fit in the
+    // file. Bounded by division so a huge stateVectors cannot wrap.
+    MPI_Offset fileBytes = 0;
+    MPI_File_get_size(file, &fileBytes);
+    const uint64_t available = static_cast<uint64_t>(std::max<MPI_Offset>(fileBytes, 0));
+    const uint64_t vectorBytes = header.parameterCount * sizeof(double);
+    if (header.dataOffset < sizeof(CheckpointHeader) || header.dataOffset > available ||
+        (vectorBytes > 0 && (available - header.dataOffset) / vectorBytes < uint64_t(header.stateVectors) + 1)) {
+        MPI_File_close(&file);
+        BOOST_LOG_TRIVIAL(error) << "Checkpoint " << m_path << " is truncated: " << available
+                                 << " bytes for " << uint64_t(header.stateVectors) + 1 << " vector(s) of "
+                                 << header.parameterCount << " parameters";
+        throw std::runtime_error("Truncated checkpoint file");
+    }
+
+    // Slices follow the current world size, whatever size wrote the file
+    std::vector<int> counts(m_worldSize);
+    std::vector<int> displacements(m_worldSize);
+    for (int rank = 0; rank < m_worldSize; ++rank) {
+        auto [begin, end] = sliceOf(header.parameterCount, rank, m_worldSize);
+        counts[rank] = static_cast<int>(end - begin);
+        displacements[rank] = static_cast<int>(begin);
+    }
+
+    CheckpointState state;
+    state.epoch = header.epoch;
+    state.optimizerSteps = header.optimizerSteps;
+    std::vector<double> slice(counts[m_rank]);
+
+    // Every rank issues every collective whatever fails, so the ranks stay
+    // in step; the outcome is agreed on once the file is closed
+    int read = 1;
+    for (uint32_t vector = 0; vector <= header.stateVectors; ++vector) {
+        MPI_Offset offset = static_cast<MPI_Offset>(
+            header.dataOffset + (vector * header.parameterCount + displacements[m_rank]) * sizeof(double));
+        MPI_Status status;
+        int received = 0;
+        if (MPI_File_read_at_all(file, offset, slice.data(), counts[m_rank], MPI_DOUBLE, &status) != MPI_SUCCESS ||
+            MPI_Get_count(&status, MPI_DOUBLE, &received) != MPI_SUCCESS ||
+            received != counts[m_rank]) {
+            read = 0;
+        }
+
+        Eigen::VectorXd full;
+        if (m_rank == 0) {
+            full.resize(static_cast<Eigen::Index>(header.parameterCount));
+        }
+        MPI_Gatherv(
+            slice.data(),
+            counts[m_rank],
+            MPI_DOUBLE,
+            full.data(),
+            counts.data(),
+            displacements.data(),
+            MPI_DOUBLE,
+            0,
+            m_communicator
+        );
+
+        if (vector == 0) {
+            state.parameters = std::move(full);
+        } else {
+            state.optimizerState.push_back(std::move(full));
+        }
+    }
+
+    MPI_File_close(&file);
+
+    int allRead = 0;
+    MPI_Allreduce(&read, &allRead, 1, MPI_INT, MPI_MIN, m_communicator);
+    if (!allRead) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to read checkpoint " << m_path
+                                 << (read ? " on another rank" : "");
+        throw std::runtime_error("Checkpoint read failed");
+    }
+
+    if (m_rank == 0) {
+        BOOST_LOG_TRIVIAL(info) << "Restored checkpoint " << m_path << " at epoch " << state.epoch;
+    }
+    return state;
+}
+
+double CheckpointManager::lastWriteSeconds() const {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_lastWriteSeconds;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,98 @@
+#include "../include/communicator_topology.h"
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+CommunicatorTopology::CommunicatorTopology(MPI_Comm communicator)
+    : m_communicator(communicator),
+      m_nodeCommunicator(MPI_COMM_NULL),
+      m_leaderCommunicator(MPI_COMM_NULL),
+      m_rank(0),
+      m_size(1),
+      m_localRank(0),
+      m_localSize(1),
+      m_nodeIndex(0),
+      m_nodeCount(1) {
+
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_size);
+
+    // Ordering by rank keeps rank 0 as local rank 0 and leader rank 0
+    int ranksPerNode = 0;
+    if (const char* simulated = std::getenv("DML_RANKS_PER_NODE")) {
+        ranksPerNode = std::atoi(simulated);
+    }
+
+    int result = MPI_Comm_split_type(
+        m_communicator, MPI_COMM_TYPE_SHARED, m_rank, MPI_INFO_NULL, &m_nodeCommunicator);
+    if (result == MPI_SUCCESS && ranksPerNode > 0) {
+        // Simulated nodes subdivide the physical one, so every node still
+        // shares memory for the gradient buckets' window
+        MPI_Comm hostCommunicator = m_nodeCommunicator;
+        int hostRank = 0;
+        MPI_Comm_rank(hostCommunicator, &hostRank);
+        result = MPI_Comm_split(hostCommunicator, hostRank / ranksPerNode, m_rank, &m_nodeCommunicator);
+        MPI_Comm_free(&hostCommunicator);
+    }
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to create node communicator";
+        throw std::runtime_error("MPI node communicator split failed");
+    }
+    MPI_Comm_rank(m_nodeCommunicator, &m_localRank);
+    MPI_Comm_size(m_nodeCommunicator, &m_localSize);
+
+    result = MPI_Comm_split(
+        m_communicator,
+        isLeader() ? 0 : MPI_UNDEFINED,
+        m_rank,
+        &m_leaderCommunicator
+    );
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to create leader communicator";
+        throw std::runtime_error("MPI leader communicator split failed");
+    }
+
+    // Leaders know the node layout; share it with the rest of the node
+    int layout[2] = {0, 1};
+    if (isLeader()) {
+        MPI_Comm_rank(m_leaderCommunicator, &layout[0]);
+        MPI_Comm_size(m_leaderCommunicator, &layout[1]);
+    }
+    MPI_Bcast(layout, 2, MPI_INT, 0, m_nodeCommunicator);
+    m_nodeIndex = layout[0];
+    m_nodeCount = layout[1];
+
+    if (m_rank == 0) {
+        BOOST_LOG_TRIVIAL(info) << "Communicator topology: " << m_nodeCount << " node(s), "
+                                << m_size << " rank(s)"
+                                << (ranksPerNode > 0 ? " (simulated nodes)" : "");
+    }
+}
+
+CommunicatorTopology::~CommunicatorTopology() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized) {
+        return;
+    }
+    if (m_leaderCommunicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&m_leaderCommunicator);
+    }
+    if (m_nodeCommunicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&m_nodeCommunicator);
+    }
+}
+
+void CommunicatorTopology::broadcast(void* buffer, int count, MPI_Datatype type) const {
+    if (isLeader() && m_nodeCount > 1) {
+        MPI_Bcast(buffer, count, type, 0, m_leaderCommunicator);
+    }
+    if (m_localSize > 1) {
+        MPI_Bcast(buffer, count, type, 0, m_nodeCommunicator);
+    }
+}
+
+} // namespace DistributedML
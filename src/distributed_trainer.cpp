@@ -1,8 +1,11 @@
 #include "../include/distributed_trainer.h"
+#include "../include/allocation_counter.h"
 #include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <Eigen/Dense>
@@ -13,6 +16,94 @@
 
 namespace DistributedML {
 
+namespace {
+
+// Spans kept per rank for the timeline trace
+constexpr size_t kMaxTimelineEvents = 1 << 20;
+
+// Figures each rank contributes to the loss reduction: loss, samples,
+// cancellation and pending joins, then compute time, wait time and
+// samples computed per rank
+constexpr size_t kLossTotals = 4;
+constexpr size_t kRankLoadFields = 3;
+
+// Rebalancing never gives a rank more than this multiple of an even share,
+// and smooths measured throughput over epochs with this weight
+constexpr long long kMaxShareFactor = 4;
+constexpr double kRateSmoothing = 0.5;
+
+constexpr int kMigrateSamplesTag = 7501;
+constexpr int kMigrateLabelsTag = 7502;
+
+// One padded BatchTensor row, so sample counts can be used as MPI counts
+MPI_Datatype sampleRowType(Eigen::Index features) {
+    MPI_Datatype featuresType;
+    MPI_Datatype sampleType;
+    MPI_Type_contiguous(static_cast<int>(features), MPI_FLOAT, &featuresType);
+    MPI_Type_create_resized(featuresType, 0, BatchTensor::alignedStride(features) * sizeof(float), &sampleType);
+    MPI_Type_commit(&sampleType);
+    MPI_Type_free(&featuresType);
+    return sampleType;
+}
+
+// Split total into integer shares proportional to weights, each within
+// [minShare, maxShare]. Shares pushed out of bounds are pinned and the rest
+// is divided again; leftover units go to the largest fractional parts.
+std::vector<long long> proportionalShares(const std::vector<double>& weights, long long total,
+                                          long long minShare, long long maxShare) {
+    const size_t count = weights.size();
+    std::vector<double> exact(count, 0.0);
+    std::vector<bool> pinned(count, false);
+    double remaining = static_cast<double>(total);
+    for (size_t pass = 0; pass < count; ++pass) {
+        double weightSum = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!pinned[i]) {
+                weightSum += weights[i];
+            }
+        }
+        for (size_t i = 0; i < count && weightSum > 0.0; ++i) {
+            if (!pinned[i]) {
+                exact[i] = remaining * weights[i] / weightSum;
+            }
+        }
+        bool clamped = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (pinned[i] || (exact[i] >= minShare && exact[i] <= maxShare)) {
+                continue;
+            }
+            exact[i] = static_cast<double>(exact[i] < minShare ? minShare : maxShare);
+            pinned[i] = true;
+            remaining -= exact[i];
+            clamped = true;
+        }
+        if (!clamped) {
+            break;
+        }
+    }
+
+    std::vector<long long> shares(count);
+    std::vector<size_t> order(count);
+    long long assigned = 0;
+    for (size_t i = 0; i < count; ++i) {
+        shares[i] = static_cast<long long>(exact[i]);
+        assigned += shares[i];
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return exact[a] - shares[a] > exact[b] - shares[b];
+    });
+    for (size_t i = 0; assigned < total; i = (i + 1) % count) {
+        if (shares[order[i]] < maxShare) {
+            ++shares[order[i]];
+            ++assigned;
+        }
+    }
+    return shares;
+}
+
+} // namespace
+
 void DistributedTrainer::initializeLogging() {
     boost::log::core::get()->set_filter(
         boost::log::trivial::severity >= boost::log::trivial::info
@@ -23,32 +114,59 @@ DistributedTrainer::DistributedTrainer(int argc, char** argv) {
     // Initialize logging
     initializeLogging();
 
-    // Initialize MPI with error checking
-    int mpi_init_result = MPI_Init(&argc, &argv);
-    if (mpi_init_result != MPI_SUCCESS) {
-        BOOST_LOG_TRIVIAL(error) << "MPI initialization failed";
-        throw std::runtime_error("MPI initialization failed");
+    // Initialize MPI with error checking, unless the host program (a
+    // benchmark, say) already has. Training runs off the main thread and
+    // checkpoints are written from another, so ask for full threading.
+    int initialized = 0;
+    MPI_Initialized(&initialized);
+    m_ownsMpi = !initialized;
+    int threadSupport = MPI_THREAD_SINGLE;
+    if (m_ownsMpi) {
+        int mpi_init_result = MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &threadSupport);
+        if (mpi_init_result != MPI_SUCCESS) {
+            BOOST_LOG_TRIVIAL(error) << "MPI initialization failed";
+            throw std::runtime_error("MPI initialization failed");
+        }
+    } else {
+        MPI_Query_thread(&threadSupport);
     }
 
     // Log MPI initialization
-    BOOST_LOG_TRIVIAL(info) << "MPI initialized successfully";
+    BOOST_LOG_TRIVIAL(info) << "MPI initialized successfully"
+                            << (threadSupport < MPI_THREAD_MULTIPLE ? " (without MPI_THREAD_MULTIPLE)" : "");
 
     // Initialize distributed environment
     try {
         initialize();
     } catch (const std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << "Initialization failed: " << e.what();
-        MPI_Finalize();
+        if (m_ownsMpi) {
+            MPI_Finalize();
+        }
         throw;
     }
 }
 
 DistributedTrainer::~DistributedTrainer() {
     try {
+        // Stop the input threads before the data they read goes away
+        m_input.reset();
+
+        // Release members that own MPI requests, datatypes and ops first
+        if (m_averagingRequest != MPI_REQUEST_NULL) {
+            MPI_Wait(&m_averagingRequest, MPI_STATUS_IGNORE);
+        }
+        m_checkpoints.reset();
+        m_gradientBucketer.reset();
+        m_topology.reset();
+        m_elastic.reset();
+
         // Ensure clean MPI shutdown
-        int finalize_result = MPI_Finalize();
-        if (finalize_result != MPI_SUCCESS) {
-            BOOST_LOG_TRIVIAL(warning) << "MPI Finalize failed";
+        if (m_ownsMpi) {
+            int finalize_result = MPI_Finalize();
+            if (finalize_result != MPI_SUCCESS) {
+                BOOST_LOG_TRIVIAL(warning) << "MPI Finalize failed";
+            }
         }
     } catch (const std::exception& e) {
         BOOST_LOG_TRIVIAL(error) << "Error during MPI finalization: " << e.what();
@@ -72,6 +190,58 @@ void DistributedTrainer::initialize() {
 
     // Set communicator
     m_communicator = MPI_COMM_WORLD;
+    setupCommunicators();
+
+    // Intern span names up front so the training loop records by id
+    m_spans.epoch = m_tracker.intern("epoch");
+    m_spans.batch = m_tracker.intern("batch");
+    m_spans.forwardBackward = m_tracker.intern("forward_backward");
+    m_spans.microBatch = m_tracker.intern("micro_batch");
+    m_spans.bucketAppend = m_tracker.intern("bucket_append");
+    m_spans.lossAllreduce = m_tracker.intern("loss_allreduce");
+    m_spans.gradientAllreduce = m_tracker.intern("gradient_allreduce");
+    m_spans.optimizerStep = m_tracker.intern("optimizer_step");
+    m_spans.averagingWait = m_tracker.intern("averaging_wait");
+    m_spans.checkpoint = m_tracker.intern("checkpoint_snapshot");
+    m_spans.inputWait = m_tracker.intern("input_wait");
+
+    // Register the scraped metrics once; step times span 100us to ~6.5s
+    const auto stepBounds = Histogram::exponentialBounds(1e-4, 2.0, 17);
+    m_live.samples = &m_metrics.counter("dml_samples_total", "Training samples processed by this rank");
+    m_live.allreduceBytes = &m_metrics.counter("dml_allreduce_bytes_total",
+        "Payload bytes this rank contributed to allreduce operations");
+    m_live.stepSeconds = &m_metrics.histogram("dml_step_seconds",
+        "Time per training step (mini-batch) on this rank", stepBounds);
+    m_live.gradientAllreduceSeconds = &m_metrics.histogram("dml_allreduce_seconds",
+        "Time blocked in allreduce operations", stepBounds, "op=\"gradient\"");
+    m_live.lossAllreduceSeconds = &m_metrics.histogram("dml_allreduce_seconds",
+        "Time blocked in allreduce operations", stepBounds, "op=\"loss\"");
+    m_live.averagingWaitSeconds = &m_metrics.histogram("dml_allreduce_seconds",
+        "Time blocked in allreduce operations", stepBounds, "op=\"model_average\"");
+    m_live.globalLoss = &m_metrics.gauge("dml_global_loss", "Mean loss over all ranks in the last epoch");
+    m_live.samplesPerSecond = &m_metrics.gauge("dml_samples_per_second",
+        "Samples per second over all ranks in the last epoch");
+    m_live.epochsDone = &m_metrics.gauge("dml_epochs_completed", "Epochs completed in the current run");
+    m_live.computeSeconds = &m_metrics.gauge("dml_epoch_compute_seconds",
+        "Time this rank spent in forward and backward passes in the last epoch");
+    m_live.rankSkewSeconds = &m_metrics.gauge("dml_rank_skew_seconds",
+        "Slowest minus fastest rank compute time in the last epoch");
+    m_live.loadImbalance = &m_metrics.gauge("dml_load_imbalance",
+        "Slowest rank's compute time over the mean across ranks in the last epoch");
+    m_live.rebalances = &m_metrics.counter("dml_rebalances_total",
+        "Times samples were moved between ranks to even out compute time");
+    m_live.worldSize = &m_metrics.gauge("dml_world_size", "Ranks currently training");
+    m_live.membershipChanges = &m_metrics.counter("dml_membership_changes_total",
+        "Times ranks joined or were lost during training");
+    m_live.inputWaitSeconds = &m_metrics.histogram("dml_input_wait_seconds",
+        "Time the training loop waited for its next input batch", stepBounds);
+    m_live.inputStarvedBatches = &m_metrics.counter("dml_input_starved_batches_total",
+        "Input batches that were not ready when the training loop asked for them");
+    m_live.optimizerSteps = &m_metrics.counter("dml_optimizer_steps_total",
+        "Optimizer steps applied to the model on this rank");
+    m_live.stepAllocations = &m_metrics.counter("dml_step_heap_allocations_total",
+        "Heap allocations made by this rank's training steps");
+    m_live.worldSize->set(m_worldSize);
 
     // Validate and set default configuration
     validateAndSetConfig({0.01, 100, 32});
@@ -80,6 +250,12 @@ void DistributedTrainer::initialize() {
                              << m_rank << ", World Size: " << m_worldSize;
 }
 
+void DistributedTrainer::setupCommunicators() {
+    // Buckets reference the old topology's communicators
+    m_gradientBucketer.reset();
+    m_topology = std::make_unique<CommunicatorTopology>(m_communicator);
+}
+
 void DistributedTrainer::validateAndSetConfig(const TrainingConfig& config) {
     if (config.learningRate <= 0 || config.learningRate > 1.0) {
         BOOST_LOG_TRIVIAL(warning) << "Invalid learning rate. Using default.";
@@ -90,221 +266,1517 @@ void DistributedTrainer::validateAndSetConfig(const TrainingConfig& config) {
 
     m_config.epochs = std::max(1, config.epochs);
     m_config.batchSize = std::max(1, config.batchSize);
+    m_config.hiddenUnits = std::max(1, config.hiddenUnits);
+    m_config.precision = config.precision;
+    if (!Optimizer::valid(config.optimizer)) {
+        BOOST_LOG_TRIVIAL(warning) << "Invalid optimizer hyperparameters. Using defaults.";
+        m_config.optimizer = OptimizerOptions{};
+        m_config.optimizer.kind = config.optimizer.kind;
+    } else {
+        m_config.optimizer = config.optimizer;
+    }
+    m_config.accumulationSteps = std::max(0, config.accumulationSteps);
+    m_config.numThreads = config.numThreads > 0
+        ? config.numThreads
+        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    m_config.gradientBucketBytes = std::max(sizeof(double), config.gradientBucketBytes);
+    m_config.maxBucketsInFlight = std::max(1, config.maxBucketsInFlight);
+    m_config.gradientCompression = config.gradientCompression;
+    if (config.topKRatio <= 0.0 || config.topKRatio > 1.0) {
+        BOOST_LOG_TRIVIAL(warning) << "Invalid top-k ratio. Using default.";
+        m_config.topKRatio = 0.01;
+    } else {
+        m_config.topKRatio = config.topKRatio;
+    }
+    m_config.executionMode = config.executionMode;
+    m_config.averagingInterval = std::max(1, config.averagingInterval);
+    m_config.maxStaleness = std::max(0, config.maxStaleness);
+    m_config.checkpointPath = config.checkpointPath;
+    m_config.checkpointInterval = std::max(0, config.checkpointInterval);
+    m_config.traceFile = config.traceFile;
+    m_config.prefetchBatches = std::max(1, config.prefetchBatches);
+    m_config.inputWorkers = std::max(1, config.inputWorkers);
+    m_config.shuffle = config.shuffle;
+    m_config.shuffleSeed = config.shuffleSeed;
+    m_config.augmentation = config.augmentation;
+    if (m_config.augmentation.normalizeStd == 0.0f) {
+        BOOST_LOG_TRIVIAL(warning) << "Invalid normalization scale. Using 1.";
+        m_config.augmentation.normalizeStd = 1.0f;
+    }
+    m_config.rebalanceThreshold = std::max(0.0, config.rebalanceThreshold);
 
     BOOST_LOG_TRIVIAL(info) << "Configuration set: LR=" << m_config.learningRate 
                              << ", Epochs=" << m_config.epochs 
-                             << ", BatchSize=" << m_config.batchSize;
+                             << ", BatchSize=" << m_config.batchSize
+                             << ", Threads=" << m_config.numThreads
+                             << ", Precision=" << kernelPrecisionName(m_config.precision)
+                             << ", Compression=" << compressionModeName(m_config.gradientCompression)
+                             << ", Optimizer=" << optimizerKindName(m_config.optimizer.kind)
+                             << ", Accumulation=" << m_config.accumulationSteps
+                             << ", Mode=" << (m_config.executionMode == ExecutionMode::LocalSGD ? "local-sgd" : "sync");
 }
 
-void DistributedTrainer::distributeData(const std::vector<cv::Mat>& trainingData) {
-    if (trainingData.empty()) {
+void DistributedTrainer::distributeData(const std::vector<cv::Mat>& trainingData, const std::vector<int32_t>& labels) {
+    // Root describes the dataset: sample count, rows, cols and channels.
+    // Errors are broadcast too so that every rank fails together.
+    long long layout[4] = {0, 0, 0, 0};
+    if (m_rank == 0 && !trainingData.empty()) {
+        const cv::Mat& first = trainingData.front();
+        layout[0] = static_cast<long long>(trainingData.size());
+        layout[1] = first.rows;
+        layout[2] = first.cols;
+        layout[3] = first.channels();
+
+        for (const auto& sample : trainingData) {
+            if (sample.rows != first.rows || sample.cols != first.cols || sample.channels() != first.channels()) {
+                layout[0] = -1;
+                break;
+            }
+        }
+        if (layout[0] > std::numeric_limits<int>::max()) {
+            layout[0] = -2;
+        }
+        if (labels.size() != trainingData.size()) {
+            layout[0] = -3;
+        }
+    }
+    MPI_Bcast(layout, 4, MPI_LONG_LONG, 0, m_communicator);
+
+    if (layout[0] == 0) {
         BOOST_LOG_TRIVIAL(error) << "Attempted to distribute empty training data";
         throw std::invalid_argument("Training data is empty");
     }
+    if (layout[0] == -1) {
+        BOOST_LOG_TRIVIAL(error) << "Training samples differ in shape";
+        throw std::invalid_argument("Training samples must share the same shape");
+    }
+    if (layout[0] == -3) {
+        BOOST_LOG_TRIVIAL(error) << "Label count does not match sample count";
+        throw std::invalid_argument("Every training sample needs a label");
+    }
+    if (layout[0] < 0) {
+        BOOST_LOG_TRIVIAL(error) << "Training data exceeds MPI count limit";
+        throw std::invalid_argument("Training data is too large to scatter");
+    }
+
+    const int totalDataSize = static_cast<int>(layout[0]);
+    const int rows = static_cast<int>(layout[1]);
+    const int cols = static_cast<int>(layout[2]);
+    const int channels = static_cast<int>(layout[3]);
+    const Eigen::Index features = static_cast<Eigen::Index>(rows) * cols * channels;
 
-    int totalDataSize = trainingData.size();
+    // Compute per-node sample counts and offsets
     int dataPerNode = totalDataSize / m_worldSize;
     int remainder = totalDataSize % m_worldSize;
+    std::vector<int> counts(m_worldSize);
+    std::vector<int> displacements(m_worldSize);
+    for (int node = 0; node < m_worldSize; ++node) {
+        counts[node] = dataPerNode + (node < remainder ? 1 : 0);
+        displacements[node] = node * dataPerNode + std::min(node, remainder);
+    }
+
+    // Root packs every sample as float32 into one aligned send tensor
+    BatchTensor packed;
+    if (m_rank == 0) {
+        packed.resize(totalDataSize, features);
+        for (size_t i = 0; i < trainingData.size(); ++i) {
+            cv::Mat destination(rows, cols, CV_32FC(channels), packed.sample(static_cast<Eigen::Index>(i)));
+            trainingData[i].convertTo(destination, CV_32F);
+        }
+    }
+
+    // One padded sample row is the unit of the scatter so counts stay small
+    MPI_Datatype sampleType = sampleRowType(features);
 
-    // Compute start and end indices for data distribution
-    int startIndex = m_rank * dataPerNode + std::min(m_rank, remainder);
-    int endIndex = startIndex + dataPerNode + (m_rank < remainder ? 1 : 0);
+    m_shard.reset();
+    m_localStorage.resize(counts[m_rank], features);
 
-    // Distribute data to local node
-    m_localData = std::vector<cv::Mat>(
-        trainingData.begin() + startIndex, 
-        trainingData.begin() + endIndex
+    int scatterResult = MPI_Scatterv(
+        packed.data(),
+        counts.data(),
+        displacements.data(),
+        sampleType,
+        m_localStorage.data(),
+        counts[m_rank],
+        sampleType,
+        0, // Root node
+        m_communicator
     );
+    MPI_Type_free(&sampleType);
+
+    if (scatterResult == MPI_SUCCESS) {
+        m_localLabels.resize(counts[m_rank]);
+        scatterResult = MPI_Scatterv(
+            labels.data(),
+            counts.data(),
+            displacements.data(),
+            MPI_INT32_T,
+            m_localLabels.data(),
+            counts[m_rank],
+            MPI_INT32_T,
+            0, // Root node
+            m_communicator
+        );
+    }
+
+    if (scatterResult != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to scatter training data";
+        throw std::runtime_error("MPI_Scatterv failed");
+    }
+
+    m_localData = m_localStorage.view();
+    m_localBatchSize = 0;
+    m_rankRates.clear();
+    m_totalDataSize = static_cast<size_t>(totalDataSize);
+    m_sampleRows = rows;
+    m_sampleCols = cols;
+    m_sampleChannels = channels;
 
     BOOST_LOG_TRIVIAL(info) << "Node " << m_rank << " received " 
-                             << m_localData.size() << " training samples";
+                             << m_localData.samples << " training samples";
+}
+
+void DistributedTrainer::loadShard(const std::string& shardPath) {
+    m_localStorage.clear();
+    m_shard = std::make_unique<ShardReader>(shardPath);
+    m_totalDataSize = m_shard->sampleCount();
+    m_sampleRows = m_shard->rows();
+    m_sampleCols = m_shard->cols();
+    m_sampleChannels = m_shard->channels();
+    assignShardRange();
+}
+
+void DistributedTrainer::enableElastic(std::unique_ptr<RendezvousStore> store) {
+    m_elastic = std::make_unique<ElasticCoordinator>(m_communicator, std::move(store));
+    m_newcomer = m_elastic->joinedRunningJob();
+    m_communicator = m_elastic->communicator();
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_worldSize);
+    m_live.worldSize->set(m_worldSize);
+
+    if (m_newcomer) {
+        // Collectives are rebuilt together with the running job in train()
+        m_gradientBucketer.reset();
+        m_topology.reset();
+    } else {
+        // Rebuild so the derived communicators inherit the failure handler
+        setupCommunicators();
+    }
+}
+
+void DistributedTrainer::assignShardRange() {
+    // An even split; measured speeds no longer apply to the members
+    auto range = m_shard->partition(m_rank, m_worldSize);
+    m_localBatchSize = 0;
+    m_rankRates.clear();
+    mapShardRange(range.first, range.second);
+}
+
+void DistributedTrainer::mapShardRange(size_t begin, size_t end) {
+    // The view points straight into the read-only mapping; shard rows
+    // share the aligned stride used by BatchTensor
+    m_localData.data = m_shard->sample(begin);
+    m_localData.samples = static_cast<Eigen::Index>(end - begin);
+    m_localData.features = static_cast<Eigen::Index>(m_shard->rows()) * m_shard->cols() * m_shard->channels();
+    m_localData.stride = static_cast<Eigen::Index>(m_shard->strideFloats());
+
+    m_localLabels.resize(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        m_localLabels[i - begin] = m_shard->label(i);
+    }
+
+    m_shard->prefetch(begin, end);
+
+    BOOST_LOG_TRIVIAL(info) << "Node " << m_rank << " mapped samples ["
+                             << begin << ", " << end << ")";
 }
 
 void DistributedTrainer::train() {
-    if (m_localData.empty()) {
-        BOOST_LOG_TRIVIAL(warning) << "No local data available for training";
-        return;
+    if (m_elastic && !m_shard) {
+        BOOST_LOG_TRIVIAL(error) << "Elastic training needs a shard file to re-partition";
+        throw std::invalid_argument("Elastic training requires a shard file");
+    }
+
+    int firstEpoch = 0;
+    int batchesPerEpoch = 0;
+    m_stopRequested = false;
+    if (m_newcomer) {
+        // Joined a running job: take over its epoch, parameters and data split
+        resumeWithMembers(true, false, firstEpoch, batchesPerEpoch);
+        m_newcomer = false;
+    } else {
+        if (m_localData.empty()) {
+            BOOST_LOG_TRIVIAL(warning) << "No local data available for training";
+            return;
+        }
+
+        // Keep individual spans for the trace, aligned to rank 0's clock
+        if (!m_config.traceFile.empty()) {
+            m_tracker.enableTimeline(kMaxTimelineEvents);
+            m_timeline = std::make_unique<TimelineRecorder>(m_communicator);
+            m_timeline->synchronizeClocks();
+        }
+
+        // Build the model, resume from a checkpoint if there is one, and
+        // synchronize the root's parameters across all nodes
+        buildModel();
+        if (!m_config.checkpointPath.empty()) {
+            m_checkpoints = std::make_unique<CheckpointManager>(m_communicator, m_config.checkpointPath, true);
+            firstEpoch = restoreCheckpoint();
+        }
+        synchronizeModelParameters();
+
+        batchesPerEpoch = agreeOnBatchesPerEpoch();
+        if (m_taskContext) {
+            m_taskContext->setTotalSteps(static_cast<uint64_t>(m_config.epochs) * batchesPerEpoch);
+            m_taskContext->advanceSteps(static_cast<uint64_t>(firstEpoch) * batchesPerEpoch);
+            m_taskContext->setEpochsDone(static_cast<uint64_t>(firstEpoch));
+        }
     }
 
-    // Synchronize initial model parameters across all nodes
-    synchronizeModelParameters();
+    // Training loops return early at an epoch boundary when ranks join or
+    // are lost; continue on the new communicator
+    int completedEpochs = firstEpoch;
+    while (true) {
+        completedEpochs = m_config.executionMode == ExecutionMode::LocalSGD
+            ? trainLocalSgd(completedEpochs, batchesPerEpoch)
+            : trainSynchronous(completedEpochs, batchesPerEpoch);
+        if (m_membershipChange == MembershipChange::None) {
+            break;
+        }
+        changeMembership(completedEpochs, batchesPerEpoch);
+    }
+
+    // Final checkpoint, flushed before train() returns
+    if (m_checkpoints) {
+        saveCheckpoint(completedEpochs);
+        m_checkpoints->wait();
+    }
+
+    if (m_timeline) {
+        exportTimeline(m_config.traceFile);
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Distributed training completed";
+}
+
+int DistributedTrainer::trainSynchronous(int firstEpoch, int batchesPerEpoch) {
+    Eigen::Index batchSize = localBatchSize();
+    int localBatches = static_cast<int>((m_localData.samples + batchSize - 1) / batchSize);
+    // Mini-batches reduced together into one optimizer step
+    int stepBatches = m_config.accumulationSteps > 0
+        ? std::min(m_config.accumulationSteps, batchesPerEpoch)
+        : batchesPerEpoch;
+    int completedEpochs = firstEpoch;
+    startInputPipeline(firstEpoch, localBatches);
+
+    m_gradientBucketer = std::make_unique<GradientBucketer>(
+        *m_topology,
+        m_config.gradientBucketBytes / sizeof(double),
+        static_cast<size_t>(m_config.maxBucketsInFlight),
+        m_config.gradientCompression,
+        m_config.topKRatio
+    );
 
     // Distributed training loop
-    for (int epoch = 0; epoch < m_config.epochs; ++epoch) {
+    for (int epoch = firstEpoch; epoch < m_config.epochs; ++epoch) {
         BOOST_LOG_TRIVIAL(info) << "Epoch " << epoch + 1 << "/" << m_config.epochs;
-        
-        // Local batch processing
-        std::vector<Eigen::VectorXd> localGradients;
+        ScopedSpan epochSpan(m_tracker, m_spans.epoch);
+        auto epochStart = std::chrono::steady_clock::now();
+
+        // States to step back to if the members change during this epoch
+        if (m_elastic) {
+            std::swap(m_previousEpochState, m_epochStartState);
+            m_epochStartState = captureState();
+        }
         double localLoss = 0.0;
+        double localSamples = 0.0;
+        double gradientNorm = 0.0;
+        m_allocationMark = stepAllocationCount();
+        m_epochStepAllocations = 0;
 
         // Process local data in mini-batches
-        for (size_t batchStart = 0; batchStart < m_localData.size(); batchStart += m_config.batchSize) {
-            auto batchEnd = std::min(batchStart + m_config.batchSize, m_localData.size());
-            
-            // Simulate local batch training
-            Eigen::VectorXd batchGradient = processLocalBatch(
-                std::vector<cv::Mat>(m_localData.begin() + batchStart, m_localData.begin() + batchEnd)
-            );
+        for (int batch = 0; batch < batchesPerEpoch; ++batch) {
+            countStepAllocations();
+            const int stepFirstBatch = batch - batch % stepBatches;
+            if (batch == stepFirstBatch) {
+                m_stepArena.reset();
+                m_gradientBucketer->beginStep(m_model.parameterCount());
+            }
+            if (m_taskContext) {
+                m_taskContext->advanceSteps();
+            }
+            if (batch < localBatches) {
+                uint64_t stepStart = PerformanceTracker::now();
+                InputBatch input = nextInputBatch();
+                {
+                    ScopedSpan batchSpan(m_tracker, m_spans.batch);
+
+                    // Forward/backward pass on the prepared batch
+                    localLoss += processLocalBatch(input.samples, input.labels);
+                    localSamples += static_cast<double>(input.samples.samples);
+
+                    // Micro-batches of a group are summed locally, so only
+                    // the group's total crosses the wire
+                    if (stepBatches > 1 && batch == stepFirstBatch) {
+                        m_accumulatedGradient = m_workspace.gradient;
+                    } else if (stepBatches > 1) {
+                        m_accumulatedGradient += m_workspace.gradient;
+                    }
+                }
+                m_live.samples->inc(static_cast<uint64_t>(input.samples.samples));
+                m_live.stepSeconds->observe((PerformanceTracker::now() - stepStart) * 1e-9);
+            }
 
-            localGradients.push_back(batchGradient);
-            localLoss += computeLocalLoss(batchGradient);
+            // One reduction and optimizer step closes each group
+            if (batch + 1 - stepFirstBatch < stepBatches && batch + 1 < batchesPerEpoch) {
+                continue;
+            }
+            {
+                // Ranks that ran out of data before the group pad the
+                // bucket stream with zeros to keep collectives aligned
+                ScopedSpan appendSpan(m_tracker, m_spans.bucketAppend);
+                if (stepFirstBatch >= localBatches) {
+                    m_gradientBucketer->appendZeros();
+                } else {
+                    m_gradientBucketer->append(stepBatches > 1 ? m_accumulatedGradient : m_workspace.gradient);
+                }
+            }
+            StepArena::VectorMap globalGradient = aggregateGradients(globalSamplesInBatches(stepFirstBatch, batch + 1));
+
+            // A lost rank leaves the reduced values incomplete; stop stepping
+            if (m_elastic && m_elastic->failureDetected()) {
+                break;
+            }
+            updateModelParameters(globalGradient);
+            gradientNorm = globalGradient.norm();
         }
+        countStepAllocations();
+        m_lastEpochStepAllocations = m_epochStepAllocations;
+
+        // Aggregate loss across all nodes
+        double globalSamples = 0.0;
+        double globalLoss = aggregateLoss(localLoss, localSamples, globalSamples);
 
-        // Aggregate gradients and loss across all nodes
-        Eigen::VectorXd globalGradient = aggregateGradients(localGradients);
-        double globalLoss = aggregateLoss(localLoss);
+        // Abandon the epoch; its steps are undone once the members agree
+        if (m_elastic && m_elastic->failureDetected()) {
+            m_membershipChange = MembershipChange::Failure;
+            break;
+        }
 
-        // Update model parameters using distributed optimization
-        updateModelParameters(globalGradient, globalLoss);
+        BOOST_LOG_TRIVIAL(info) << "Global Loss: " << globalLoss
+                                 << ", Gradient Norm: " << gradientNorm;
+        completedEpochs = epoch + 1;
+        if (m_taskContext) {
+            m_taskContext->setEpochsDone(static_cast<uint64_t>(completedEpochs));
+        }
+        reportEpoch(completedEpochs, globalLoss, globalSamples, epochStart);
+
+        // Parameters are identical on every rank here; snapshot them while
+        // the next epoch runs
+        if (checkpointDue(completedEpochs)) {
+            saveCheckpoint(completedEpochs);
+        }
+        m_tracker.flush();
+
+        if (m_stopRequested) {
+            BOOST_LOG_TRIVIAL(info) << "Training cancelled after epoch " << completedEpochs;
+            break;
+        }
 
         // Optional: Early stopping condition
         if (shouldStopTraining(globalLoss)) {
             BOOST_LOG_TRIVIAL(info) << "Early stopping triggered";
             break;
         }
+
+        // Every rank learned the pending joins from the loss reduction
+        if (m_pendingJoins > 0 && completedEpochs < m_config.epochs) {
+            m_membershipChange = MembershipChange::Join;
+            break;
+        }
+
+        // Give faster ranks more samples and a larger share of each batch,
+        // so every rank still runs the same number of batches
+        if (completedEpochs < m_config.epochs && rebalanceLoad(batchesPerEpoch)) {
+            batchSize = localBatchSize();
+            localBatches = static_cast<int>((m_localData.samples + batchSize - 1) / batchSize);
+            stepBatches = m_config.accumulationSteps > 0
+                ? std::min(m_config.accumulationSteps, batchesPerEpoch)
+                : batchesPerEpoch;
+            startInputPipeline(completedEpochs, localBatches);
+        }
     }
 
-    BOOST_LOG_TRIVIAL(info) << "Distributed training completed";
+    m_input->stop();
+    return completedEpochs;
 }
 
-Eigen::VectorXd DistributedTrainer::processLocalBatch(const std::vector<cv::Mat>& localBatch) {
-    // Simulate local batch processing and gradient computation
-    Eigen::VectorXd localGradient(localBatch.size());
-    
-    for (size_t i = 0; i < localBatch.size(); ++i) {
-        // Placeholder for actual gradient computation
-        // In a real implementation, this would involve:
-        // 1. Forward pass
-        // 2. Loss computation
-        // 3. Backward pass to compute gradients
-        localGradient(i) = static_cast<double>(i) * m_config.learningRate;
+int DistributedTrainer::trainLocalSgd(int firstEpoch, int batchesPerEpoch) {
+    Eigen::Index localBatches = (m_localData.samples + localBatchSize() - 1) / localBatchSize();
+    long long step = 0;
+    int completedEpochs = firstEpoch;
+
+    const int stepBatches = std::max(1, m_config.accumulationSteps);
+    double accumulatedSamples = 0.0;
+
+    // Every rank takes batchesPerEpoch steps; the pipeline wraps around the
+    // local data to supply them
+    startInputPipeline(firstEpoch, batchesPerEpoch);
+
+    for (int epoch = firstEpoch; epoch < m_config.epochs; ++epoch) {
+        BOOST_LOG_TRIVIAL(info) << "Epoch " << epoch + 1 << "/" << m_config.epochs;
+        ScopedSpan epochSpan(m_tracker, m_spans.epoch);
+        auto epochStart = std::chrono::steady_clock::now();
+
+        double localLoss = 0.0;
+        double localSamples = 0.0;
+        m_allocationMark = stepAllocationCount();
+        m_epochStepAllocations = 0;
+
+        for (int batch = 0; batch < batchesPerEpoch; ++batch, ++step) {
+            countStepAllocations();
+            m_stepArena.reset();
+
+            // Ranks with fewer batches wrap around their data, so every rank
+            // takes the same number of steps and averaging rounds line up
+            uint64_t stepStart = PerformanceTracker::now();
+            InputBatch input = nextInputBatch();
+            double batchSamples = static_cast<double>(input.samples.samples);
+            ScopedSpan batchSpan(m_tracker, m_spans.batch);
+            if (m_taskContext) {
+                m_taskContext->advanceSteps();
+            }
+
+            double batchLoss = processLocalBatch(input.samples, input.labels);
+            if (batch < localBatches) {
+                localLoss += batchLoss;
+                localSamples += batchSamples;
+            }
+
+            // Local step on the mean gradient of the last stepBatches batches
+            Eigen::VectorXd& stepGradient = stepBatches > 1 ? m_accumulatedGradient : m_workspace.gradient;
+            if (stepBatches > 1 && batch % stepBatches == 0) {
+                m_accumulatedGradient = m_workspace.gradient;
+                accumulatedSamples = batchSamples;
+            } else if (stepBatches > 1) {
+                m_accumulatedGradient += m_workspace.gradient;
+                accumulatedSamples += batchSamples;
+            } else {
+                accumulatedSamples = batchSamples;
+            }
+            if ((batch + 1) % stepBatches == 0 || batch + 1 == batchesPerEpoch) {
+                ScopedSpan stepSpan(m_tracker, m_spans.optimizerStep);
+                stepGradient /= accumulatedSamples;
+                m_optimizer->step(m_model.parameters(), stepGradient, m_config.learningRate);
+                m_live.optimizerSteps->inc();
+            }
+
+            if ((step + 1) % m_config.averagingInterval == 0) {
+                completeModelAveraging(true);
+                startModelAveraging(step);
+            }
+
+            // Apply the average once it lands, or block when it would
+            // otherwise exceed the staleness bound
+            if (m_averagingRequest != MPI_REQUEST_NULL) {
+                completeModelAveraging(step - m_averagingStep >= m_config.maxStaleness);
+            }
+            m_live.samples->inc(static_cast<uint64_t>(batchSamples));
+            m_live.stepSeconds->observe((PerformanceTracker::now() - stepStart) * 1e-9);
+        }
+        countStepAllocations();
+        m_lastEpochStepAllocations = m_epochStepAllocations;
+
+        double globalSamples = 0.0;
+        double globalLoss = aggregateLoss(localLoss, localSamples, globalSamples);
+        if (m_elastic && m_elastic->failureDetected()) {
+            m_membershipChange = MembershipChange::Failure;
+            break;
+        }
+        BOOST_LOG_TRIVIAL(info) << "Global Loss: " << globalLoss;
+        completedEpochs = epoch + 1;
+        if (m_taskContext) {
+            m_taskContext->setEpochsDone(static_cast<uint64_t>(completedEpochs));
+        }
+        reportEpoch(completedEpochs, globalLoss, globalSamples, epochStart);
+
+        // Ranks hold different models; checkpoint their exact average
+        if (checkpointDue(completedEpochs)) {
+            averageModels();
+            saveCheckpoint(completedEpochs);
+        }
+        m_tracker.flush();
+
+        if (m_stopRequested) {
+            BOOST_LOG_TRIVIAL(info) << "Training cancelled after epoch " << completedEpochs;
+            break;
+        }
+
+        if (shouldStopTraining(globalLoss)) {
+            BOOST_LOG_TRIVIAL(info) << "Early stopping triggered";
+            break;
+        }
+
+        if (m_pendingJoins > 0 && completedEpochs < m_config.epochs) {
+            m_membershipChange = MembershipChange::Join;
+            break;
+        }
+
+        // Larger batches on faster ranks keep the local steps in step
+        if (completedEpochs < m_config.epochs && rebalanceLoad(batchesPerEpoch)) {
+            localBatches = (m_localData.samples + localBatchSize() - 1) / localBatchSize();
+            startInputPipeline(completedEpochs, batchesPerEpoch);
+        }
     }
 
-    return localGradient;
+    m_input->stop();
+
+    // Finish with one exact average so every rank holds the same model;
+    // after a membership change the members average instead
+    if (m_membershipChange == MembershipChange::None) {
+        averageModels();
+    }
+    return completedEpochs;
 }
 
-double DistributedTrainer::computeLocalLoss(const Eigen::VectorXd& localGradient) {
-    // Compute local loss based on gradient
-    return localGradient.norm();
+void DistributedTrainer::startInputPipeline(int firstEpoch, int batchesPerEpoch) {
+    InputPipeline::Options options;
+    options.batchSize = localBatchSize();
+    options.prefetchDepth = m_config.prefetchBatches;
+    options.workers = m_config.inputWorkers;
+    options.shuffle = m_config.shuffle;
+    options.seed = m_config.shuffleSeed;
+    options.rank = m_rank;
+    options.rows = m_sampleRows;
+    options.cols = m_sampleCols;
+    options.channels = m_sampleChannels;
+    options.augmentation = m_config.augmentation;
+
+    // Join the previous pipeline's threads before the new one starts reading
+    m_input.reset();
+    m_input = std::make_unique<InputPipeline>(
+        m_localData, m_localLabels.data(), firstEpoch, m_config.epochs, batchesPerEpoch, options);
 }
 
-Eigen::VectorXd DistributedTrainer::aggregateGradients(const std::vector<Eigen::VectorXd>& localGradients) {
-    // Aggregate gradients across nodes using MPI
-    Eigen::VectorXd globalGradient = Eigen::VectorXd::Zero(localGradients[0].size());
-    
-    // MPI reduction to aggregate gradients
+InputBatch DistributedTrainer::nextInputBatch() {
+    InputBatch input = m_input->next();
+    if (input.waitNanos > 0) {
+        // Compute waited for data: the run is input-bound at this step
+        m_tracker.record(m_spans.inputWait, PerformanceTracker::now() - input.waitNanos, input.waitNanos);
+        m_live.inputStarvedBatches->inc();
+    }
+    m_live.inputWaitSeconds->observe(input.waitNanos * 1e-9);
+    return input;
+}
+
+void DistributedTrainer::averageModels() {
+    completeModelAveraging(true);
     MPI_Allreduce(
-        localGradients[0].data(), 
-        globalGradient.data(), 
-        localGradients[0].size(), 
-        MPI_DOUBLE, 
-        MPI_SUM, 
+        MPI_IN_PLACE,
+        m_model.parameters().data(),
+        static_cast<int>(m_model.parameterCount()),
+        MPI_DOUBLE,
+        MPI_SUM,
         m_communicator
     );
+    m_model.parameters() /= static_cast<double>(m_worldSize);
+    m_live.allreduceBytes->inc(static_cast<uint64_t>(m_model.parameterCount()) * sizeof(double));
+}
+
+int DistributedTrainer::restoreCheckpoint() {
+    if (!m_checkpoints->exists()) {
+        return 0;
+    }
+
+    // Root receives the full state; synchronizeModelParameters spreads it
+    CheckpointState state = m_checkpoints->restore(static_cast<uint64_t>(m_model.parameterCount()));
+    if (m_rank == 0) {
+        m_model.parameters() = state.parameters;
+    }
+    if (state.optimizerState.size() == m_optimizer->state().size()) {
+        if (m_rank == 0) {
+            for (size_t i = 0; i < state.optimizerState.size(); ++i) {
+                m_optimizer->state()[i] = std::move(state.optimizerState[i]);
+            }
+        }
+        m_optimizer->setSteps(state.optimizerSteps);
+    } else if (m_rank == 0 && !state.optimizerState.empty()) {
+        BOOST_LOG_TRIVIAL(warning) << "Checkpoint optimizer state does not match "
+                                   << optimizerKindName(m_config.optimizer.kind) << "; starting it fresh";
+    }
+
+    m_resumedEpoch = static_cast<int>(state.epoch);
+    return m_resumedEpoch;
+}
+
+bool DistributedTrainer::checkpointDue(int completedEpochs) const {
+    return m_checkpoints && m_config.checkpointInterval > 0 &&
+           completedEpochs % m_config.checkpointInterval == 0 &&
+           completedEpochs < m_config.epochs;
+}
+
+void DistributedTrainer::saveCheckpoint(int completedEpochs) {
+    ScopedSpan span(m_tracker, m_spans.checkpoint);
+    if (m_config.executionMode == ExecutionMode::LocalSGD) {
+        // Each rank's optimizer state is its own; only the averaged model is kept
+        m_checkpoints->save(completedEpochs, m_model.parameters(), {});
+        return;
+    }
+    std::vector<const Eigen::VectorXd*> optimizerState;
+    for (const Eigen::VectorXd& state : m_optimizer->state()) {
+        optimizerState.push_back(&state);
+    }
+    m_checkpoints->save(completedEpochs, m_model.parameters(), optimizerState, m_optimizer->steps());
+}
+
+void DistributedTrainer::startModelAveraging(long long step) {
+    m_averagingSnapshot = m_model.parameters();
+    m_averagingBuffer = m_averagingSnapshot;
+    m_averagingStep = step;
+
+    int result = MPI_Iallreduce(
+        MPI_IN_PLACE,
+        m_averagingBuffer.data(),
+        static_cast<int>(m_averagingBuffer.size()),
+        MPI_DOUBLE,
+        MPI_SUM,
+        m_communicator,
+        &m_averagingRequest
+    );
+    if (result != MPI_SUCCESS) {
+        if (m_elastic && m_elastic->failureDetected()) {
+            // Handled at the end of the epoch
+            m_averagingRequest = MPI_REQUEST_NULL;
+            return;
+        }
+        BOOST_LOG_TRIVIAL(error) << "Failed to start model averaging";
+        throw std::runtime_error("MPI_Iallreduce failed");
+    }
+    m_live.allreduceBytes->inc(static_cast<uint64_t>(m_averagingBuffer.size()) * sizeof(double));
+}
+
+bool DistributedTrainer::completeModelAveraging(bool wait) {
+    if (m_averagingRequest == MPI_REQUEST_NULL) {
+        return false;
+    }
+
+    if (wait) {
+        uint64_t waitStart = PerformanceTracker::now();
+        MPI_Wait(&m_averagingRequest, MPI_STATUS_IGNORE);
+        uint64_t waitNanos = PerformanceTracker::now() - waitStart;
+        m_epochWaitNanos += waitNanos;
+        m_tracker.record(m_spans.averagingWait, waitStart, waitNanos);
+        m_live.averagingWaitSeconds->observe(waitNanos * 1e-9);
+        m_averagingWaitSeconds += waitNanos * 1e-9;
+    } else {
+        int completed = 0;
+        MPI_Test(&m_averagingRequest, &completed, MPI_STATUS_IGNORE);
+        if (!completed) {
+            return false;
+        }
+    }
+
+    // The sum is missing the ranks that were lost
+    if (m_elastic && m_elastic->failureDetected()) {
+        return false;
+    }
+
+    // Move to the average while keeping the local progress made since the
+    // snapshot: parameters += mean(snapshots) - snapshot
+    m_model.parameters() += m_averagingBuffer / static_cast<double>(m_worldSize) - m_averagingSnapshot;
+    ++m_averagingRounds;
+    return true;
+}
+
+void DistributedTrainer::exportTimeline(const std::string& path) {
+    if (!m_timeline) {
+        // Spans were not retained; the trace will only carry rank metadata
+        m_timeline = std::make_unique<TimelineRecorder>(m_communicator);
+        m_timeline->synchronizeClocks();
+    }
+    m_timeline->write(path, m_tracker);
+}
+
+void DistributedTrainer::buildModel() {
+    // Every rank must agree on the number of classes
+    int32_t localMaxLabel = -1;
+    for (int32_t label : m_localLabels) {
+        localMaxLabel = std::max(localMaxLabel, label);
+    }
+    int32_t globalMaxLabel = -1;
+    MPI_Allreduce(&localMaxLabel, &globalMaxLabel, 1, MPI_INT32_T, MPI_MAX, m_communicator);
+
+    createModel(std::max<Eigen::Index>(2, globalMaxLabel + 1));
+
+    // Only the root's initialization matters; it is broadcast afterwards
+    if (m_rank == 0) {
+        m_model.initialize(42);
+    }
+}
+
+void DistributedTrainer::createModel(Eigen::Index classes) {
+    m_model = MlpModel(m_localData.features, m_config.hiddenUnits, classes, m_config.precision);
+    m_optimizer = std::make_unique<Optimizer>(m_config.optimizer, m_model.blocks());
+
+    // Hybrid mode: one rank per node, batches split across local threads
+    m_threadPool.reset();
+    m_threadStates.clear();
+    if (m_config.numThreads > 1) {
+        m_threadPool = std::make_unique<ThreadPool>(static_cast<size_t>(m_config.numThreads));
+        m_threadStates = std::vector<ThreadState>(m_threadPool->size());
+        m_reduceTargets.reserve(m_threadStates.size());
+
+        // The pool provides the parallelism; keep Eigen single-threaded
+        Eigen::setNbThreads(1);
+    }
+    allocateWorkspaces();
+
+    BOOST_LOG_TRIVIAL(info) << "Model built: " << m_localData.features << " -> "
+                             << m_config.hiddenUnits << " -> " << classes
+                             << " (" << m_model.parameterCount() << " parameters, "
+                             << m_model.kernel().name() << " kernel)";
+}
+
+void DistributedTrainer::allocateWorkspaces() {
+    const Eigen::Index batchSize = std::max(localBatchSize(), m_config.batchSize);
+    m_workspace = m_model.createWorkspace(batchSize);
+    for (auto& state : m_threadStates) {
+        state.workspace = m_model.createWorkspace(batchSize);
+    }
+}
+
+double DistributedTrainer::processLocalBatch(const BatchView& localBatch, const int32_t* labels) {
+    // Compute time per sample is what rebalancing compares across ranks
+    uint64_t start = PerformanceTracker::now();
+    double loss = 0.0;
+    if (m_threadPool) {
+        loss = processBatchParallel(localBatch, labels);
+    } else {
+        // Batched GEMM forward and backward passes through Eigen
+        ScopedSpan span(m_tracker, m_spans.forwardBackward);
+        loss = m_model.computeGradient(localBatch, labels, m_workspace);
+    }
+    m_epochComputeNanos += PerformanceTracker::now() - start;
+    m_epochComputedSamples += static_cast<double>(localBatch.samples);
+    return loss;
+}
+
+double DistributedTrainer::processBatchParallel(const BatchView& localBatch, const int32_t* labels) {
+    // Several micro-batches per thread give idle workers something to steal
+    constexpr Eigen::Index minMicroBatch = 8;
+    const size_t threads = m_threadPool->size();
+    const size_t microBatches = std::max<size_t>(1, std::min<size_t>(
+        threads * 4,
+        static_cast<size_t>((localBatch.samples + minMicroBatch - 1) / minMicroBatch)
+    ));
+
+    for (auto& state : m_threadStates) {
+        state.loss = 0.0;
+        state.touched = false;
+    }
+
+    // The first micro-batch a worker runs overwrites its gradient, later
+    // ones accumulate, so no per-step zeroing pass is needed. Float32
+    // kernels keep the sum in single precision until every micro-batch ran.
+    m_threadPool->parallelFor(microBatches, [&](size_t index, size_t workerId) {
+        Eigen::Index begin = localBatch.samples * static_cast<Eigen::Index>(index) / static_cast<Eigen::Index>(microBatches);
+        Eigen::Index end = localBatch.samples * static_cast<Eigen::Index>(index + 1) / static_cast<Eigen::Index>(microBatches);
+
+        ThreadState& state = m_threadStates[workerId];
+        const uint64_t allocationsBefore = threadHeapAllocations();
+        ScopedSpan span(m_tracker, m_spans.microBatch);
+        state.loss += m_model.computeGradient(
+            localBatch.slice(begin, end), labels + begin, state.workspace, state.touched, false);
+        state.touched = true;
+        state.allocations += threadHeapAllocations() - allocationsBefore;
+    });
+
+    // One conversion per worker and batch, not per micro-batch
+    if (m_model.kernel().precision() == KernelPrecision::Float32) {
+        m_threadPool->parallelFor(m_threadStates.size(), [&](size_t index, size_t) {
+            if (m_threadStates[index].touched) {
+                m_model.widenGradient(m_threadStates[index].workspace);
+            }
+        });
+    }
+
+    // Workers' allocations count as the step's too
+    uint64_t workerAllocations = 0;
+    for (auto& state : m_threadStates) {
+        workerAllocations += state.allocations;
+        state.allocations = 0;
+    }
+    m_epochStepAllocations += workerAllocations;
+    m_live.stepAllocations->inc(workerAllocations);
+
+    reduceThreadGradients();
 
-    // Normalize by number of nodes
-    globalGradient /= m_worldSize;
+    // Hand the reduced gradient to the caller without copying
+    m_workspace.gradient.swap(m_threadStates.front().workspace.gradient);
+
+    double loss = 0.0;
+    for (const auto& state : m_threadStates) {
+        loss += state.loss;
+    }
+    return loss;
+}
+
+void DistributedTrainer::reduceThreadGradients() {
+    const size_t threads = m_threadStates.size();
+    const Eigen::Index parameterCount = m_model.parameterCount();
+
+    // Each level adds gradient i + stride into gradient i. Pairs and the
+    // slices within them are disjoint, so levels run without locks.
+    for (size_t stride = 1; stride < threads; stride *= 2) {
+        m_reduceTargets.clear();
+        for (size_t i = 0; i + stride < threads; i += 2 * stride) {
+            ThreadState& left = m_threadStates[i];
+            ThreadState& right = m_threadStates[i + stride];
+            if (!right.touched) {
+                continue;
+            }
+            if (!left.touched) {
+                // Adopt the partner's buffer instead of adding to garbage
+                left.workspace.gradient.swap(right.workspace.gradient);
+                left.touched = true;
+                right.touched = false;
+                continue;
+            }
+            m_reduceTargets.push_back(i);
+        }
+
+        if (m_reduceTargets.empty()) {
+            continue;
+        }
+
+        // Split each pair into slices so every level keeps all workers busy
+        const size_t slicesPerPair = std::max<size_t>(1, threads / m_reduceTargets.size());
+        const size_t tasks = m_reduceTargets.size() * slicesPerPair;
+        m_threadPool->parallelFor(tasks, [&](size_t index, size_t) {
+            size_t target = m_reduceTargets[index / slicesPerPair];
+            size_t slice = index % slicesPerPair;
+            Eigen::Index begin = parameterCount * static_cast<Eigen::Index>(slice) / static_cast<Eigen::Index>(slicesPerPair);
+            Eigen::Index end = parameterCount * static_cast<Eigen::Index>(slice + 1) / static_cast<Eigen::Index>(slicesPerPair);
+
+            m_threadStates[target].workspace.gradient.segment(begin, end - begin) +=
+                m_threadStates[target + stride].workspace.gradient.segment(begin, end - begin);
+        });
+
+        for (size_t target : m_reduceTargets) {
+            m_threadStates[target + stride].touched = false;
+        }
+    }
+}
+
+StepArena::VectorMap DistributedTrainer::aggregateGradients(double globalSamples) {
+    // Bucket reductions were started during batch processing; only the
+    // stragglers are waited on here
+    ScopedSpan span(m_tracker, m_spans.gradientAllreduce);
+    uint64_t waitStart = PerformanceTracker::now();
+    const Eigen::VectorXd& reduced = m_gradientBucketer->finishStep();
+    uint64_t waitNanos = PerformanceTracker::now() - waitStart;
+    m_epochWaitNanos += waitNanos;
+    m_live.gradientAllreduceSeconds->observe(waitNanos * 1e-9);
+
+    // The compressor counts what went on the wire across all buckets
+    if (const GradientCompressor* compressor = m_gradientBucketer->compressor()) {
+        m_live.allreduceBytes->inc(compressor->wireBytes() - m_reportedWireBytes);
+        m_reportedWireBytes = compressor->wireBytes();
+    }
+
+    // Normalize the summed gradient to a per-sample mean, in the same pass
+    // that moves it out of the bucketer's next-step accumulator
+    StepArena::VectorMap globalGradient = m_stepArena.vector(reduced.size());
+    globalGradient = reduced / std::max(1.0, globalSamples);
 
     return globalGradient;
 }
 
-double DistributedTrainer::aggregateLoss(double localLoss) {
-    double globalLoss = 0.0;
+double DistributedTrainer::aggregateLoss(double localLoss, double localSamples, double& globalSamples) {
+    // Loss, sample count, cancellation and the root's count of groups
+    // waiting to join travel in one reduction. Each rank also fills its own
+    // slots of the per-rank load table; the others stay zero in the sum.
+    ScopedSpan span(m_tracker, m_spans.lossAllreduce);
+    double cancelled = (m_taskContext && m_taskContext->cancelled()) ? 1.0 : 0.0;
+    double pendingJoins = (m_elastic && m_rank == 0) ? m_elastic->pendingJoins() : 0.0;
+    // Send and receive buffers come from the step arena, so they sit at
+    // the same addresses every epoch
+    const size_t totals = kLossTotals + kRankLoadFields * static_cast<size_t>(m_worldSize);
+    double* localTotals = m_stepArena.allocateArray<double>(totals);
+    double* globalTotals = m_stepArena.allocateArray<double>(totals);
+    std::fill(localTotals, localTotals + totals, 0.0);
+    localTotals[0] = localLoss;
+    localTotals[1] = localSamples;
+    localTotals[2] = cancelled;
+    localTotals[3] = pendingJoins;
+    double* load = localTotals + kLossTotals + kRankLoadFields * static_cast<size_t>(m_rank);
+    load[0] = m_epochComputeNanos * 1e-9;
+    load[1] = m_epochWaitNanos * 1e-9;
+    load[2] = m_epochComputedSamples;
+    m_epochComputeNanos = 0;
+    m_epochWaitNanos = 0;
+    m_epochComputedSamples = 0.0;
+
+    uint64_t reduceStart = PerformanceTracker::now();
     
     // MPI reduction to aggregate loss
     MPI_Allreduce(
-        &localLoss, 
-        &globalLoss, 
-        1, 
+        localTotals,
+        globalTotals,
+        static_cast<int>(totals),
         MPI_DOUBLE, 
         MPI_SUM, 
         m_communicator
     );
 
-    // Normalize by number of nodes
-    globalLoss /= m_worldSize;
+    m_live.lossAllreduceSeconds->observe((PerformanceTracker::now() - reduceStart) * 1e-9);
+    m_live.allreduceBytes->inc(totals * sizeof(double));
+    updateRankLoads(globalTotals + kLossTotals);
+
+    // Normalize by number of samples
+    globalSamples = globalTotals[1];
+    m_stopRequested = globalTotals[2] > 0.0;
+    m_pendingJoins = static_cast<int>(globalTotals[3]);
+    if (m_stopRequested && m_taskContext) {
+        m_taskContext->cancel();
+    }
+    return globalTotals[0] / std::max(1.0, globalSamples);
+}
+
+void DistributedTrainer::updateModelParameters(const Eigen::Ref<const Eigen::VectorXd>& globalGradient) {
+    // Fused optimizer pass over the flat parameter buffer; every rank holds
+    // the same gradient and state, so parameters stay identical
+    ScopedSpan span(m_tracker, m_spans.optimizerStep);
+    m_optimizer->step(m_model.parameters(), globalGradient, m_config.learningRate);
+    m_live.optimizerSteps->inc();
+}
+
+uint64_t DistributedTrainer::stepAllocationCount() const {
+    // Every heap allocation when the interposer is linked in, otherwise
+    // the blocks the step arena took from the heap
+    return allocationCountingEnabled() ? threadHeapAllocations() : m_stepArena.blockAllocations();
+}
 
-    return globalLoss;
+void DistributedTrainer::countStepAllocations() {
+    const uint64_t allocations = stepAllocationCount();
+    m_epochStepAllocations += allocations - m_allocationMark;
+    m_live.stepAllocations->inc(allocations - m_allocationMark);
+    m_allocationMark = allocations;
 }
 
-void DistributedTrainer::updateModelParameters(const Eigen::VectorXd& globalGradient, double globalLoss) {
-    // Simulate model parameter update
-    // In a real implementation, this would update neural network weights
-    BOOST_LOG_TRIVIAL(info) << "Global Loss: " << globalLoss 
-                             << ", Gradient Norm: " << globalGradient.norm();
+double DistributedTrainer::globalSamplesInBatches(int firstBatch, int endBatch) const {
+    long long samples = 0;
+    for (size_t rank = 0; rank < m_rankSamples.size(); ++rank) {
+        const long long rankSamples = m_rankSamples[rank];
+        const long long batchSize = m_rankBatchSizes[rank];
+        samples += std::min(rankSamples, endBatch * batchSize) - std::min(rankSamples, firstBatch * batchSize);
+    }
+    return static_cast<double>(samples);
+}
+
+DistributedTrainer::TrainingSnapshot DistributedTrainer::captureState() const {
+    return {m_model.parameters(), m_optimizer->state(), m_optimizer->steps()};
+}
+
+void DistributedTrainer::restoreState(const TrainingSnapshot& snapshot) {
+    m_model.parameters() = snapshot.parameters;
+    m_optimizer->state() = snapshot.optimizerState;
+    m_optimizer->setSteps(snapshot.optimizerSteps);
 }
 
 void DistributedTrainer::synchronizeModelParameters() {
-    // Synchronize initial model parameters across nodes using MPI
-    Eigen::VectorXd modelParameters = Eigen::VectorXd::Zero(10); // Replace with actual model parameters
-    
-    // MPI broadcast to synchronize model parameters
-    MPI_Bcast(
-        modelParameters.data(), 
-        modelParameters.size(), 
-        MPI_DOUBLE, 
-        0, // Root node
-        m_communicator
+    // Two-level broadcast: root to node leaders, then inside each node
+    m_topology->broadcast(
+        m_model.parameters().data(),
+        static_cast<int>(m_model.parameterCount()),
+        MPI_DOUBLE
     );
 
+    // Optimizer state travels with the parameters so every rank steps alike
+    for (Eigen::VectorXd& state : m_optimizer->state()) {
+        m_topology->broadcast(state.data(), static_cast<int>(state.size()), MPI_DOUBLE);
+    }
+    unsigned long long steps = m_optimizer->steps();
+    MPI_Bcast(&steps, 1, MPI_UNSIGNED_LONG_LONG, 0, m_communicator);
+    m_optimizer->setSteps(steps);
+
     BOOST_LOG_TRIVIAL(info) << "Model parameters synchronized";
 }
 
+void DistributedTrainer::updateRankLoads(const double* loads) {
+    m_rankLoads.resize(static_cast<size_t>(m_worldSize));
+    if (m_rankRates.size() != m_rankLoads.size()) {
+        m_rankRates.assign(m_rankLoads.size(), 0.0);
+    }
+
+    double slowest = 0.0;
+    double fastest = std::numeric_limits<double>::max();
+    double total = 0.0;
+    for (size_t rank = 0; rank < m_rankLoads.size(); ++rank) {
+        RankLoad& load = m_rankLoads[rank];
+        load.computeSeconds = loads[kRankLoadFields * rank];
+        load.waitSeconds = loads[kRankLoadFields * rank + 1];
+        load.samples = loads[kRankLoadFields * rank + 2];
+        slowest = std::max(slowest, load.computeSeconds);
+        fastest = std::min(fastest, load.computeSeconds);
+        total += load.computeSeconds;
+
+        // A rank that computed nothing keeps its previous estimate
+        if (load.computeSeconds > 0.0 && load.samples > 0.0) {
+            double rate = load.samples / load.computeSeconds;
+            m_rankRates[rank] = m_rankRates[rank] > 0.0
+                ? kRateSmoothing * rate + (1.0 - kRateSmoothing) * m_rankRates[rank]
+                : rate;
+        }
+    }
+
+    const double mean = total / static_cast<double>(m_rankLoads.size());
+    m_live.computeSeconds->set(m_rankLoads[static_cast<size_t>(m_rank)].computeSeconds);
+    m_live.rankSkewSeconds->set(slowest - fastest);
+    m_live.loadImbalance->set(mean > 0.0 ? slowest / mean : 1.0);
+}
+
+bool DistributedTrainer::rebalanceLoad(int& batchesPerEpoch) {
+    // Every rank holds the same load table, so all of them decide alike
+    if (m_config.rebalanceThreshold <= 0.0 || m_worldSize < 2 ||
+        m_rankLoads.size() != static_cast<size_t>(m_worldSize) ||
+        m_rankSamples.size() != static_cast<size_t>(m_worldSize)) {
+        return false;
+    }
+    double slowest = 0.0;
+    double total = 0.0;
+    for (const RankLoad& load : m_rankLoads) {
+        slowest = std::max(slowest, load.computeSeconds);
+        total += load.computeSeconds;
+    }
+    const double mean = total / m_worldSize;
+    if (mean <= 0.0 || slowest / mean <= 1.0 + m_config.rebalanceThreshold ||
+        std::find(m_rankRates.begin(), m_rankRates.end(), 0.0) != m_rankRates.end()) {
+        return false;
+    }
+
+    // Shares proportional to throughput; every rank keeps at least one
+    // sample so its speed is still measured
+    const long long samples = static_cast<long long>(m_totalDataSize);
+    const long long evenShare = (samples + m_worldSize - 1) / m_worldSize;
+    std::vector<long long> counts = proportionalShares(
+        m_rankRates, samples, samples >= m_worldSize ? 1 : 0, kMaxShareFactor * evenShare);
+    if (counts == m_rankSamples) {
+        return false;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Rebalancing: slowest rank computed " << slowest / mean
+                             << "x the mean; node " << m_rank << " moves from "
+                             << m_rankSamples[static_cast<size_t>(m_rank)] << " to "
+                             << counts[static_cast<size_t>(m_rank)] << " samples";
+
+    // The reader must let go of the old data before it moves
+    m_input->stop();
+    migrateSamples(counts);
+
+    // Keep the batch count of an even split and scale this rank's batch
+    // with its share, so the global batch size is unchanged
+    const long long evenBatches = std::max(1LL, (evenShare + m_config.batchSize - 1) / m_config.batchSize);
+    m_localBatchSize = static_cast<int>(std::max(1LL,
+        (counts[static_cast<size_t>(m_rank)] + evenBatches - 1) / evenBatches));
+    allocateWorkspaces();
+    batchesPerEpoch = agreeOnBatchesPerEpoch();
+
+    if (m_taskContext) {
+        uint64_t remaining = static_cast<uint64_t>(std::max(0, m_config.epochs - static_cast<int>(
+            m_taskContext->epochsDone()))) * batchesPerEpoch;
+        m_taskContext->setTotalSteps(m_taskContext->stepsDone() + remaining);
+    }
+    ++m_rebalances;
+    m_live.rebalances->inc();
+    return true;
+}
+
+void DistributedTrainer::migrateSamples(const std::vector<long long>& counts) {
+    // Ranks hold consecutive ranges of the global sample order, before
+    // and after
+    const size_t ranks = static_cast<size_t>(m_worldSize);
+    const size_t self = static_cast<size_t>(m_rank);
+    std::vector<long long> oldBegin(ranks + 1, 0);
+    std::vector<long long> newBegin(ranks + 1, 0);
+    for (size_t rank = 0; rank < ranks; ++rank) {
+        oldBegin[rank + 1] = oldBegin[rank] + m_rankSamples[rank];
+        newBegin[rank + 1] = newBegin[rank] + counts[rank];
+    }
+    for (size_t rank = 0; rank < ranks; ++rank) {
+        long long kept = std::max(0LL, std::min(oldBegin[rank + 1], newBegin[rank + 1]) -
+                                       std::max(oldBegin[rank], newBegin[rank]));
+        m_samplesMigrated += static_cast<uint64_t>(counts[rank] - kept);
+    }
+
+    if (m_shard) {
+        // Every rank maps the whole file; only the view moves
+        mapShardRange(static_cast<size_t>(newBegin[self]), static_cast<size_t>(newBegin[self + 1]));
+        return;
+    }
+
+    const Eigen::Index features = m_localData.features;
+    BatchTensor storage(static_cast<Eigen::Index>(counts[self]), features);
+    std::vector<int32_t> labels(static_cast<size_t>(counts[self]));
+    MPI_Datatype sampleType = sampleRowType(features);
+    std::vector<MPI_Request> requests;
+
+    for (size_t peer = 0; peer < ranks; ++peer) {
+        // Samples this rank holds that peer will own
+        long long first = std::max(oldBegin[self], newBegin[peer]);
+        long long last = std::min(oldBegin[self + 1], newBegin[peer + 1]);
+        if (first < last) {
+            const Eigen::Index source = static_cast<Eigen::Index>(first - oldBegin[self]);
+            const int count = static_cast<int>(last - first);
+            if (peer == self) {
+                const Eigen::Index target = static_cast<Eigen::Index>(first - newBegin[self]);
+                std::memcpy(storage.sample(target), m_localStorage.sample(source),
+                            static_cast<size_t>(count) * storage.stride() * sizeof(float));
+                std::copy(m_localLabels.begin() + source, m_localLabels.begin() + source + count,
+                          labels.begin() + target);
+            } else {
+                requests.emplace_back();
+                MPI_Isend(m_localStorage.sample(source), count, sampleType, static_cast<int>(peer),
+                          kMigrateSamplesTag, m_communicator, &requests.back());
+                requests.emplace_back();
+                MPI_Isend(m_localLabels.data() + source, count, MPI_INT32_T, static_cast<int>(peer),
+                          kMigrateLabelsTag, m_communicator, &requests.back());
+            }
+        }
+
+        // Samples peer holds that this rank will own
+        first = std::max(oldBegin[peer], newBegin[self]);
+        last = std::min(oldBegin[peer + 1], newBegin[self + 1]);
+        if (peer != self && first < last) {
+            const Eigen::Index target = static_cast<Eigen::Index>(first - newBegin[self]);
+            const int count = static_cast<int>(last - first);
+            requests.emplace_back();
+            MPI_Irecv(storage.sample(target), count, sampleType, static_cast<int>(peer),
+                      kMigrateSamplesTag, m_communicator, &requests.back());
+            requests.emplace_back();
+            MPI_Irecv(labels.data() + target, count, MPI_INT32_T, static_cast<int>(peer),
+                      kMigrateLabelsTag, m_communicator, &requests.back());
+        }
+    }
+
+    int result = MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+    MPI_Type_free(&sampleType);
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to migrate training samples";
+        throw std::runtime_error("Sample migration failed");
+    }
+
+    m_localStorage = std::move(storage);
+    m_localLabels.swap(labels);
+    m_localData = m_localStorage.view();
+}
+
+void DistributedTrainer::reportEpoch(int completedEpochs, double globalLoss, double globalSamples,
+                                     std::chrono::steady_clock::time_point epochStart) {
+    double epochMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - epochStart).count();
+    double samplesPerSecond = epochMs > 0.0 ? globalSamples * 1000.0 / epochMs : 0.0;
+    m_live.globalLoss->set(globalLoss);
+    m_live.samplesPerSecond->set(samplesPerSecond);
+    m_live.epochsDone->set(completedEpochs);
+
+    // Restart the busy-time window so each epoch reports its own idle time
+    if (m_threadPool) {
+        m_epochThreadUtilization = m_threadPool->utilization();
+        m_threadPool->resetUtilization();
+    }
+
+    if (!m_epochCallback) {
+        return;
+    }
+    nlohmann::json metrics = {
+        {"epoch", completedEpochs},
+        {"epochs", m_config.epochs},
+        {"loss", globalLoss},
+        {"epoch_ms", epochMs},
+        {"samples_per_second", samplesPerSecond}
+    };
+    m_epochCallback(metrics);
+}
+
 bool DistributedTrainer::shouldStopTraining(double globalLoss) {
     // Simple early stopping condition
-    static double bestLoss = std::numeric_limits<double>::max();
-    static int patience = 3;
-    static int noImprovementCount = 0;
+    constexpr int patience = 3;
 
-    if (globalLoss < bestLoss) {
-        bestLoss = globalLoss;
-        noImprovementCount = 0;
+    if (globalLoss < m_bestLoss) {
+        m_bestLoss = globalLoss;
+        m_epochsWithoutImprovement = 0;
     } else {
-        noImprovementCount++;
+        m_epochsWithoutImprovement++;
     }
 
-    return noImprovementCount >= patience;
+    return m_epochsWithoutImprovement >= patience;
 }
 
-Eigen::MatrixXd DistributedTrainer::aggregateResults() {
-    // Aggregate results across nodes using MPI
-    Eigen::MatrixXd localResults(m_localData.size(), 1);
-    
-    for (size_t i = 0; i < m_localData.size(); ++i) {
-        localResults(i, 0) = static_cast<double>(i);
+int DistributedTrainer::agreeOnBatchesPerEpoch() {
+    // Every rank must issue the same sequence of bucket reductions, so agree
+    // on the number of mini-batches per epoch up front. Gathering the sample
+    // counts lets each rank size every accumulated step's global batch
+    // without another reduction.
+    long long local[2] = {static_cast<long long>(m_localData.samples), localBatchSize()};
+    std::vector<long long> gathered(2 * static_cast<size_t>(m_worldSize));
+    MPI_Allgather(local, 2, MPI_LONG_LONG, gathered.data(), 2, MPI_LONG_LONG, m_communicator);
+
+    m_rankSamples.resize(static_cast<size_t>(m_worldSize));
+    m_rankBatchSizes.resize(static_cast<size_t>(m_worldSize));
+    long long batches = 0;
+    for (size_t rank = 0; rank < m_rankSamples.size(); ++rank) {
+        m_rankSamples[rank] = gathered[2 * rank];
+        m_rankBatchSizes[rank] = gathered[2 * rank + 1];
+        batches = std::max(batches, (m_rankSamples[rank] + m_rankBatchSizes[rank] - 1) / m_rankBatchSizes[rank]);
     }
+    return static_cast<int>(batches);
+}
 
-    // MPI gather to collect results from all nodes
-    Eigen::MatrixXd globalResults(m_localData.size() * m_worldSize, 1);
-    MPI_Gather(
-        localResults.data(), 
-        localResults.size(), 
-        MPI_DOUBLE, 
-        globalResults.data(), 
-        localResults.size(), 
-        MPI_DOUBLE, 
-        0, // Root node
-        m_communicator
-    );
+void DistributedTrainer::changeMembership(int& completedEpochs, int& batchesPerEpoch) {
+    const int previousWorldSize = m_worldSize;
+    const bool afterFailure = m_membershipChange == MembershipChange::Failure;
+    if (afterFailure) {
+        // Unblock ranks still waiting in node or leader collectives before
+        // leaving the broken communicators behind
+        m_elastic->revoke(m_topology->nodeCommunicator());
+        m_elastic->revoke(m_topology->leaderCommunicator());
+        releaseCommunicatorState();
+        m_elastic->shrink();
+    } else {
+        // Local SGD: let the last average land while the old members remain
+        completeModelAveraging(true);
+        releaseCommunicatorState();
+        m_elastic->admit(m_pendingJoins);
+    }
+    m_membershipChange = MembershipChange::None;
+    m_pendingJoins = 0;
+
+    resumeWithMembers(false, afterFailure, completedEpochs, batchesPerEpoch);
+    BOOST_LOG_TRIVIAL(info) << "World size changed from " << previousWorldSize << " to " << m_worldSize;
+}
+
+void DistributedTrainer::releaseCommunicatorState() {
+    // An average still in flight is dropped; its peers may be gone
+    if (m_averagingRequest != MPI_REQUEST_NULL) {
+        MPI_Wait(&m_averagingRequest, MPI_STATUS_IGNORE);
+        m_averagingRequest = MPI_REQUEST_NULL;
+    }
+    m_checkpoints.reset();
+    m_timeline.reset();
+    m_gradientBucketer.reset();
+    m_topology.reset();
+}
+
+void DistributedTrainer::resumeWithMembers(bool newcomer, bool afterFailure, int& completedEpochs,
+                                           int& batchesPerEpoch) {
+    m_communicator = m_elastic->communicator();
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_worldSize);
+    setupCommunicators();
+
+    // Resume after the last epoch every old member completed, and tell
+    // newcomers the class count. One MIN reduction carries both.
+    int local[2] = {
+        newcomer ? std::numeric_limits<int>::max() : completedEpochs,
+        newcomer ? 0 : -static_cast<int>(m_model.outputSize())
+    };
+    int agreed[2] = {0, 0};
+    MPI_Allreduce(local, agreed, 2, MPI_INT, MPI_MIN, m_communicator);
+
+    if (newcomer) {
+        createModel(-agreed[1]);
+    } else if (m_config.executionMode == ExecutionMode::Synchronous && completedEpochs > agreed[0]) {
+        // This rank finished an epoch that the others abandoned
+        restoreState(m_previousEpochState);
+    } else if (m_config.executionMode == ExecutionMode::Synchronous && afterFailure) {
+        // Steps already taken in the interrupted epoch are repeated
+        restoreState(m_epochStartState);
+    }
+    completedEpochs = agreed[0];
+
+    if (m_config.executionMode == ExecutionMode::LocalSGD) {
+        // Models differ between ranks: everyone starts from the old members' mean
+        double members = newcomer ? 0.0 : 1.0;
+        if (newcomer) {
+            m_model.parameters().setZero();
+        }
+        MPI_Allreduce(MPI_IN_PLACE, &members, 1, MPI_DOUBLE, MPI_SUM, m_communicator);
+        MPI_Allreduce(
+            MPI_IN_PLACE,
+            m_model.parameters().data(),
+            static_cast<int>(m_model.parameterCount()),
+            MPI_DOUBLE,
+            MPI_SUM,
+            m_communicator
+        );
+        m_model.parameters() /= members;
+        m_optimizer->reset();
+    } else {
+        // Old members hold identical parameters, and rank 0 is always one
+        synchronizeModelParameters();
+    }
+
+    // Re-partition the shard over the new members
+    assignShardRange();
+    batchesPerEpoch = agreeOnBatchesPerEpoch();
+
+    if (!m_config.checkpointPath.empty()) {
+        m_checkpoints = std::make_unique<CheckpointManager>(m_communicator, m_config.checkpointPath, true);
+    }
+    if (!m_config.traceFile.empty()) {
+        if (newcomer) {
+            m_tracker.enableTimeline(kMaxTimelineEvents);
+        }
+        m_timeline = std::make_unique<TimelineRecorder>(m_communicator);
+        m_timeline->synchronizeClocks();
+    }
+
+    // Start early stopping over so that every rank decides alike; loads of
+    // the interrupted epoch are not comparable across the new members
+    m_bestLoss = std::numeric_limits<double>::max();
+    m_epochsWithoutImprovement = 0;
+    m_reportedWireBytes = 0;
+    m_epochComputeNanos = 0;
+    m_epochWaitNanos = 0;
+    m_epochComputedSamples = 0.0;
+    m_rankLoads.clear();
 
+    if (m_taskContext) {
+        uint64_t remaining = static_cast<uint64_t>(std::max(0, m_config.epochs - completedEpochs)) * batchesPerEpoch;
+        m_taskContext->setTotalSteps(m_taskContext->stepsDone() + remaining);
+        m_taskContext->setEpochsDone(static_cast<uint64_t>(completedEpochs));
+    }
+    m_live.worldSize->set(m_worldSize);
+    m_live.membershipChanges->inc();
+
+    BOOST_LOG_TRIVIAL(info) << "Node " << m_rank << " of " << m_worldSize
+                             << " resuming after epoch " << completedEpochs;
+}
+
+void DistributedTrainer::aggregateResults(ResultSink* sink, Eigen::Index chunkRows) {
+    if (m_model.parameterCount() == 0) {
+        throw std::logic_error("Results need a trained model");
+    }
+
+    // Predictions are computed a training batch at a time, straight into
+    // the chunk being sent
+    const Eigen::Index classes = m_model.outputSize();
+    const Eigen::Index batchSize = m_workspace.output.rows();
+    auto produce = [this, classes, batchSize](Eigen::Index first, Eigen::Index count, double* rows) {
+        using RowMajorMap = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+        RowMajorMap chunk(rows, count, classes);
+        for (Eigen::Index begin = 0; begin < count; begin += batchSize) {
+            const Eigen::Index n = std::min(batchSize, count - begin);
+            m_model.predict(m_localData.slice(first + begin, first + begin + n), m_workspace);
+            chunk.middleRows(begin, n) = m_workspace.output.topRows(n);
+        }
+    };
+
+    gatherResults(m_communicator, m_localData.samples, classes, produce, sink, chunkRows);
     BOOST_LOG_TRIVIAL(info) << "Results aggregated from node " << m_rank;
-    return globalResults;
+}
+
+Eigen::MatrixXd DistributedTrainer::aggregateResults() {
+    MatrixResultSink sink;
+    aggregateResults(m_rank == 0 ? &sink : nullptr);
+    return sink.release();
 }
 
 nlohmann::json DistributedTrainer::getPerformanceMetrics() const {
     nlohmann::json metrics;
     metrics["rank"] = m_rank;
     metrics["world_size"] = m_worldSize;
-    metrics["local_data_size"] = m_localData.size();
+    metrics["local_data_size"] = m_localData.samples;
     metrics["learning_rate"] = m_config.learningRate;
     metrics["epochs"] = m_config.epochs;
     metrics["batch_size"] = m_config.batchSize;
-    metrics["total_data_size"] = m_localData.size() * m_worldSize;
+    metrics["total_data_size"] = m_totalDataSize;
+    metrics["hidden_units"] = m_config.hiddenUnits;
+    metrics["model_parameters"] = m_model.parameterCount();
+    metrics["threads"] = m_config.numThreads;
+    if (m_threadPool) {
+        metrics["thread_utilization"] = m_epochThreadUtilization;
+    }
+    metrics["gradient_compression"] = compressionModeName(m_config.gradientCompression);
+    const GradientCompressor* compressor = m_gradientBucketer ? m_gradientBucketer->compressor() : nullptr;
+    if (compressor && compressor->rawBytes() > 0) {
+        metrics["gradient_wire_bytes"] = compressor->wireBytes();
+        metrics["gradient_compression_ratio"] =
+            static_cast<double>(compressor->rawBytes()) / static_cast<double>(compressor->wireBytes());
+    }
+    metrics["execution_mode"] = m_config.executionMode == ExecutionMode::LocalSGD ? "local-sgd" : "sync";
+    if (m_config.executionMode == ExecutionMode::LocalSGD) {
+        metrics["averaging_rounds"] = m_averagingRounds;
+        metrics["averaging_wait_seconds"] = m_averagingWaitSeconds;
+    }
+    if (m_checkpoints) {
+        metrics["checkpoint_path"] = m_checkpoints->path();
+        metrics["checkpoint_write_seconds"] = m_checkpoints->lastWriteSeconds();
+        metrics["resumed_from_epoch"] = m_resumedEpoch;
+    }
+    if (m_input) {
+        InputPipeline::Stats input = m_input->stats();
+        metrics["input_batches"] = input.batches;
+        metrics["input_starved_batches"] = input.starvedBatches;
+        metrics["input_starved_seconds"] = input.starvedSeconds;
+        metrics["input_reader_blocked_seconds"] = input.readerBlockedSeconds;
+    }
+    if (m_optimizer) {
+        metrics["kernel"] = m_model.kernel().name();
+        metrics["optimizer"] = optimizerKindName(m_config.optimizer.kind);
+        metrics["optimizer_steps"] = m_optimizer->steps();
+        metrics["accumulation_steps"] = m_config.accumulationSteps;
+    }
+    // Zero once steps have settled: step buffers come from the arena
+    metrics["step_heap_allocations"] = m_live.stepAllocations->value();
+    metrics["last_epoch_step_heap_allocations"] = m_lastEpochStepAllocations;
+    metrics["step_allocations_counted"] = allocationCountingEnabled() ? "heap" : "arena";
+    metrics["step_arena_bytes"] = m_stepArena.highWater();
+    metrics["spans"] = m_tracker.getMetrics();
+    if (m_timeline) {
+        metrics["clock_offset_ns"] = m_timeline->clockOffsetNanos();
+    }
+    metrics["dropped_spans"] = m_tracker.droppedSpans();
+    if (m_elastic) {
+        metrics["membership_changes"] = m_elastic->generation();
+    }
+    if (!m_rankLoads.empty()) {
+        // Last epoch's per-rank compute and reduction wait, and how the
+        // samples are currently split
+        nlohmann::json stragglers;
+        size_t slowest = 0;
+        double total = 0.0;
+        for (size_t rank = 0; rank < m_rankLoads.size(); ++rank) {
+            const RankLoad& load = m_rankLoads[rank];
+            stragglers["compute_seconds"].push_back(load.computeSeconds);
+            stragglers["wait_seconds"].push_back(load.waitSeconds);
+            stragglers["samples_per_second"].push_back(
+                load.computeSeconds > 0.0 ? load.samples / load.computeSeconds : 0.0);
+            if (load.computeSeconds > m_rankLoads[slowest].computeSeconds) {
+                slowest = rank;
+            }
+            total += load.computeSeconds;
+        }
+        const double mean = total / static_cast<double>(m_rankLoads.size());
+        stragglers["slowest_rank"] = slowest;
+        stragglers["imbalance"] = mean > 0.0 ? m_rankLoads[slowest].computeSeconds / mean : 1.0;
+        stragglers["local_samples"] = m_rankSamples;
+        stragglers["batch_sizes"] = m_rankBatchSizes;
+        stragglers["rebalances"] = m_rebalances;
+        stragglers["samples_migrated"] = m_samplesMigrated;
+        metrics["stragglers"] = stragglers;
+    }
+    // No topology while the membership is changing
+    if (m_topology) {
+        metrics["nodes"] = m_topology->nodeCount();
+        metrics["ranks_on_node"] = m_topology->localSize();
+    }
 
     return metrics;
 }
 
 // TODO: Improve error handling
-// TODO: Implement more efficient data distribution
 
 } // namespace DistributedML
@@ -0,0 +1,299 @@
+#include "../include/elastic_coordinator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+
+// ULFM lives in mpi-ext.h on Open MPI and in mpi.h on MPICH
+#if defined(OPEN_MPI) && OPEN_MPI
+#include <mpi-ext.h>
+#endif
+#if defined(MPIX_ERR_PROC_FAILED) && !defined(DML_DISABLE_ULFM)
+#define DML_HAVE_ULFM 1
+#else
+#define DML_HAVE_ULFM 0
+#endif
+
+namespace DistributedML {
+
+namespace {
+
+constexpr char kLeaderKey[] = "leader";
+constexpr char kPortKey[] = "port";
+constexpr char kJoinRequestsKey[] = "join_requests";
+constexpr char kJoinsAdmittedKey[] = "joins_admitted";
+
+constexpr std::chrono::milliseconds kPortPollInterval(200);
+constexpr std::chrono::seconds kPortWaitLogInterval(30);
+
+#if DML_HAVE_ULFM
+// Set by the error handler, which may run on any thread that calls MPI
+std::atomic<bool> g_failureDetected{false};
+std::atomic<MPI_Comm> g_memberCommunicator{MPI_COMM_NULL};
+
+// Record a failed peer and revoke the communicators involved, so ranks
+// blocked in other collectives on them return instead of waiting forever
+void onCommunicatorError(MPI_Comm* communicator, int* error, ...) {
+    int errorClass = MPI_SUCCESS;
+    MPI_Error_class(*error, &errorClass);
+    if (errorClass != MPIX_ERR_PROC_FAILED && errorClass != MPIX_ERR_REVOKED) {
+        // Anything else is as fatal as under MPI_ERRORS_ARE_FATAL
+        MPI_Abort(*communicator, *error);
+    }
+
+    g_failureDetected.store(true);
+    MPIX_Comm_revoke(*communicator);
+    MPI_Comm members = g_memberCommunicator.load();
+    if (members != MPI_COMM_NULL && members != *communicator) {
+        MPIX_Comm_revoke(members);
+    }
+}
+#endif
+
+std::string processName() {
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    return std::string(host) + ":" + std::to_string(getpid());
+}
+
+} // namespace
+
+ElasticCoordinator::ElasticCoordinator(MPI_Comm world, std::unique_ptr<RendezvousStore> store)
+    : m_store(std::move(store)),
+      m_communicator(world),
+      m_ownsCommunicator(false),
+      m_errorHandler(MPI_ERRHANDLER_NULL),
+      m_joined(false),
+      m_generation(0),
+      m_portName{},
+      m_portOpen(false) {
+
+#if DML_HAVE_ULFM
+    MPI_Comm_create_errhandler(onCommunicatorError, &m_errorHandler);
+#endif
+
+    // Rank 0 decides for its whole group whether to found or join
+    int rank = 0;
+    MPI_Comm_rank(world, &rank);
+    int founder = 0;
+    if (rank == 0) {
+        founder = m_store->setIfAbsent(kLeaderKey, processName()) ? 1 : 0;
+    }
+    MPI_Bcast(&founder, 1, MPI_INT, 0, world);
+
+    if (founder) {
+        adopt(world);
+        publishPort();
+        BOOST_LOG_TRIVIAL(info) << "Founded elastic job"
+                                << (faultTolerant() ? "" : " (rank loss is fatal without ULFM)");
+        return;
+    }
+
+    // The port is only needed at the root of the connect
+    std::string port;
+    if (rank == 0) {
+        port = waitForPort();
+        m_store->add(kJoinRequestsKey, 1);
+        BOOST_LOG_TRIVIAL(info) << "Waiting to be admitted to the running job";
+    }
+
+    MPI_Comm intercommunicator;
+    if (MPI_Comm_connect(port.c_str(), MPI_INFO_NULL, 0, world, &intercommunicator) != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to connect to the running job";
+        throw std::runtime_error("MPI_Comm_connect failed");
+    }
+
+    // Joiners order after the running job, so its rank 0 stays rank 0
+    MPI_Comm merged;
+    MPI_Intercomm_merge(intercommunicator, 1, &merged);
+    MPI_Comm_free(&intercommunicator);
+    adopt(merged);
+    m_joined = true;
+
+    // Take part in admitting the groups that queued behind this one
+    admit(0);
+}
+
+ElasticCoordinator::~ElasticCoordinator() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized) {
+        return;
+    }
+
+#if DML_HAVE_ULFM
+    g_memberCommunicator.store(MPI_COMM_NULL);
+#endif
+
+    // The job is over: clear the store so the directory can host the next one
+    if (m_portOpen) {
+        try {
+            m_store->remove(kPortKey);
+            m_store->remove(kLeaderKey);
+            m_store->remove(kJoinRequestsKey);
+            m_store->remove(kJoinsAdmittedKey);
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(warning) << "Failed to clear rendezvous store: " << e.what();
+        }
+        MPI_Close_port(m_portName);
+    }
+
+    if (m_ownsCommunicator) {
+        MPI_Comm_free(&m_communicator);
+    }
+    if (m_errorHandler != MPI_ERRHANDLER_NULL) {
+        MPI_Errhandler_free(&m_errorHandler);
+    }
+}
+
+void ElasticCoordinator::adopt(MPI_Comm communicator) {
+    if (m_ownsCommunicator && communicator != m_communicator) {
+        MPI_Comm_free(&m_communicator);
+    }
+    m_ownsCommunicator = communicator != MPI_COMM_WORLD && communicator != MPI_COMM_SELF;
+    m_communicator = communicator;
+
+    // Communicators split or duplicated from this one inherit the handler
+    if (m_errorHandler != MPI_ERRHANDLER_NULL) {
+        MPI_Comm_set_errhandler(m_communicator, m_errorHandler);
+    }
+#if DML_HAVE_ULFM
+    g_memberCommunicator.store(m_communicator);
+#endif
+}
+
+void ElasticCoordinator::publishPort() {
+    int rank = 0;
+    MPI_Comm_rank(m_communicator, &rank);
+    if (rank != 0 || m_portOpen) {
+        return;
+    }
+
+    if (MPI_Open_port(MPI_INFO_NULL, m_portName) != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to open an MPI port for joining ranks";
+        throw std::runtime_error("MPI_Open_port failed");
+    }
+    m_portOpen = true;
+    m_store->set(kPortKey, m_portName);
+}
+
+std::string ElasticCoordinator::waitForPort() const {
+    // The port is briefly absent while a new root takes over
+    auto lastLog = std::chrono::steady_clock::now();
+    while (true) {
+        if (auto port = m_store->get(kPortKey)) {
+            if (!port->empty() && port->size() < MPI_MAX_PORT_NAME) {
+                return *port;
+            }
+        }
+        std::this_thread::sleep_for(kPortPollInterval);
+        if (std::chrono::steady_clock::now() - lastLog >= kPortWaitLogInterval) {
+            BOOST_LOG_TRIVIAL(warning) << "Still waiting for the running job to publish its port";
+            lastLog = std::chrono::steady_clock::now();
+        }
+    }
+}
+
+int ElasticCoordinator::pendingJoins() const {
+    auto requests = m_store->get(kJoinRequestsKey);
+    auto admitted = m_store->get(kJoinsAdmittedKey);
+    long long pending = (requests ? std::stoll(*requests) : 0) - (admitted ? std::stoll(*admitted) : 0);
+    return static_cast<int>(std::max(0LL, pending));
+}
+
+void ElasticCoordinator::admit(int pending) {
+    int rank = 0;
+    MPI_Comm_rank(m_communicator, &rank);
+    int before = 0;
+    MPI_Comm_size(m_communicator, &before);
+
+    // Groups merged in earlier rounds join the following accepts, so the
+    // remaining count is re-announced on the grown communicator each time
+    int admitted = 0;
+    while (true) {
+        MPI_Bcast(&pending, 1, MPI_INT, 0, m_communicator);
+        if (pending <= 0) {
+            break;
+        }
+
+        MPI_Comm intercommunicator;
+        if (MPI_Comm_accept(m_portName, MPI_INFO_NULL, 0, m_communicator, &intercommunicator) != MPI_SUCCESS) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to accept a joining group";
+            throw std::runtime_error("MPI_Comm_accept failed");
+        }
+        MPI_Comm merged;
+        MPI_Intercomm_merge(intercommunicator, 0, &merged);
+        MPI_Comm_free(&intercommunicator);
+        adopt(merged);
+
+        if (rank == 0) {
+            m_store->add(kJoinsAdmittedKey, 1);
+            --pending;
+        }
+        ++admitted;
+    }
+
+    if (admitted > 0) {
+        int after = 0;
+        MPI_Comm_size(m_communicator, &after);
+        ++m_generation;
+        BOOST_LOG_TRIVIAL(info) << "Admitted " << admitted << " group(s): world size "
+                                << before << " -> " << after;
+    }
+}
+
+bool ElasticCoordinator::failureDetected() const {
+#if DML_HAVE_ULFM
+    return g_failureDetected.load();
+#else
+    return false;
+#endif
+}
+
+void ElasticCoordinator::revoke(MPI_Comm communicator) const {
+#if DML_HAVE_ULFM
+    if (communicator != MPI_COMM_NULL) {
+        MPIX_Comm_revoke(communicator);
+    }
+#else
+    (void)communicator;
+#endif
+}
+
+void ElasticCoordinator::shrink() {
+#if DML_HAVE_ULFM
+    int before = 0;
+    MPI_Comm_size(m_communicator, &before);
+
+    MPIX_Comm_revoke(m_communicator);
+    MPI_Comm survivors;
+    if (MPIX_Comm_shrink(m_communicator, &survivors) != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to shrink the communicator after rank loss";
+        throw std::runtime_error("MPIX_Comm_shrink failed");
+    }
+    adopt(survivors);
+    g_failureDetected.store(false);
+
+    // The root may have been lost along with its port
+    publishPort();
+
+    int after = 0;
+    MPI_Comm_size(m_communicator, &after);
+    ++m_generation;
+    BOOST_LOG_TRIVIAL(warning) << "Lost " << before - after << " rank(s): world size "
+                               << before << " -> " << after;
+#else
+    BOOST_LOG_TRIVIAL(error) << "Rank loss needs an MPI library with ULFM";
+    throw std::runtime_error("Cannot survive rank loss without ULFM; relaunch to resume from the checkpoint");
+#endif
+}
+
+bool ElasticCoordinator::faultTolerant() {
+    return DML_HAVE_ULFM != 0;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,292 @@
+#include "../include/gradient_bucketer.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+GradientBucketer::GradientBucketer(const CommunicatorTopology& topology, std::size_t bucketElements,
+                                   std::size_t maxInFlight, CompressionMode compression, double topKRatio)
+    : m_topology(topology),
+      m_resultCommunicator(MPI_COMM_NULL),
+      m_window(MPI_WIN_NULL),
+      m_bucketElements(std::max<std::size_t>(1, bucketElements)),
+      m_buckets(std::max<std::size_t>(1, maxInFlight)),
+      m_current(0),
+      m_filling(false),
+      m_streamOffset(0),
+      m_bucketsLaunched(0) {
+
+    if (m_bucketElements > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        throw std::invalid_argument("Gradient bucket exceeds MPI count limit");
+    }
+
+    // Every rank shares its bucket slots with the node; the leader also
+    // holds one result slot per bucket. Allocated once, never reallocated.
+    const std::size_t slotElements = m_buckets.size() * m_bucketElements;
+    const MPI_Aint windowBytes = static_cast<MPI_Aint>(
+        (m_topology.isLeader() ? 2 : 1) * slotElements * sizeof(double));
+    double* base = nullptr;
+    int result = MPI_Win_allocate_shared(
+        windowBytes,
+        sizeof(double),
+        MPI_INFO_NULL,
+        m_topology.nodeCommunicator(),
+        &base,
+        &m_window
+    );
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to allocate shared gradient buckets";
+        throw std::runtime_error("MPI_Win_allocate_shared failed");
+    }
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, m_window);
+
+    // Result barriers get their own communicator: they interleave with the
+    // publish barriers differently on leaders and non-leaders
+    MPI_Comm_dup(m_topology.nodeCommunicator(), &m_resultCommunicator);
+
+    MPI_Aint segmentBytes = 0;
+    int displacementUnit = 0;
+    double* leaderBase = nullptr;
+    MPI_Win_shared_query(m_window, 0, &segmentBytes, &displacementUnit, &leaderBase);
+
+    for (std::size_t slot = 0; slot < m_buckets.size(); ++slot) {
+        m_buckets[slot].buffer = base + slot * m_bucketElements;
+        m_buckets[slot].result = leaderBase + slotElements + slot * m_bucketElements;
+    }
+
+    if (m_topology.isLeader()) {
+        m_nodeBuffers.resize(m_topology.localSize());
+        for (int localRank = 0; localRank < m_topology.localSize(); ++localRank) {
+            double* segment = nullptr;
+            MPI_Win_shared_query(m_window, localRank, &segmentBytes, &displacementUnit, &segment);
+            m_nodeBuffers[localRank] = segment;
+        }
+
+        m_compressor = std::make_unique<GradientCompressor>(
+            m_topology.leaderCommunicator(), compression, m_bucketElements, m_buckets.size(), topKRatio);
+    }
+}
+
+GradientBucketer::~GradientBucketer() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized) {
+        return;
+    }
+
+    // Outstanding requests still reference our buffers
+    for (auto& bucket : m_buckets) {
+        if (bucket.request != MPI_REQUEST_NULL) {
+            MPI_Wait(&bucket.request, MPI_STATUS_IGNORE);
+        }
+    }
+
+    m_compressor.reset();
+    MPI_Win_unlock_all(m_window);
+    MPI_Win_free(&m_window);
+    MPI_Comm_free(&m_resultCommunicator);
+}
+
+void GradientBucketer::beginStep(Eigen::Index gradientSize) {
+    if (gradientSize <= 0) {
+        throw std::invalid_argument("Gradient size must be positive");
+    }
+
+    m_result.setZero(gradientSize);
+    if (m_compressor) {
+        m_compressor->setGradientSize(gradientSize);
+    }
+    m_current = 0;
+    m_filling = false;
+    m_streamOffset = 0;
+    m_bucketsLaunched = 0;
+}
+
+void GradientBucketer::append(const Eigen::VectorXd& gradient) {
+    if (gradient.size() != m_result.size()) {
+        throw std::invalid_argument("Gradient size does not match current step");
+    }
+    write(gradient.data(), static_cast<std::size_t>(gradient.size()));
+}
+
+void GradientBucketer::appendZeros() {
+    write(nullptr, static_cast<std::size_t>(m_result.size()));
+}
+
+void GradientBucketer::write(const double* values, std::size_t count) {
+    std::size_t written = 0;
+    while (written < count) {
+        Bucket& bucket = m_buckets[m_current];
+        if (!m_filling) {
+            // Reusing a slot: its previous reduction must be folded first
+            retire(bucket);
+            bucket.size = 0;
+            bucket.streamOffset = m_streamOffset;
+            m_filling = true;
+        }
+
+        std::size_t chunk = std::min(count - written, m_bucketElements - bucket.size);
+        double* destination = bucket.buffer + bucket.size;
+        if (values) {
+            std::copy(values + written, values + written + chunk, destination);
+        } else {
+            std::fill(destination, destination + chunk, 0.0);
+        }
+
+        bucket.size += chunk;
+        written += chunk;
+        m_streamOffset += chunk;
+
+        if (bucket.size == m_bucketElements) {
+            launchCurrent();
+        }
+    }
+
+    progress();
+}
+
+void GradientBucketer::launchCurrent() {
+    Bucket& bucket = m_buckets[m_current];
+
+    if (m_topology.localSize() > 1) {
+        // Publish this rank's bucket; the leader sums the node once all have
+        MPI_Win_sync(m_window);
+        int result = MPI_Ibarrier(m_topology.nodeCommunicator(), &bucket.request);
+        if (result != MPI_SUCCESS) {
+            BOOST_LOG_TRIVIAL(error) << "Failed to publish gradient bucket to node";
+            throw std::runtime_error("MPI_Ibarrier failed");
+        }
+        bucket.stage = Stage::NodeReduce;
+    } else {
+        // Alone on the node: go straight to the inter-node reduction
+        m_compressor->start(
+            m_current,
+            bucket.buffer,
+            bucket.size,
+            bucket.streamOffset,
+            &bucket.request
+        );
+        bucket.stage = Stage::InterNode;
+    }
+
+    ++m_bucketsLaunched;
+    m_current = (m_current + 1) % m_buckets.size();
+    m_filling = false;
+}
+
+void GradientBucketer::progress() {
+    // A bucket only enters a stage after the bucket launched before it has,
+    // so every rank starts each communicator's collectives in the same order
+    std::size_t oldest = m_filling ? m_current + 1 : m_current;
+    Stage limit = Stage::Idle;
+
+    for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+        Bucket& bucket = m_buckets[(oldest + i) % m_buckets.size()];
+        while (bucket.stage < limit && advance(bucket, false)) {
+        }
+        limit = bucket.stage;
+    }
+}
+
+bool GradientBucketer::advance(Bucket& bucket, bool wait) {
+    if (bucket.stage == Stage::Idle) {
+        return false;
+    }
+
+    if (bucket.request != MPI_REQUEST_NULL) {
+        if (wait) {
+            MPI_Wait(&bucket.request, MPI_STATUS_IGNORE);
+        } else {
+            int completed = 0;
+            MPI_Test(&bucket.request, &completed, MPI_STATUS_IGNORE);
+            if (!completed) {
+                return false;
+            }
+        }
+    }
+
+    const std::size_t slot = slotIndex(bucket);
+    const bool sharedNode = m_topology.localSize() > 1;
+
+    switch (bucket.stage) {
+        case Stage::NodeReduce:
+            MPI_Win_sync(m_window);
+            if (m_compressor) {
+                // Sum the node's buckets into the leader's own slot
+                Eigen::Map<Eigen::VectorXd> sum(bucket.buffer, bucket.size);
+                for (std::size_t localRank = 1; localRank < m_nodeBuffers.size(); ++localRank) {
+                    sum += Eigen::Map<const Eigen::VectorXd>(
+                        m_nodeBuffers[localRank] + slot * m_bucketElements, bucket.size);
+                }
+                m_compressor->start(slot, bucket.buffer, bucket.size, bucket.streamOffset, &bucket.request);
+            }
+            bucket.stage = Stage::InterNode;
+            break;
+
+        case Stage::InterNode:
+            if (m_compressor) {
+                m_compressor->finish(slot, bucket.buffer, bucket.size);
+            }
+            if (!sharedNode) {
+                fold(bucket, bucket.buffer);
+                bucket.stage = Stage::Idle;
+                break;
+            }
+            if (m_compressor) {
+                std::copy(bucket.buffer, bucket.buffer + bucket.size, bucket.result);
+                MPI_Win_sync(m_window);
+            }
+            MPI_Ibarrier(m_resultCommunicator, &bucket.request);
+            bucket.stage = Stage::NodeBroadcast;
+            break;
+
+        case Stage::NodeBroadcast:
+            MPI_Win_sync(m_window);
+            fold(bucket, bucket.result);
+            bucket.stage = Stage::Idle;
+            break;
+
+        case Stage::Idle:
+            break;
+    }
+
+    return true;
+}
+
+void GradientBucketer::retire(Bucket& bucket) {
+    while (advance(bucket, true)) {
+    }
+}
+
+void GradientBucketer::fold(const Bucket& bucket, const double* values) {
+    // A bucket may straddle gradient boundaries; map stream positions back
+    // onto gradient indices one contiguous segment at a time
+    const std::size_t gradientSize = static_cast<std::size_t>(m_result.size());
+    std::size_t position = bucket.streamOffset % gradientSize;
+    std::size_t done = 0;
+
+    while (done < bucket.size) {
+        std::size_t chunk = std::min(bucket.size - done, gradientSize - position);
+        m_result.segment(position, chunk) +=
+            Eigen::Map<const Eigen::VectorXd>(values + done, chunk);
+        done += chunk;
+        position = 0;
+    }
+}
+
+const Eigen::VectorXd& GradientBucketer::finishStep() {
+    if (m_filling) {
+        launchCurrent();
+    }
+
+    // Oldest outstanding bucket sits right after the current slot
+    for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+        retire(m_buckets[(m_current + i) % m_buckets.size()]);
+    }
+
+    return m_result;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,418 @@
+#include "../include/gradient_compressor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+// Values per Int8 block sharing one scale
+constexpr size_t kQuantizedBlockSize = 256;
+
+// Largest finite IEEE half
+constexpr float kHalfMax = 65504.0f;
+
+struct QuantizedBlock {
+    float scale;
+    int8_t values[kQuantizedBlockSize];
+};
+
+// One selected element of a top-k bucket
+struct SparseEntry {
+    uint32_t index;
+    float value;
+};
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xffu) {
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f) {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+
+    if (halfExponent <= 0) {
+        // Subnormal half: shift the full significand, rounding to nearest even
+        if (halfExponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Rounding may carry into the exponent, which is the correct result
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    uint32_t bits = exponent == 0x1f
+        ? sign | 0x7f800000u | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint16_t floatToBfloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return static_cast<uint16_t>((bits >> 16) | 0x40u);
+    }
+    uint32_t rounding = 0x7fffu + ((bits >> 16) & 1u);
+    return static_cast<uint16_t>((bits + rounding) >> 16);
+}
+
+float bfloatToFloat(uint16_t bfloat) {
+    uint32_t bits = static_cast<uint32_t>(bfloat) << 16;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void quantizeBlock(const double* values, size_t count, QuantizedBlock& block) {
+    double maxMagnitude = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        maxMagnitude = std::max(maxMagnitude, std::abs(values[i]));
+    }
+
+    block.scale = static_cast<float>(maxMagnitude / 127.0);
+    double inverse = maxMagnitude > 0.0 ? 127.0 / maxMagnitude : 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        block.values[i] = static_cast<int8_t>(std::lround(values[i] * inverse));
+    }
+    std::fill(block.values + count, block.values + kQuantizedBlockSize, 0);
+}
+
+// MPI reduction operators: decode both operands, add in float, re-encode.
+// Each Int8 combine rounds the partial sum to its block's new scale, adding
+// up to half a step (max |partial sum| / 254) per value. A reduction
+// combines at most worldSize - 1 times, which bounds the error at
+// (worldSize - 1) / 254 of the largest partial sum in the block. Error
+// feedback cannot recover it, because no single rank sees it.
+void sumHalf(void* in, void* inout, int* length, MPI_Datatype*) {
+    auto* a = static_cast<const uint16_t*>(in);
+    auto* b = static_cast<uint16_t*>(inout);
+    for (int i = 0; i < *length; ++i) {
+        b[i] = floatToHalf(halfToFloat(a[i]) + halfToFloat(b[i]));
+    }
+}
+
+void sumBfloat(void* in, void* inout, int* length, MPI_Datatype*) {
+    auto* a = static_cast<const uint16_t*>(in);
+    auto* b = static_cast<uint16_t*>(inout);
+    for (int i = 0; i < *length; ++i) {
+        b[i] = floatToBfloat(bfloatToFloat(a[i]) + bfloatToFloat(b[i]));
+    }
+}
+
+void sumQuantized(void* in, void* inout, int* length, MPI_Datatype*) {
+    auto* a = static_cast<const QuantizedBlock*>(in);
+    auto* b = static_cast<QuantizedBlock*>(inout);
+    double sum[kQuantizedBlockSize];
+    for (int block = 0; block < *length; ++block) {
+        for (size_t i = 0; i < kQuantizedBlockSize; ++i) {
+            sum[i] = static_cast<double>(a[block].scale) * a[block].values[i] +
+                     static_cast<double>(b[block].scale) * b[block].values[i];
+        }
+        quantizeBlock(sum, kQuantizedBlockSize, b[block]);
+    }
+}
+
+} // namespace
+
+CompressionMode parseCompressionMode(const std::string& name) {
+    if (name == "none") return CompressionMode::None;
+    if (name == "fp16") return CompressionMode::FP16;
+    if (name == "bf16") return CompressionMode::BF16;
+    if (name == "topk") return CompressionMode::TopK;
+    if (name == "int8") return CompressionMode::Int8;
+    throw std::invalid_argument("Unknown compression mode: " + name);
+}
+
+const char* compressionModeName(CompressionMode mode) {
+    switch (mode) {
+        case CompressionMode::FP16: return "fp16";
+        case CompressionMode::BF16: return "bf16";
+        case CompressionMode::TopK: return "topk";
+        case CompressionMode::Int8: return "int8";
+        case CompressionMode::None: break;
+    }
+    return "none";
+}
+
+GradientCompressor::GradientCompressor(MPI_Comm communicator, CompressionMode mode, size_t bucketElements,
+                                       size_t slots, double topKRatio)
+    : m_communicator(communicator),
+      m_mode(mode),
+      m_topKRatio(std::min(1.0, std::max(topKRatio, 1e-6))),
+      m_worldSize(1),
+      m_slots(slots),
+      m_wireType(MPI_DATATYPE_NULL),
+      m_sumOp(MPI_OP_NULL),
+      m_wireBytes(0),
+      m_rawBytes(0) {
+
+    MPI_Comm_size(m_communicator, &m_worldSize);
+
+    // Custom element types and reductions for the packed formats
+    switch (m_mode) {
+        case CompressionMode::FP16:
+        case CompressionMode::BF16:
+            MPI_Type_contiguous(sizeof(uint16_t), MPI_BYTE, &m_wireType);
+            MPI_Op_create(m_mode == CompressionMode::FP16 ? sumHalf : sumBfloat, 1, &m_sumOp);
+            break;
+        case CompressionMode::Int8:
+            MPI_Type_contiguous(sizeof(QuantizedBlock), MPI_BYTE, &m_wireType);
+            MPI_Op_create(sumQuantized, 1, &m_sumOp);
+            break;
+        default:
+            break;
+    }
+    if (m_wireType != MPI_DATATYPE_NULL) {
+        MPI_Type_commit(&m_wireType);
+    }
+
+    // Wire buffers are sized for a full bucket once, up front
+    size_t blocks = (bucketElements + kQuantizedBlockSize - 1) / kQuantizedBlockSize;
+    for (auto& slot : m_slots) {
+        switch (m_mode) {
+            case CompressionMode::FP16:
+            case CompressionMode::BF16:
+                slot.send.resize(bucketElements * sizeof(uint16_t));
+                break;
+            case CompressionMode::Int8:
+                slot.send.resize(blocks * sizeof(QuantizedBlock));
+                break;
+            case CompressionMode::TopK:
+                slot.send.resize(topKCount(bucketElements) * sizeof(SparseEntry));
+                slot.receive.resize(slot.send.size() * m_worldSize);
+                break;
+            case CompressionMode::None:
+                break;
+        }
+    }
+    if (m_mode == CompressionMode::TopK) {
+        m_indexScratch.resize(bucketElements);
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Gradient compression: " << compressionModeName(m_mode);
+}
+
+GradientCompressor::~GradientCompressor() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized) {
+        return;
+    }
+    if (m_sumOp != MPI_OP_NULL) {
+        MPI_Op_free(&m_sumOp);
+    }
+    if (m_wireType != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&m_wireType);
+    }
+}
+
+void GradientCompressor::setGradientSize(Eigen::Index gradientSize) {
+    if (m_mode != CompressionMode::None && m_residual.size() != gradientSize) {
+        m_residual = Eigen::VectorXd::Zero(gradientSize);
+    }
+}
+
+size_t GradientCompressor::topKCount(size_t count) const {
+    return std::max<size_t>(1, static_cast<size_t>(std::ceil(m_topKRatio * count)));
+}
+
+void GradientCompressor::applyResidual(double* values, size_t count, size_t gradientOffset) {
+    const size_t gradientSize = static_cast<size_t>(m_residual.size());
+    size_t index = gradientOffset % gradientSize;
+    for (size_t i = 0; i < count; ++i) {
+        values[i] += m_residual[index];
+        m_residual[index] = 0.0;
+        if (++index == gradientSize) {
+            index = 0;
+        }
+    }
+}
+
+void GradientCompressor::storeResidual(const double* errors, size_t count, size_t gradientOffset) {
+    const size_t gradientSize = static_cast<size_t>(m_residual.size());
+    size_t index = gradientOffset % gradientSize;
+    for (size_t i = 0; i < count; ++i) {
+        m_residual[index] += errors[i];
+        if (++index == gradientSize) {
+            index = 0;
+        }
+    }
+}
+
+void GradientCompressor::start(size_t slot, double* values, size_t count, size_t gradientOffset, MPI_Request* request) {
+    Slot& buffers = m_slots[slot];
+    m_rawBytes += count * sizeof(double);
+    int result = MPI_SUCCESS;
+
+    if (m_mode != CompressionMode::None) {
+        applyResidual(values, count, gradientOffset);
+    }
+
+    // Each case encodes the bucket and leaves the untransmitted error in values
+    switch (m_mode) {
+        case CompressionMode::None: {
+            m_wireBytes += count * sizeof(double);
+            result = MPI_Iallreduce(MPI_IN_PLACE, values, static_cast<int>(count),
+                                    MPI_DOUBLE, MPI_SUM, m_communicator, request);
+            break;
+        }
+        case CompressionMode::FP16:
+        case CompressionMode::BF16: {
+            auto* wire = reinterpret_cast<uint16_t*>(buffers.send.data());
+            if (m_mode == CompressionMode::FP16) {
+                // Send each rank's share of the sum, saturated so that no
+                // partial sum of shares can overflow the half range. What
+                // saturation cuts off stays in the residual.
+                const double share = 1.0 / m_worldSize;
+                const float limit = kHalfMax / static_cast<float>(m_worldSize);
+                for (size_t i = 0; i < count; ++i) {
+                    float value = std::clamp(static_cast<float>(values[i] * share), -limit, limit);
+                    wire[i] = floatToHalf(value);
+                    if (std::abs(halfToFloat(wire[i])) > limit) {
+                        // Rounded past the limit; step the magnitude down one unit
+                        --wire[i];
+                    }
+                    values[i] -= static_cast<double>(halfToFloat(wire[i])) * m_worldSize;
+                }
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    wire[i] = floatToBfloat(static_cast<float>(values[i]));
+                    values[i] -= bfloatToFloat(wire[i]);
+                }
+            }
+            m_wireBytes += count * sizeof(uint16_t);
+            result = MPI_Iallreduce(MPI_IN_PLACE, wire, static_cast<int>(count),
+                                    m_wireType, m_sumOp, m_communicator, request);
+            break;
+        }
+        case CompressionMode::Int8: {
+            auto* blocks = reinterpret_cast<QuantizedBlock*>(buffers.send.data());
+            size_t blockCount = (count + kQuantizedBlockSize - 1) / kQuantizedBlockSize;
+            for (size_t block = 0; block < blockCount; ++block) {
+                size_t begin = block * kQuantizedBlockSize;
+                size_t length = std::min(kQuantizedBlockSize, count - begin);
+                quantizeBlock(values + begin, length, blocks[block]);
+                for (size_t i = 0; i < length; ++i) {
+                    values[begin + i] -= static_cast<double>(blocks[block].scale) * blocks[block].values[i];
+                }
+            }
+            m_wireBytes += blockCount * sizeof(QuantizedBlock);
+            result = MPI_Iallreduce(MPI_IN_PLACE, blocks, static_cast<int>(blockCount),
+                                    m_wireType, m_sumOp, m_communicator, request);
+            break;
+        }
+        case CompressionMode::TopK: {
+            size_t k = topKCount(count);
+            for (size_t i = 0; i < count; ++i) {
+                m_indexScratch[i] = static_cast<uint32_t>(i);
+            }
+            std::nth_element(
+                m_indexScratch.begin(), m_indexScratch.begin() + (k - 1), m_indexScratch.begin() + count,
+                [values](uint32_t a, uint32_t b) { return std::abs(values[a]) > std::abs(values[b]); });
+
+            auto* entries = reinterpret_cast<SparseEntry*>(buffers.send.data());
+            for (size_t i = 0; i < k; ++i) {
+                uint32_t index = m_indexScratch[i];
+                entries[i] = {index, static_cast<float>(values[index])};
+                values[index] -= entries[i].value;
+            }
+
+            int bytes = static_cast<int>(k * sizeof(SparseEntry));
+            m_wireBytes += bytes;
+            result = MPI_Iallgather(entries, bytes, MPI_BYTE, buffers.receive.data(), bytes,
+                                    MPI_BYTE, m_communicator, request);
+            break;
+        }
+    }
+
+    if (m_mode != CompressionMode::None) {
+        storeResidual(values, count, gradientOffset);
+    }
+
+    if (result != MPI_SUCCESS) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to start compressed gradient reduction";
+        throw std::runtime_error("Gradient reduction failed to start");
+    }
+}
+
+void GradientCompressor::finish(size_t slot, double* values, size_t count) {
+    Slot& buffers = m_slots[slot];
+
+    switch (m_mode) {
+        case CompressionMode::None:
+            break;
+        case CompressionMode::FP16: {
+            auto* wire = reinterpret_cast<const uint16_t*>(buffers.send.data());
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = static_cast<double>(halfToFloat(wire[i])) * m_worldSize;
+            }
+            break;
+        }
+        case CompressionMode::BF16: {
+            auto* wire = reinterpret_cast<const uint16_t*>(buffers.send.data());
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = bfloatToFloat(wire[i]);
+            }
+            break;
+        }
+        case CompressionMode::Int8: {
+            auto* blocks = reinterpret_cast<const QuantizedBlock*>(buffers.send.data());
+            for (size_t i = 0; i < count; ++i) {
+                const QuantizedBlock& block = blocks[i / kQuantizedBlockSize];
+                values[i] = static_cast<double>(block.scale) * block.values[i % kQuantizedBlockSize];
+            }
+            break;
+        }
+        case CompressionMode::TopK: {
+            size_t entriesPerRank = topKCount(count);
+            auto* entries = reinterpret_cast<const SparseEntry*>(buffers.receive.data());
+            std::fill(values, values + count, 0.0);
+            for (size_t i = 0; i < entriesPerRank * static_cast<size_t>(m_worldSize); ++i) {
+                values[entries[i].index] += entries[i].value;
+            }
+            break;
+        }
+    }
+}
+
+} // namespace DistributedML
@@ -0,0 +1,216 @@
+#include "../include/inference_service.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+// A failing callback must not take the batch worker down with it
+template <typename Callback>
+void deliver(const Callback& done, const InferenceService::Prediction* prediction, std::exception_ptr error) {
+    try {
+        done(prediction, error);
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(warning) << "Prediction callback failed: " << e.what();
+    }
+}
+
+} // namespace
+
+InferenceService::InferenceService(const Options& options, MetricsRegistry& metrics)
+    : m_options(options),
+      m_requests(metrics.counter("dml_inference_requests_total", "Prediction requests answered")),
+      m_rejected(metrics.counter("dml_inference_rejected_total",
+          "Prediction requests refused because the queue was full")),
+      m_latencySeconds(metrics.histogram("dml_inference_latency_seconds",
+          "Time from a prediction request's arrival to its answer",
+          Histogram::exponentialBounds(1e-5, 2.0, 18))),
+      m_batchFill(metrics.histogram("dml_inference_batch_fill",
+          "Requests per inference batch as a fraction of the maximum batch size",
+          {0.125, 0.25, 0.375, 0.5, 0.625, 0.75, 0.875, 1.0})) {
+
+    if (m_options.maxBatch <= 0 || m_options.workers <= 0 || m_options.maxQueue == 0) {
+        throw std::invalid_argument("Inference needs a positive batch size, worker count and queue size");
+    }
+
+    for (int i = 0; i < m_options.workers; ++i) {
+        m_workers.emplace_back(&InferenceService::workerLoop, this);
+    }
+}
+
+InferenceService::~InferenceService() {
+    stop();
+}
+
+void InferenceService::stop() {
+    std::deque<Request> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        abandoned.swap(m_queue);
+    }
+    m_work.notify_all();
+    m_fill.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    auto error = std::make_exception_ptr(std::runtime_error("Inference service stopped"));
+    for (auto& request : abandoned) {
+        deliver(request.done, nullptr, error);
+    }
+}
+
+void InferenceService::setModel(const MlpModel& model) {
+    auto copy = std::make_shared<const MlpModel>(model);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_model = std::move(copy);
+}
+
+bool InferenceService::ready() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_model != nullptr;
+}
+
+Eigen::Index InferenceService::inputSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_model ? m_model->inputSize() : 0;
+}
+
+bool InferenceService::submit(std::vector<float> features, Callback done) {
+    bool first = false;
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_model) {
+            throw std::invalid_argument("No model is being served yet");
+        }
+        if (static_cast<Eigen::Index>(features.size()) != m_model->inputSize()) {
+            throw std::invalid_argument("Expected " + std::to_string(m_model->inputSize()) + " features, got " +
+                                        std::to_string(features.size()));
+        }
+        if (m_stop || m_queue.size() >= m_options.maxQueue) {
+            m_rejected.inc();
+            return false;
+        }
+
+        m_queue.push_back({std::move(features), std::move(done), Clock::now()});
+        first = m_queue.size() == 1;
+        full = static_cast<Eigen::Index>(m_queue.size()) >= m_options.maxBatch;
+    }
+
+    // Wake a worker to start collecting, or the collector once it can run
+    if (first) {
+        m_work.notify_one();
+    }
+    if (full) {
+        m_fill.notify_one();
+    }
+    return true;
+}
+
+void InferenceService::workerLoop() {
+    const size_t maxBatch = static_cast<size_t>(m_options.maxBatch);
+    std::vector<Request> batch;
+    batch.reserve(maxBatch);
+
+    // Scratch sized for the model the worker last ran
+    std::shared_ptr<const MlpModel> workspaceModel;
+    BatchTensor staging;
+    MlpModel::Workspace workspace;
+
+    while (true) {
+        std::shared_ptr<const MlpModel> model;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work.wait(lock, [this]() { return m_stop || (!m_collecting && !m_queue.empty()); });
+            if (m_stop) {
+                return;
+            }
+
+            // Hold the batch open until it fills or its oldest request has
+            // waited long enough
+            m_collecting = true;
+            const Clock::time_point deadline = m_queue.front().arrival + m_options.maxWait;
+            m_fill.wait_until(lock, deadline, [this, maxBatch]() {
+                return m_stop || m_queue.size() >= maxBatch;
+            });
+            m_collecting = false;
+            if (m_stop) {
+                return;
+            }
+
+            const size_t count = std::min(maxBatch, m_queue.size());
+            std::move(m_queue.begin(), m_queue.begin() + static_cast<std::ptrdiff_t>(count),
+                      std::back_inserter(batch));
+            m_queue.erase(m_queue.begin(), m_queue.begin() + static_cast<std::ptrdiff_t>(count));
+            model = m_model;
+
+            // Requests left over start the next batch on another worker
+            if (!m_queue.empty()) {
+                m_work.notify_one();
+            }
+        }
+
+        if (model != workspaceModel) {
+            // Workspaces are tied to a kernel, which copies of a model share
+            if (!workspaceModel || &workspaceModel->kernel() != &model->kernel()) {
+                staging.resize(m_options.maxBatch, model->inputSize());
+                workspace = model->createWorkspace(m_options.maxBatch);
+            }
+            workspaceModel = model;
+        }
+        runBatch(batch, *model, staging, workspace);
+        batch.clear();
+    }
+}
+
+void InferenceService::runBatch(std::vector<Request>& batch, const MlpModel& model, BatchTensor& staging,
+                                MlpModel::Workspace& workspace) {
+    const Eigen::Index count = static_cast<Eigen::Index>(batch.size());
+    const Eigen::Index classes = model.outputSize();
+
+    try {
+        // Requests may have been queued for a model with another input size
+        for (Eigen::Index i = 0; i < count; ++i) {
+            const auto& features = batch[static_cast<size_t>(i)].features;
+            if (static_cast<Eigen::Index>(features.size()) != model.inputSize()) {
+                throw std::invalid_argument("Model input size changed while the request was queued");
+            }
+            std::memcpy(staging.sample(i), features.data(), features.size() * sizeof(float));
+        }
+        model.predict(staging.view().slice(0, count), workspace);
+    } catch (...) {
+        BOOST_LOG_TRIVIAL(warning) << "Inference batch of " << count << " requests failed";
+        auto error = std::current_exception();
+        for (auto& request : batch) {
+            deliver(request.done, nullptr, error);
+        }
+        return;
+    }
+
+    m_batchFill.observe(static_cast<double>(count) / static_cast<double>(m_options.maxBatch));
+    Prediction prediction;
+    prediction.probabilities.resize(static_cast<size_t>(classes));
+    for (Eigen::Index i = 0; i < count; ++i) {
+        Eigen::Index label = 0;
+        workspace.output.row(i).maxCoeff(&label);
+        prediction.label = static_cast<int32_t>(label);
+        Eigen::Map<Eigen::RowVectorXd>(prediction.probabilities.data(), classes) = workspace.output.row(i);
+
+        Request& request = batch[static_cast<size_t>(i)];
+        deliver(request.done, &prediction, nullptr);
+        m_requests.inc();
+        m_latencySeconds.observe(std::chrono::duration<double>(Clock::now() - request.arrival).count());
+    }
+}
+
+} // namespace DistributedML
@@ -0,0 +1,277 @@
+#include "../include/input_pipeline.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Yields before a waiting stage falls back to sleeping
+constexpr int kSpinsBeforeSleep = 64;
+constexpr std::chrono::microseconds kWaitSleep(50);
+
+uint64_t nanosSince(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+// Seed material that depends only on the arguments, not on the thread
+std::seed_seq seedOf(uint64_t seed, int rank, int epoch, int batch) {
+    return std::seed_seq{
+        static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32),
+        static_cast<uint32_t>(rank), static_cast<uint32_t>(epoch), static_cast<uint32_t>(batch)
+    };
+}
+
+} // namespace
+
+InputPipeline::InputPipeline(const BatchView& source, const int32_t* labels, int firstEpoch, int lastEpoch,
+                             int batchesPerEpoch, const Options& options)
+    : m_source(source),
+      m_labels(labels),
+      m_firstEpoch(firstEpoch),
+      m_batchesPerEpoch(std::max(0, batchesPerEpoch)),
+      m_totalBatches(source.empty() || lastEpoch <= firstEpoch
+          ? 0
+          : static_cast<uint64_t>(lastEpoch - firstEpoch) * static_cast<uint64_t>(std::max(0, batchesPerEpoch))),
+      m_options(options),
+      m_augmenting(options.augmentation.enabled()) {
+
+    if (m_options.batchSize <= 0 || m_options.prefetchDepth <= 0) {
+        throw std::invalid_argument("Input pipeline needs a positive batch size and prefetch depth");
+    }
+    const AugmentationOptions& augmentation = m_options.augmentation;
+    if (augmentation.normalizeStd == 0.0f) {
+        throw std::invalid_argument("Normalization standard deviation must be non-zero");
+    }
+    if ((augmentation.flipProbability > 0.0 || augmentation.maxShift > 0) &&
+        static_cast<Eigen::Index>(m_options.rows) * m_options.cols * m_options.channels != m_source.features) {
+        BOOST_LOG_TRIVIAL(error) << "Image shape " << m_options.rows << "x" << m_options.cols << "x"
+                                 << m_options.channels << " does not match " << m_source.features << " features";
+        throw std::invalid_argument("Flips and shifts need the sample image shape");
+    }
+
+    m_slots.reserve(static_cast<size_t>(m_options.prefetchDepth));
+    for (int i = 0; i < m_options.prefetchDepth; ++i) {
+        auto slot = std::make_unique<Slot>();
+        slot->tensor.resize(m_options.batchSize, m_source.features);
+        slot->labels.resize(static_cast<size_t>(m_options.batchSize));
+        slot->stamp.store(stampOf(static_cast<uint64_t>(i), Free), std::memory_order_relaxed);
+        m_slots.push_back(std::move(slot));
+    }
+
+    // Without augmentation the reader hands slots straight to the ring
+    m_reader = std::thread(&InputPipeline::readLoop, this);
+    if (m_augmenting) {
+        for (int i = 0; i < std::max(1, m_options.workers); ++i) {
+            m_augmenters.emplace_back(&InputPipeline::augmentLoop, this);
+        }
+    }
+}
+
+InputPipeline::~InputPipeline() {
+    stop();
+}
+
+void InputPipeline::stop() {
+    m_stop.store(true);
+    if (m_reader.joinable()) {
+        m_reader.join();
+    }
+    for (auto& augmenter : m_augmenters) {
+        if (augmenter.joinable()) {
+            augmenter.join();
+        }
+    }
+}
+
+bool InputPipeline::waitFor(const Slot& slot, uint64_t stamp) const {
+    for (int spin = 0; slot.stamp.load(std::memory_order_acquire) != stamp; ++spin) {
+        if (m_stop.load(std::memory_order_relaxed) || m_failed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (spin < kSpinsBeforeSleep) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(kWaitSleep);
+        }
+    }
+    return true;
+}
+
+void InputPipeline::fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    if (!m_error) {
+        m_error = error;
+    }
+    m_failed.store(true);
+}
+
+void InputPipeline::readLoop() {
+    try {
+        const Eigen::Index samples = m_source.samples;
+        const Eigen::Index batchSize = m_options.batchSize;
+        const Eigen::Index localBatches = (samples + batchSize - 1) / batchSize;
+        const size_t rowBytes = static_cast<size_t>(m_source.features) * sizeof(float);
+        const Stage handOff = m_augmenting ? Read : Ready;
+        std::vector<Eigen::Index> order(static_cast<size_t>(samples));
+
+        for (uint64_t sequence = 0; sequence < m_totalBatches; ++sequence) {
+            const int epoch = m_firstEpoch + static_cast<int>(sequence / m_batchesPerEpoch);
+            const int batch = static_cast<int>(sequence % m_batchesPerEpoch);
+
+            // Fisher-Yates with raw engine output, so the order is the same
+            // on every standard library
+            if (batch == 0) {
+                std::iota(order.begin(), order.end(), Eigen::Index(0));
+                if (m_options.shuffle) {
+                    std::seed_seq seed = seedOf(m_options.seed, m_options.rank, epoch, -1);
+                    std::mt19937_64 engine(seed);
+                    for (size_t i = order.size(); i > 1; --i) {
+                        std::swap(order[i - 1], order[engine() % i]);
+                    }
+                }
+            }
+
+            Slot& slot = *m_slots[sequence % m_slots.size()];
+            const uint64_t free = stampOf(sequence, Free);
+            if (slot.stamp.load(std::memory_order_acquire) != free) {
+                auto waitStart = Clock::now();
+                if (!waitFor(slot, free)) {
+                    return;
+                }
+                m_readerBlockedNanos.fetch_add(nanosSince(waitStart), std::memory_order_relaxed);
+            }
+
+            // Batches past the end of the source wrap around to its start
+            const Eigen::Index begin = (batch % localBatches) * batchSize;
+            const Eigen::Index end = std::min(begin + batchSize, samples);
+            for (Eigen::Index i = begin; i < end; ++i) {
+                const Eigen::Index index = order[static_cast<size_t>(i)];
+                std::memcpy(slot.tensor.sample(i - begin), m_source.sample(index), rowBytes);
+                slot.labels[static_cast<size_t>(i - begin)] = m_labels[index];
+            }
+            slot.samples = end - begin;
+            slot.stamp.store(stampOf(sequence, handOff), std::memory_order_release);
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+}
+
+void InputPipeline::augmentLoop() {
+    while (true) {
+        const uint64_t sequence = m_nextAugment.fetch_add(1, std::memory_order_relaxed);
+        if (sequence >= m_totalBatches) {
+            return;
+        }
+        Slot& slot = *m_slots[sequence % m_slots.size()];
+        if (!waitFor(slot, stampOf(sequence, Read))) {
+            return;
+        }
+        try {
+            augment(slot, sequence);
+        } catch (...) {
+            fail(std::current_exception());
+            return;
+        }
+        slot.stamp.store(stampOf(sequence, Ready), std::memory_order_release);
+    }
+}
+
+void InputPipeline::augment(Slot& slot, uint64_t sequence) {
+    const AugmentationOptions& augmentation = m_options.augmentation;
+    const int epoch = m_firstEpoch + static_cast<int>(sequence / m_batchesPerEpoch);
+    const int batch = static_cast<int>(sequence % m_batchesPerEpoch);
+    std::seed_seq seed = seedOf(m_options.seed, m_options.rank, epoch, batch);
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::uniform_int_distribution<int> shift(-augmentation.maxShift, augmentation.maxShift);
+
+    const bool flip = augmentation.flipProbability > 0.0;
+    const bool translate = augmentation.maxShift > 0;
+    const bool normalize = augmentation.normalizeMean != 0.0f || augmentation.normalizeStd != 1.0f;
+    const float scale = 1.0f / augmentation.normalizeStd;
+    cv::Mat scratch;
+
+    for (Eigen::Index i = 0; i < slot.samples; ++i) {
+        float* row = slot.tensor.sample(i);
+
+        // OpenCV works on the row in place through a header over it
+        if (flip || translate) {
+            cv::Mat image(m_options.rows, m_options.cols, CV_32FC(m_options.channels), row);
+            if (flip && coin(engine) < augmentation.flipProbability) {
+                cv::flip(image, scratch, 1);
+                scratch.copyTo(image);
+            }
+            if (translate) {
+                int dx = shift(engine);
+                int dy = shift(engine);
+                if (dx != 0 || dy != 0) {
+                    cv::Matx23d transform(1.0, 0.0, dx, 0.0, 1.0, dy);
+                    cv::warpAffine(image, scratch, transform, image.size(), cv::INTER_NEAREST,
+                                   cv::BORDER_CONSTANT, cv::Scalar::all(0.0));
+                    scratch.copyTo(image);
+                }
+            }
+        }
+
+        if (normalize) {
+            Eigen::Map<Eigen::ArrayXf> values(row, m_source.features);
+            values = (values - augmentation.normalizeMean) * scale;
+        }
+    }
+}
+
+InputBatch InputPipeline::next() {
+    // The previous batch's slot goes back to the reader
+    if (m_holdingSlot) {
+        const uint64_t previous = m_nextConsume - 1;
+        m_slots[previous % m_slots.size()]->stamp.store(
+            stampOf(previous + m_slots.size(), Free), std::memory_order_release);
+        m_holdingSlot = false;
+    }
+    if (m_nextConsume >= m_totalBatches) {
+        throw std::out_of_range("Input pipeline has no more batches");
+    }
+
+    Slot& slot = *m_slots[m_nextConsume % m_slots.size()];
+    const uint64_t ready = stampOf(m_nextConsume, Ready);
+    uint64_t waitNanos = 0;
+    if (slot.stamp.load(std::memory_order_acquire) != ready) {
+        auto waitStart = Clock::now();
+        if (!waitFor(slot, ready)) {
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            if (m_error) {
+                std::rethrow_exception(m_error);
+            }
+            throw std::logic_error("Input pipeline is stopped");
+        }
+        waitNanos = nanosSince(waitStart);
+        m_starvedBatches.fetch_add(1, std::memory_order_relaxed);
+        m_starvedNanos.fetch_add(waitNanos, std::memory_order_relaxed);
+    }
+
+    ++m_nextConsume;
+    m_holdingSlot = true;
+    return {slot.tensor.view().slice(0, slot.samples), slot.labels.data(), waitNanos};
+}
+
+InputPipeline::Stats InputPipeline::stats() const {
+    Stats stats;
+    stats.batches = m_nextConsume;
+    stats.starvedBatches = m_starvedBatches.load(std::memory_order_relaxed);
+    stats.starvedSeconds = m_starvedNanos.load(std::memory_order_relaxed) * 1e-9;
+    stats.readerBlockedSeconds = m_readerBlockedNanos.load(std::memory_order_relaxed) * 1e-9;
+    return stats;
+}
+
+} // namespace DistributedML
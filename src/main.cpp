@@ -1,77 +1,247 @@
 #include "../include/distributed_trainer.h"
 #include "../include/dashboard_server.h"
+#include "../include/task_executor.h"
+#include "../include/inference_service.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <string>
 #include <thread>
 #include <stdexcept>
 #include <iostream>
 
-// Function to generate sample training data
-std::vector<cv::Mat> generateTrainingData(int numSamples) {
+// Function to generate sample training data. Each class brightens its own
+// band of rows so that the labels are learnable.
+std::vector<cv::Mat> generateTrainingData(int numSamples, std::vector<int32_t>& labels) {
+    constexpr int numClasses = 10;
     std::vector<cv::Mat> trainingData;
+    labels.clear();
     
     // Generate random images for training
     for (int i = 0; i < numSamples; ++i) {
         cv::Mat sample = cv::Mat::zeros(28, 28, CV_32F);
         cv::randu(sample, 0, 1);
+
+        int label = i % numClasses;
+        sample.rowRange(label * 2, label * 2 + 3) += 1.0;
+
         trainingData.push_back(sample);
+        labels.push_back(label);
     }
     
     return trainingData;
 }
 
+// Set by SIGINT/SIGTERM to end serving after training
+std::atomic<bool> stopServing(false);
+
+void requestStop(int) {
+    stopServing.store(true);
+}
+
 int main(int argc, char** argv) {
     try {
         // Initialize distributed trainer
         DistributedML::DistributedTrainer trainer(argc, argv);
 
-        // Prepare sample training data
-        std::vector<cv::Mat> trainingData = generateTrainingData(1000);
+        // Use a prebuilt shard when given, otherwise synthesize data
+        std::string shardPath;
+        std::string dashboardAddress = "http://localhost:8080";
+        std::string rendezvousDirectory;
+        std::string resultsPath;
+        DistributedML::InferenceService::Options servingOptions;
+        bool serve = false;
+        DistributedML::DistributedTrainer::TrainingConfig config = trainer.getConfig();
+        for (int i = 1; i + 1 < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--shard") {
+                shardPath = argv[i + 1];
+            } else if (option == "--compression") {
+                config.gradientCompression = DistributedML::parseCompressionMode(argv[i + 1]);
+            } else if (option == "--topk-ratio") {
+                config.topKRatio = std::stod(argv[i + 1]);
+            } else if (option == "--mode") {
+                config.executionMode = std::string(argv[i + 1]) == "local-sgd"
+                    ? DistributedML::ExecutionMode::LocalSGD
+                    : DistributedML::ExecutionMode::Synchronous;
+            } else if (option == "--average-every") {
+                config.averagingInterval = std::stoi(argv[i + 1]);
+            } else if (option == "--staleness") {
+                config.maxStaleness = std::stoi(argv[i + 1]);
+            } else if (option == "--checkpoint") {
+                config.checkpointPath = argv[i + 1];
+            } else if (option == "--checkpoint-every") {
+                config.checkpointInterval = std::stoi(argv[i + 1]);
+            } else if (option == "--trace") {
+                config.traceFile = argv[i + 1];
+            } else if (option == "--dashboard") {
+                dashboardAddress = argv[i + 1];
+            } else if (option == "--elastic") {
+                rendezvousDirectory = argv[i + 1];
+            } else if (option == "--precision") {
+                config.precision = DistributedML::parseKernelPrecision(argv[i + 1]);
+            } else if (option == "--optimizer") {
+                config.optimizer.kind = DistributedML::parseOptimizerKind(argv[i + 1]);
+            } else if (option == "--learning-rate") {
+                config.learningRate = std::stod(argv[i + 1]);
+            } else if (option == "--momentum") {
+                config.optimizer.momentum = std::stod(argv[i + 1]);
+            } else if (option == "--weight-decay") {
+                config.optimizer.weightDecay = std::stod(argv[i + 1]);
+            } else if (option == "--accumulate") {
+                config.accumulationSteps = std::stoi(argv[i + 1]);
+            } else if (option == "--prefetch") {
+                config.prefetchBatches = std::stoi(argv[i + 1]);
+            } else if (option == "--input-workers") {
+                config.inputWorkers = std::stoi(argv[i + 1]);
+            } else if (option == "--shuffle-seed") {
+                config.shuffleSeed = std::stoull(argv[i + 1]);
+            } else if (option == "--flip-probability") {
+                config.augmentation.flipProbability = std::stod(argv[i + 1]);
+            } else if (option == "--max-shift") {
+                config.augmentation.maxShift = std::stoi(argv[i + 1]);
+            } else if (option == "--rebalance") {
+                config.rebalanceThreshold = std::stod(argv[i + 1]);
+            } else if (option == "--results") {
+                resultsPath = argv[i + 1];
+            } else if (option == "--serve-batch") {
+                serve = true;
+                servingOptions.maxBatch = std::stoi(argv[i + 1]);
+            } else if (option == "--serve-wait-us") {
+                servingOptions.maxWait = std::chrono::microseconds(std::stoll(argv[i + 1]));
+            }
+        }
+        trainer.validateAndSetConfig(config);
 
-        // Distribute data across nodes
-        trainer.distributeData(trainingData);
+        // Found or join an elastic job before the data is split by rank
+        if (!rendezvousDirectory.empty()) {
+            trainer.enableElastic(std::make_unique<DistributedML::FileRendezvousStore>(rendezvousDirectory));
+        }
 
-        // Start training in a separate thread with error handling
-        std::exception_ptr trainingException = nullptr;
-        std::thread trainingThread([&trainer, &trainingException]() {
-            try {
-                trainer.train();
-            } catch (...) {
-                trainingException = std::current_exception();
+        if (!shardPath.empty()) {
+            trainer.loadShard(shardPath);
+        } else {
+            // Prepare sample training data on the root only
+            std::vector<cv::Mat> trainingData;
+            std::vector<int32_t> labels;
+            if (trainer.getRank() == 0) {
+                trainingData = generateTrainingData(1000, labels);
             }
-        });
 
-        // Start dashboard server with error handling
-        std::exception_ptr dashboardException = nullptr;
-        std::thread dashboardThread([&dashboardException]() {
+            // Scatter data across nodes and release the root's copy
+            trainer.distributeData(trainingData, labels);
+            std::vector<cv::Mat>().swap(trainingData);
+        }
+
+        // Tasks run on a small executor: the training run plus whatever the
+        // dashboard submits
+        DistributedML::TaskManager taskManager;
+        DistributedML::TaskExecutor executor(taskManager, 2);
+
+        // One dashboard for the job, served by rank 0, answering /predict
+        // from the latest epoch's model when serving is enabled
+        std::unique_ptr<DistributedML::InferenceService> inference;
+        std::unique_ptr<DistributedML::DashboardServer> dashboard;
+        if (trainer.getRank() == 0) {
             try {
-                DistributedML::DashboardServer dashboard("http://localhost:8080");
-                dashboard.start();
-            } catch (...) {
-                dashboardException = std::current_exception();
+                if (serve) {
+                    inference = std::make_unique<DistributedML::InferenceService>(
+                        servingOptions, trainer.getMetricsRegistry());
+                }
+                dashboard = std::make_unique<DistributedML::DashboardServer>(
+                    dashboardAddress, taskManager, &executor);
+                dashboard->exposeMetrics(trainer.getMetricsRegistry());
+                if (inference) {
+                    dashboard->exposeInference(*inference);
+                }
+                dashboard->start();
+            } catch (const std::exception& e) {
+                std::cerr << "Dashboard unavailable: " << e.what() << std::endl;
+                dashboard.reset();
+                inference.reset();
             }
-        });
+        }
+
+        // Stream per-epoch loss and throughput to dashboard clients and
+        // refresh the served model
+        if (dashboard) {
+            trainer.setEpochCallback([&dashboard, &inference, &trainer](const nlohmann::json& epochMetrics) {
+                dashboard->publishMetrics(epochMetrics);
+                if (inference) {
+                    inference->setModel(trainer.getModel());
+                }
+            });
+        }
+
+        // Run training as a task so its progress shows up on the dashboard
+        std::exception_ptr trainingException = nullptr;
+        nlohmann::json trainingMetadata = {
+            {"rank", trainer.getRank()},
+            {"epochs", trainer.getConfig().epochs}
+        };
+        DistributedML::TaskOptions trainingOptions;
+        trainingOptions.priority = 100;
+        std::string trainingTask = executor.submit("training", trainingMetadata,
+            [&trainer, &trainingException](DistributedML::TaskContext& context) {
+                trainer.setTaskContext(&context);
+                try {
+                    trainer.train();
+                } catch (...) {
+                    trainingException = std::current_exception();
+                }
+                trainer.setTaskContext(nullptr);
+            },
+            trainingOptions
+        );
 
         // Wait for training to complete
-        trainingThread.join();
+        executor.wait(trainingTask);
 
         // Check for training exceptions
         if (trainingException) {
             std::rethrow_exception(trainingException);
         }
 
-        // Stop dashboard
-        dashboardThread.join();
-
-        // Check for dashboard exceptions
-        if (dashboardException) {
-            std::rethrow_exception(dashboardException);
+        // Collect per-sample predictions on rank 0, streamed to a file when
+        // one is given so they never have to fit in memory
+        if (!resultsPath.empty()) {
+            std::unique_ptr<DistributedML::MappedFileResultSink> sink;
+            if (trainer.getRank() == 0) {
+                sink = std::make_unique<DistributedML::MappedFileResultSink>(resultsPath);
+            }
+            trainer.aggregateResults(sink.get());
+        } else {
+            Eigen::MatrixXd results = trainer.aggregateResults();
+            if (trainer.getRank() == 0) {
+                std::cout << "Collected " << results.rows() << " x " << results.cols() << " results" << std::endl;
+            }
         }
-
-        // Aggregate and log results
-        Eigen::MatrixXd results = trainer.aggregateResults();
         nlohmann::json metrics = trainer.getPerformanceMetrics();
         
         std::cout << "Training Metrics: " << metrics.dump(4) << std::endl;
 
+        // Keep answering predictions from the final model until interrupted
+        if (inference) {
+            trainer.setEpochCallback(nullptr);
+            inference->setModel(trainer.getModel());
+            std::signal(SIGINT, requestStop);
+            std::signal(SIGTERM, requestStop);
+            std::cout << "Serving predictions on " << dashboardAddress << "/predict until interrupted" << std::endl;
+            while (!stopServing.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        }
+
+        // Stop dashboard, then fail any predictions still queued
+        if (dashboard) {
+            trainer.setEpochCallback(nullptr);
+            dashboard->stop();
+        }
+        if (inference) {
+            inference->stop();
+        }
+
     } catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,205 @@
+#include "../include/metrics_registry.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+// Escape a HELP string: backslashes and newlines
+std::string escapeHelp(const std::string& help) {
+    std::string escaped;
+    escaped.reserve(help.size());
+    for (char c : help) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void writeValue(std::ostream& out, double value) {
+    if (std::isnan(value)) {
+        out << "NaN";
+    } else if (std::isinf(value)) {
+        out << (value > 0 ? "+Inf" : "-Inf");
+    } else {
+        out << value;
+    }
+}
+
+// name{labels} or name{labels,extra}
+void writeSeriesName(std::ostream& out, const std::string& name, const std::string& labels,
+                     const std::string& extra = "") {
+    out << name;
+    if (labels.empty() && extra.empty()) {
+        return;
+    }
+    out << '{' << labels;
+    if (!labels.empty() && !extra.empty()) {
+        out << ',';
+    }
+    out << extra << '}';
+}
+
+} // namespace
+
+Histogram::Histogram(std::vector<double> upperBounds)
+    : m_upperBounds(std::move(upperBounds)),
+      m_counts(new std::atomic<uint64_t>[m_upperBounds.size() + 1]) {
+
+    if (!std::is_sorted(m_upperBounds.begin(), m_upperBounds.end())) {
+        BOOST_LOG_TRIVIAL(error) << "Histogram bucket bounds must be ascending";
+        throw std::invalid_argument("Histogram bucket bounds must be ascending");
+    }
+    for (size_t i = 0; i <= m_upperBounds.size(); ++i) {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    // Few buckets: a linear scan beats a binary search
+    size_t bucket = 0;
+    while (bucket < m_upperBounds.size() && value > m_upperBounds[bucket]) {
+        ++bucket;
+    }
+    m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+
+    double sum = m_sum.load(std::memory_order_relaxed);
+    while (!m_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<double> Histogram::exponentialBounds(double start, double factor, size_t count) {
+    std::vector<double> bounds;
+    bounds.reserve(count);
+    double bound = start;
+    for (size_t i = 0; i < count; ++i) {
+        bounds.push_back(bound);
+        bound *= factor;
+    }
+    return bounds;
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrCreate(const std::string& name, const std::string& help,
+                                                       MetricType type, const std::string& labels, bool& created) {
+    created = false;
+    auto it = m_byName.find(name);
+    Family* family = nullptr;
+    if (it == m_byName.end()) {
+        auto owned = std::make_unique<Family>();
+        owned->name = name;
+        owned->help = help;
+        owned->type = type;
+        family = owned.get();
+        m_families.push_back(std::move(owned));
+        m_byName.emplace(name, family);
+    } else {
+        family = it->second;
+        if (family->type != type) {
+            BOOST_LOG_TRIVIAL(error) << "Metric " << name << " is already registered with another type";
+            throw std::invalid_argument("Metric type mismatch: " + name);
+        }
+    }
+
+    for (auto& series : family->series) {
+        if (series->labels == labels) {
+            return *series;
+        }
+    }
+    family->series.push_back(std::make_unique<Series>());
+    family->series.back()->labels = labels;
+    created = true;
+    return *family->series.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool created = false;
+    Series& series = findOrCreate(name, help, MetricType::Counter, labels, created);
+    if (created) {
+        series.counter = std::make_unique<Counter>();
+    }
+    return *series.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool created = false;
+    Series& series = findOrCreate(name, help, MetricType::Gauge, labels, created);
+    if (created) {
+        series.gauge = std::make_unique<Gauge>();
+    }
+    return *series.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const std::vector<double>& upperBounds, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool created = false;
+    Series& series = findOrCreate(name, help, MetricType::Histogram, labels, created);
+    if (created) {
+        series.histogram = std::make_unique<Histogram>(upperBounds);
+    }
+    return *series.histogram;
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+    std::ostringstream out;
+    out.precision(12);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& family : m_families) {
+        const bool isCounter = family->type == MetricType::Counter;
+        const bool isGauge = family->type == MetricType::Gauge;
+        out << "# HELP " << family->name << ' ' << escapeHelp(family->help) << '\n';
+        out << "# TYPE " << family->name << ' ' << (isCounter ? "counter" : isGauge ? "gauge" : "histogram") << '\n';
+
+        for (const auto& series : family->series) {
+            if (isCounter) {
+                writeSeriesName(out, family->name, series->labels);
+                out << ' ' << series->counter->value() << '\n';
+            } else if (isGauge) {
+                writeSeriesName(out, family->name, series->labels);
+                out << ' ';
+                writeValue(out, series->gauge->value());
+                out << '\n';
+            } else {
+                // Buckets are cumulative on the wire. Counts are read one by
+                // one while writers run, so a scrape may be off by in-flight
+                // observations; _count is the +Inf bucket for consistency.
+                const Histogram& histogram = *series->histogram;
+                const auto& bounds = histogram.upperBounds();
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < bounds.size(); ++i) {
+                    cumulative += histogram.bucketCount(i);
+                    std::ostringstream le;
+                    le.precision(12);
+                    le << "le=\"" << bounds[i] << '"';
+                    writeSeriesName(out, family->name + "_bucket", series->labels, le.str());
+                    out << ' ' << cumulative << '\n';
+                }
+                cumulative += histogram.bucketCount(bounds.size());
+                writeSeriesName(out, family->name + "_bucket", series->labels, "le=\"+Inf\"");
+                out << ' ' << cumulative << '\n';
+                writeSeriesName(out, family->name + "_sum", series->labels);
+                out << ' ';
+                writeValue(out, histogram.sum());
+                out << '\n';
+                writeSeriesName(out, family->name + "_count", series->labels);
+                out << ' ' << cumulative << '\n';
+            }
+        }
+    }
+    return out.str();
+}
+
+} // namespace DistributedML
@@ -0,0 +1,380 @@
+#include "../include/mlp_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+
+namespace DistributedML {
+
+namespace {
+
+constexpr int Dyn = Eigen::Dynamic;
+
+// Eigen 3.4 lets the caller own the packing buffers of its blocked GEMM,
+// through the internal level3_blocking interface. Other releases, such as
+// the 3.3.7 in Ubuntu 20.04, have a different internal signature and use
+// the public product, which packs into buffers of its own. Define as 0 to
+// force the public product.
+#ifndef DML_PERSISTENT_GEMM_BUFFERS
+#if EIGEN_VERSION_AT_LEAST(3, 4, 0) && !EIGEN_VERSION_AT_LEAST(3, 4, 90)
+#define DML_PERSISTENT_GEMM_BUFFERS 1
+#else
+#define DML_PERSISTENT_GEMM_BUFFERS 0
+#endif
+#endif
+
+#if DML_PERSISTENT_GEMM_BUFFERS
+// Packing buffers for Eigen's blocked GEMM that persist across products.
+// Eigen's own products size them per call and, past its stack allocation
+// limit (which these layers always exceed), take them from the heap.
+template <typename Scalar>
+class GemmBuffers : public Eigen::internal::level3_blocking<Scalar, Scalar> {
+public:
+    void prepare(Eigen::Index rows, Eigen::Index cols, Eigen::Index depth) {
+        this->m_mc = rows;
+        this->m_nc = cols;
+        this->m_kc = depth;
+        Eigen::internal::computeProductBlockingSizes<Scalar, Scalar, 1>(
+            this->m_kc, this->m_mc, this->m_nc, Eigen::Index(1));
+        grow(m_packedLhs, this->m_mc * this->m_kc);
+        grow(m_packedRhs, this->m_kc * this->m_nc);
+        this->m_blockA = m_packedLhs.data();
+        this->m_blockB = m_packedRhs.data();
+    }
+
+private:
+    static void grow(Eigen::Matrix<Scalar, Dyn, 1>& buffer, Eigen::Index size) {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+    }
+
+    Eigen::Matrix<Scalar, Dyn, 1> m_packedLhs;
+    Eigen::Matrix<Scalar, Dyn, 1> m_packedRhs;
+};
+#else
+// Nothing to keep: the public product manages its own packing buffers
+template <typename Scalar>
+struct GemmBuffers {};
+#endif
+
+// dst = lhs * rhs, or dst += lhs * rhs when accumulate is set. dst must be
+// column-major; the operands may be either, with any outer stride. When
+// Eigen parallelizes its GEMMs itself, its own product is used instead.
+template <typename Scalar, typename Dst, typename Lhs, typename Rhs>
+void gemm(Dst& dst, const Lhs& lhs, const Rhs& rhs, bool accumulate, GemmBuffers<Scalar>& buffers) {
+#if DML_PERSISTENT_GEMM_BUFFERS
+    if (Eigen::nbThreads() == 1) {
+        if (!accumulate) {
+            dst.setZero();
+        }
+        if (dst.rows() == 0 || dst.cols() == 0 || lhs.cols() == 0) {
+            return;
+        }
+        buffers.prepare(dst.rows(), dst.cols(), lhs.cols());
+        Eigen::internal::general_matrix_matrix_product<
+            Eigen::Index,
+            Scalar, Lhs::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor, false,
+            Scalar, Rhs::IsRowMajor ? Eigen::RowMajor : Eigen::ColMajor, false,
+            Eigen::ColMajor, 1>::run(
+                dst.rows(), dst.cols(), lhs.cols(),
+                lhs.data(), lhs.outerStride(),
+                rhs.data(), rhs.outerStride(),
+                dst.data(), 1, dst.outerStride(),
+                Scalar(1), buffers);
+        return;
+    }
+#else
+    (void)buffers;
+#endif
+
+    if (accumulate) {
+        dst.noalias() += lhs * rhs;
+    } else {
+        dst.noalias() = lhs * rhs;
+    }
+}
+
+template <typename Scalar, int Input, int Hidden, int Output>
+struct LayerScratch : KernelScratch {
+    // Float64: the batch converted from float samples
+    Eigen::Matrix<Scalar, Dyn, Input> input;
+    Eigen::Matrix<Scalar, Dyn, Hidden> hidden;
+    Eigen::Matrix<Scalar, Dyn, Hidden> hiddenDelta;
+    Eigen::Matrix<Scalar, Dyn, Output> output;
+    Eigen::Matrix<Scalar, Dyn, 1> rowScratch;
+    // Float32: the gradient summed in single precision
+    Eigen::Matrix<Scalar, Dyn, 1> gradient;
+    GemmBuffers<Scalar> gemm;
+};
+
+// The perceptron's passes for one scalar type and set of layer widths.
+// Widths given as Eigen::Dynamic are taken at run time; fixed ones let
+// Eigen size every per-sample row, bias and softmax loop at compile time.
+template <typename Scalar, int Input, int Hidden, int Output>
+class LayerKernel final : public MlpKernel {
+public:
+    static constexpr bool kSpecialized = Input != Dyn && Hidden != Dyn && Output != Dyn;
+    // Double kernels read the parameters and write the gradient in place
+    static constexpr bool kNative = std::is_same_v<Scalar, double>;
+
+    LayerKernel(Eigen::Index inputSize, Eigen::Index hiddenSize, Eigen::Index outputSize)
+        : MlpKernel(inputSize, hiddenSize, outputSize),
+          m_b1Offset(hiddenSize * inputSize),
+          m_w2Offset(m_b1Offset + hiddenSize),
+          m_b2Offset(m_w2Offset + outputSize * hiddenSize),
+          m_parameterCount(m_b2Offset + outputSize) {}
+
+    std::string name() const override {
+        std::string name = kernelPrecisionName(precision());
+        if constexpr (kSpecialized) {
+            return name + " " + std::to_string(Input) + "x" + std::to_string(Hidden) + "x" + std::to_string(Output);
+        }
+        return name + " dynamic";
+    }
+
+    KernelPrecision precision() const override {
+        return kNative ? KernelPrecision::Float64 : KernelPrecision::Float32;
+    }
+
+    bool specialized() const override { return kSpecialized; }
+
+    std::unique_ptr<KernelScratch> createScratch(Eigen::Index maxBatch) const override {
+        auto scratch = std::make_unique<Scratch>();
+        scratch->owner = this;
+        if constexpr (kNative) {
+            scratch->input.resize(maxBatch, m_inputSize);
+        } else {
+            scratch->gradient.resize(m_parameterCount);
+        }
+        scratch->hidden.resize(maxBatch, m_hiddenSize);
+        scratch->hiddenDelta.resize(maxBatch, m_hiddenSize);
+        scratch->output.resize(maxBatch, m_outputSize);
+        scratch->rowScratch.resize(maxBatch);
+        return scratch;
+    }
+
+    void predict(const KernelParameters& parameters, const BatchView& batch, KernelScratch& scratch,
+                 Eigen::MatrixXd& output) const override {
+        Scratch& s = checkedScratch(batch, scratch);
+        const Scalar* weights = scalarParameters(parameters);
+        withInput(batch, s, [&](const auto& input) { forward(weights, input, s); });
+
+        if constexpr (kNative) {
+            output.topRows(batch.samples) = s.output.topRows(batch.samples);
+        } else {
+            output.topRows(batch.samples) = s.output.topRows(batch.samples).template cast<double>();
+        }
+    }
+
+    double computeGradient(const KernelParameters& parameters, const BatchView& batch, const int32_t* labels,
+                           KernelScratch& scratch, double* gradient, bool accumulate, bool widen) const override {
+        Scratch& s = checkedScratch(batch, scratch);
+        const Scalar* weights = scalarParameters(parameters);
+
+        double loss = 0.0;
+        withInput(batch, s, [&](const auto& input) {
+            forward(weights, input, s);
+            loss = crossEntropy(labels, s, batch.samples);
+            if constexpr (kNative) {
+                backward(weights, input, s, gradient, accumulate);
+            } else {
+                backward(weights, input, s, s.gradient.data(), accumulate);
+            }
+        });
+
+        if (!kNative && widen) {
+            widenGradient(s, gradient);
+        }
+        return loss;
+    }
+
+    void widenGradient(const KernelScratch& scratch, double* gradient) const override {
+        if constexpr (!kNative) {
+            if (scratch.owner != this) {
+                throw std::invalid_argument("Workspace was created for another kernel");
+            }
+            Eigen::Map<Eigen::VectorXd>(gradient, m_parameterCount) =
+                static_cast<const Scratch&>(scratch).gradient.template cast<double>();
+        }
+    }
+
+private:
+    using Scratch = LayerScratch<Scalar, Input, Hidden, Output>;
+    using W1 = Eigen::Matrix<Scalar, Hidden, Input>;
+    using B1 = Eigen::Matrix<Scalar, Hidden, 1>;
+    using W2 = Eigen::Matrix<Scalar, Output, Hidden>;
+    using B2 = Eigen::Matrix<Scalar, Output, 1>;
+    using SampleRows = Eigen::Matrix<float, Dyn, Input, Input == 1 ? Eigen::ColMajor : Eigen::RowMajor>;
+
+    Scratch& checkedScratch(const BatchView& batch, KernelScratch& scratch) const {
+        if (scratch.owner != this) {
+            throw std::invalid_argument("Workspace was created for another kernel");
+        }
+        Scratch& s = static_cast<Scratch&>(scratch);
+        if (batch.features != m_inputSize || batch.samples > s.hidden.rows()) {
+            throw std::invalid_argument("Batch does not fit model workspace");
+        }
+        return s;
+    }
+
+    const Scalar* scalarParameters(const KernelParameters& parameters) const {
+        const Scalar* weights = nullptr;
+        if constexpr (kNative) {
+            weights = parameters.f64;
+        } else {
+            weights = parameters.f32;
+        }
+        if (!weights) {
+            throw std::invalid_argument("Parameters missing in the kernel's precision");
+        }
+        return weights;
+    }
+
+    // Float kernels multiply straight out of the batch buffer; double ones
+    // convert it into scratch first
+    template <typename Body>
+    void withInput(const BatchView& batch, Scratch& s, Body&& body) const {
+        Eigen::Map<const SampleRows, Eigen::Aligned64, Eigen::OuterStride<>> samples(
+            batch.data, batch.samples, batch.features, Eigen::OuterStride<>(batch.stride));
+        if constexpr (std::is_same_v<Scalar, float>) {
+            body(samples);
+        } else {
+            auto input = s.input.topRows(batch.samples);
+            input = samples.template cast<Scalar>();
+            body(input);
+        }
+    }
+
+    template <typename Rows>
+    void forward(const Scalar* p, const Rows& input, Scratch& s) const {
+        const Eigen::Index n = input.rows();
+        Eigen::Map<const W1> w1(p, m_hiddenSize, m_inputSize);
+        Eigen::Map<const B1> b1(p + m_b1Offset, m_hiddenSize);
+        Eigen::Map<const W2> w2(p + m_w2Offset, m_outputSize, m_hiddenSize);
+        Eigen::Map<const B2> b2(p + m_b2Offset, m_outputSize);
+
+        auto hidden = s.hidden.topRows(n);
+        auto output = s.output.topRows(n);
+        auto rowScratch = s.rowScratch.head(n);
+
+        // Hidden layer: ReLU(X * W1^T + b1)
+        gemm(hidden, input, w1.transpose(), false, s.gemm);
+        hidden.rowwise() += b1.transpose();
+        hidden = hidden.cwiseMax(Scalar(0));
+
+        // Output layer followed by a numerically stable row-wise softmax
+        gemm(output, hidden, w2.transpose(), false, s.gemm);
+        output.rowwise() += b2.transpose();
+        rowScratch = output.rowwise().maxCoeff();
+        output.colwise() -= rowScratch;
+        output = output.array().exp().matrix();
+        rowScratch = output.rowwise().sum();
+        output.array().colwise() /= rowScratch.array();
+    }
+
+    // Summed loss; the softmax output becomes dL/dZ2 = P - onehot(y)
+    double crossEntropy(const int32_t* labels, Scratch& s, Eigen::Index n) const {
+        double loss = 0.0;
+        for (Eigen::Index i = 0; i < n; ++i) {
+            const int32_t label = labels[i];
+            if (label < 0 || label >= m_outputSize) {
+                throw std::out_of_range("Sample label outside model output range");
+            }
+            loss -= std::log(std::max(static_cast<double>(s.output(i, label)), 1e-12));
+            s.output(i, label) -= Scalar(1);
+        }
+        return loss;
+    }
+
+    template <typename Rows>
+    void backward(const Scalar* p, const Rows& input, Scratch& s, Scalar* gradient, bool accumulate) const {
+        const Eigen::Index n = input.rows();
+        auto hidden = s.hidden.topRows(n);
+        auto output = s.output.topRows(n);
+        auto hiddenDelta = s.hiddenDelta.topRows(n);
+
+        Eigen::Map<W1> w1Gradient(gradient, m_hiddenSize, m_inputSize);
+        Eigen::Map<B1> b1Gradient(gradient + m_b1Offset, m_hiddenSize);
+        Eigen::Map<W2> w2Gradient(gradient + m_w2Offset, m_outputSize, m_hiddenSize);
+        Eigen::Map<B2> b2Gradient(gradient + m_b2Offset, m_outputSize);
+        Eigen::Map<const W2> w2(p + m_w2Offset, m_outputSize, m_hiddenSize);
+
+        // Back-propagate through W2 and the ReLU
+        gemm(hiddenDelta, output, w2, false, s.gemm);
+        hiddenDelta = (hidden.array() > Scalar(0)).select(hiddenDelta, Scalar(0));
+
+        gemm(w2Gradient, output.transpose(), hidden, accumulate, s.gemm);
+        gemm(w1Gradient, hiddenDelta.transpose(), input, accumulate, s.gemm);
+        if (accumulate) {
+            b2Gradient += output.colwise().sum().transpose();
+            b1Gradient += hiddenDelta.colwise().sum().transpose();
+        } else {
+            b2Gradient = output.colwise().sum().transpose();
+            b1Gradient = hiddenDelta.colwise().sum().transpose();
+        }
+    }
+
+    // Offsets of b1, W2 and b2 within the flat parameter vector (W1 is at 0)
+    Eigen::Index m_b1Offset;
+    Eigen::Index m_w2Offset;
+    Eigen::Index m_b2Offset;
+    Eigen::Index m_parameterCount;
+};
+
+struct Specialization {
+    Eigen::Index inputSize;
+    Eigen::Index hiddenSize;
+    Eigen::Index outputSize;
+    KernelPrecision precision;
+    std::shared_ptr<const MlpKernel> (*make)();
+};
+
+template <typename Scalar, int Input, int Hidden, int Output>
+std::shared_ptr<const MlpKernel> makeSpecialized() {
+    return std::make_shared<const LayerKernel<Scalar, Input, Hidden, Output>>(Input, Hidden, Output);
+}
+
+// 28x28 samples as produced by main.cpp, ten classes, and the usual
+// hidden widths
+const Specialization kSpecializations[] = {
+    {784, 64, 10, KernelPrecision::Float64, &makeSpecialized<double, 784, 64, 10>},
+    {784, 64, 10, KernelPrecision::Float32, &makeSpecialized<float, 784, 64, 10>},
+    {784, 128, 10, KernelPrecision::Float64, &makeSpecialized<double, 784, 128, 10>},
+    {784, 128, 10, KernelPrecision::Float32, &makeSpecialized<float, 784, 128, 10>},
+    {784, 256, 10, KernelPrecision::Float64, &makeSpecialized<double, 784, 256, 10>},
+    {784, 256, 10, KernelPrecision::Float32, &makeSpecialized<float, 784, 256, 10>},
+};
+
+} // namespace
+
+KernelPrecision parseKernelPrecision(const std::string& name) {
+    if (name == "f64") return KernelPrecision::Float64;
+    if (name == "f32") return KernelPrecision::Float32;
+    throw std::invalid_argument("Unknown precision: " + name);
+}
+
+const char* kernelPrecisionName(KernelPrecision precision) {
+    return precision == KernelPrecision::Float32 ? "f32" : "f64";
+}
+
+std::shared_ptr<const MlpKernel> selectMlpKernel(Eigen::Index inputSize, Eigen::Index hiddenSize,
+                                                 Eigen::Index outputSize, KernelPrecision precision) {
+    for (const auto& entry : kSpecializations) {
+        if (entry.inputSize == inputSize && entry.hiddenSize == hiddenSize &&
+            entry.outputSize == outputSize && entry.precision == precision) {
+            return entry.make();
+        }
+    }
+    return dynamicMlpKernel(inputSize, hiddenSize, outputSize, precision);
+}
+
+std::shared_ptr<const MlpKernel> dynamicMlpKernel(Eigen::Index inputSize, Eigen::Index hiddenSize,
+                                                  Eigen::Index outputSize, KernelPrecision precision) {
+    if (precision == KernelPrecision::Float32) {
+        return std::make_shared<const LayerKernel<float, Dyn, Dyn, Dyn>>(inputSize, hiddenSize, outputSize);
+    }
+    return std::make_shared<const LayerKernel<double, Dyn, Dyn, Dyn>>(inputSize, hiddenSize, outputSize);
+}
+
+} // namespace DistributedML
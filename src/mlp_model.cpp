@@ -0,0 +1,114 @@
+#include "../include/mlp_model.h"
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace DistributedML {
+
+MlpModel::MlpModel(Eigen::Index inputSize, Eigen::Index hiddenSize, Eigen::Index outputSize,
+                   KernelPrecision precision)
+    : m_inputSize(inputSize),
+      m_hiddenSize(hiddenSize),
+      m_outputSize(outputSize) {
+
+    if (inputSize <= 0 || hiddenSize <= 0 || outputSize <= 1) {
+        throw std::invalid_argument("Invalid MLP dimensions");
+    }
+
+    m_w1Offset = 0;
+    m_b1Offset = m_w1Offset + m_hiddenSize * m_inputSize;
+    m_w2Offset = m_b1Offset + m_hiddenSize;
+    m_b2Offset = m_w2Offset + m_outputSize * m_hiddenSize;
+    m_parameters = Eigen::VectorXd::Zero(m_b2Offset + m_outputSize);
+    m_kernel = selectMlpKernel(m_inputSize, m_hiddenSize, m_outputSize, precision);
+}
+
+void MlpModel::initialize(uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> hiddenInit(0.0, std::sqrt(2.0 / m_inputSize));
+    std::normal_distribution<double> outputInit(0.0, std::sqrt(1.0 / m_hiddenSize));
+
+    ++m_parametersVersion;
+    m_parameters.setZero();
+    for (Eigen::Index i = m_w1Offset; i < m_b1Offset; ++i) {
+        m_parameters(i) = hiddenInit(generator);
+    }
+    for (Eigen::Index i = m_w2Offset; i < m_b2Offset; ++i) {
+        m_parameters(i) = outputInit(generator);
+    }
+}
+
+MlpModel::Workspace MlpModel::createWorkspace(Eigen::Index maxBatch) const {
+    Workspace workspace;
+    workspace.output.resize(maxBatch, m_outputSize);
+    workspace.gradient = Eigen::VectorXd::Zero(m_parameters.size());
+    if (m_kernel) {
+        workspace.scratch = m_kernel->createScratch(maxBatch);
+    }
+    return workspace;
+}
+
+void MlpModel::setKernel(std::shared_ptr<const MlpKernel> kernel) {
+    if (!kernel || kernel->inputSize() != m_inputSize || kernel->hiddenSize() != m_hiddenSize ||
+        kernel->outputSize() != m_outputSize) {
+        throw std::invalid_argument("Kernel does not match the model's shape");
+    }
+    m_kernel = std::move(kernel);
+}
+
+double MlpModel::computeGradient(const BatchView& batch, const int32_t* labels, Workspace& workspace,
+                                 bool accumulate, bool widen) const {
+    if (!workspace.scratch) {
+        throw std::invalid_argument("Batch does not fit model workspace");
+    }
+    return m_kernel->computeGradient(kernelParameters(), batch, labels, *workspace.scratch,
+                                     workspace.gradient.data(), accumulate, widen);
+}
+
+void MlpModel::widenGradient(Workspace& workspace) const {
+    if (!workspace.scratch) {
+        throw std::invalid_argument("Batch does not fit model workspace");
+    }
+    m_kernel->widenGradient(*workspace.scratch, workspace.gradient.data());
+}
+
+void MlpModel::predict(const BatchView& batch, Workspace& workspace) const {
+    if (!workspace.scratch) {
+        throw std::invalid_argument("Batch does not fit model workspace");
+    }
+    m_kernel->predict(kernelParameters(), batch, *workspace.scratch, workspace.output);
+}
+
+KernelParameters MlpModel::kernelParameters() const {
+    KernelParameters parameters;
+    parameters.f64 = m_parameters.data();
+    if (m_kernel->precision() == KernelPrecision::Float32) {
+        parameters.f32 = m_mirror.get(m_parameters, m_parametersVersion);
+    }
+    return parameters;
+}
+
+const float* MlpModel::ParameterMirror::get(const Eigen::VectorXd& parameters, uint64_t version) {
+    // Parameters only change between passes, so once converted every
+    // thread reads the values without locking
+    if (m_version.load(std::memory_order_acquire) != version) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_version.load(std::memory_order_relaxed) != version) {
+            m_values = parameters.cast<float>();
+            m_version.store(version, std::memory_order_release);
+        }
+    }
+    return m_values.data();
+}
+
+std::vector<ParameterBlock> MlpModel::blocks() const {
+    return {
+        {m_w1Offset, m_b1Offset - m_w1Offset, false},
+        {m_b1Offset, m_w2Offset - m_b1Offset, true},
+        {m_w2Offset, m_b2Offset - m_w2Offset, false},
+        {m_b2Offset, m_parameters.size() - m_b2Offset, true}
+    };
+}
+
+} // namespace DistributedML
@@ -0,0 +1,191 @@
+#include "../include/optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+using ArrayMap = Eigen::Map<Eigen::ArrayXd>;
+using ConstArrayMap = Eigen::Map<const Eigen::ArrayXd>;
+
+// Doubles per chunk: the four arrays a chunk touches fit in a 32 KiB L1
+constexpr Eigen::Index kChunk = 512;
+
+// ||w|| / ||update||, falling back to 1 while either norm is zero
+double trustRatio(double parameterNorm, double updateNorm) {
+    return parameterNorm > 0.0 && updateNorm > 0.0 ? parameterNorm / updateNorm : 1.0;
+}
+
+} // namespace
+
+OptimizerKind parseOptimizerKind(const std::string& name) {
+    if (name == "sgd") return OptimizerKind::SGD;
+    if (name == "adam") return OptimizerKind::Adam;
+    if (name == "lamb") return OptimizerKind::LAMB;
+    if (name == "lars") return OptimizerKind::LARS;
+    throw std::invalid_argument("Unknown optimizer: " + name);
+}
+
+const char* optimizerKindName(OptimizerKind kind) {
+    switch (kind) {
+        case OptimizerKind::Adam: return "adam";
+        case OptimizerKind::LAMB: return "lamb";
+        case OptimizerKind::LARS: return "lars";
+        case OptimizerKind::SGD: break;
+    }
+    return "sgd";
+}
+
+Optimizer::Optimizer(const OptimizerOptions& options, std::vector<ParameterBlock> blocks)
+    : m_options(options),
+      m_blocks(std::move(blocks)),
+      m_parameterCount(0),
+      m_steps(0) {
+
+    if (!valid(m_options)) {
+        BOOST_LOG_TRIVIAL(error) << "Invalid " << optimizerKindName(m_options.kind) << " hyperparameters";
+        throw std::invalid_argument("Invalid optimizer hyperparameters");
+    }
+
+    for (const ParameterBlock& block : m_blocks) {
+        m_parameterCount = std::max(m_parameterCount, block.offset + block.size);
+    }
+
+    size_t vectors = 0;
+    switch (m_options.kind) {
+        case OptimizerKind::SGD: vectors = m_options.momentum > 0.0 ? 1 : 0; break;
+        case OptimizerKind::LARS: vectors = 1; break;
+        case OptimizerKind::Adam: vectors = 2; break;
+        case OptimizerKind::LAMB:
+            vectors = 2;
+            m_update.resize(m_parameterCount);
+            break;
+    }
+    m_state.assign(vectors, Eigen::VectorXd::Zero(m_parameterCount));
+}
+
+bool Optimizer::valid(const OptimizerOptions& options) {
+    return options.momentum >= 0.0 && options.momentum < 1.0 &&
+           options.beta1 >= 0.0 && options.beta1 < 1.0 &&
+           options.beta2 >= 0.0 && options.beta2 < 1.0 &&
+           options.epsilon > 0.0 && options.weightDecay >= 0.0 && options.trustCoefficient > 0.0;
+}
+
+void Optimizer::reset() {
+    for (auto& state : m_state) {
+        state.setZero();
+    }
+    m_steps = 0;
+}
+
+void Optimizer::step(Eigen::VectorXd& parameters, const Eigen::Ref<const Eigen::VectorXd>& gradient,
+                     double learningRate) {
+    if (parameters.size() != m_parameterCount || gradient.size() != m_parameterCount) {
+        throw std::invalid_argument("Gradient size does not match optimizer");
+    }
+    ++m_steps;
+
+    for (const ParameterBlock& block : m_blocks) {
+        double* w = parameters.data() + block.offset;
+        const double* g = gradient.data() + block.offset;
+        switch (m_options.kind) {
+            case OptimizerKind::SGD: sgdBlock(block, w, g, learningRate); break;
+            case OptimizerKind::Adam:
+            case OptimizerKind::LAMB: adamBlock(block, w, g, learningRate); break;
+            case OptimizerKind::LARS: larsBlock(block, w, g, learningRate); break;
+        }
+    }
+}
+
+void Optimizer::sgdBlock(const ParameterBlock& block, double* parameters, const double* gradient,
+                         double learningRate) {
+    const double decay = block.bias ? 0.0 : m_options.weightDecay;
+    const double momentum = m_options.momentum;
+
+    for (Eigen::Index begin = 0; begin < block.size; begin += kChunk) {
+        const Eigen::Index count = std::min(kChunk, block.size - begin);
+        ArrayMap w(parameters + begin, count);
+        ConstArrayMap g(gradient + begin, count);
+        if (m_state.empty()) {
+            w -= learningRate * (g + decay * w);
+            continue;
+        }
+        ArrayMap velocity(m_state[0].data() + block.offset + begin, count);
+        velocity = momentum * velocity + g + decay * w;
+        w -= learningRate * velocity;
+    }
+}
+
+void Optimizer::adamBlock(const ParameterBlock& block, double* parameters, const double* gradient,
+                          double learningRate) {
+    const bool lamb = m_options.kind == OptimizerKind::LAMB;
+    const double decay = block.bias ? 0.0 : m_options.weightDecay;
+    const double beta1 = m_options.beta1;
+    const double beta2 = m_options.beta2;
+    const double epsilon = m_options.epsilon;
+    const double t = static_cast<double>(m_steps);
+    const double correction1 = 1.0 / (1.0 - std::pow(beta1, t));
+    const double correction2 = 1.0 / (1.0 - std::pow(beta2, t));
+
+    double parameterNorm = 0.0;
+    double updateNorm = 0.0;
+    for (Eigen::Index begin = 0; begin < block.size; begin += kChunk) {
+        const Eigen::Index count = std::min(kChunk, block.size - begin);
+        ArrayMap w(parameters + begin, count);
+        ConstArrayMap g(gradient + begin, count);
+        ArrayMap m(m_state[0].data() + block.offset + begin, count);
+        ArrayMap v(m_state[1].data() + block.offset + begin, count);
+
+        m = beta1 * m + (1.0 - beta1) * g;
+        v = beta2 * v + (1.0 - beta2) * g.square();
+        if (!lamb) {
+            w -= learningRate * ((correction1 * m) / ((correction2 * v).sqrt() + epsilon) + decay * w);
+            continue;
+        }
+
+        // LAMB needs the whole block's norms before it can scale the update
+        ArrayMap update(m_update.data() + block.offset + begin, count);
+        update = (correction1 * m) / ((correction2 * v).sqrt() + epsilon) + decay * w;
+        parameterNorm += w.square().sum();
+        updateNorm += update.square().sum();
+    }
+    if (!lamb) {
+        return;
+    }
+
+    const double ratio = block.bias ? 1.0 : trustRatio(std::sqrt(parameterNorm), std::sqrt(updateNorm));
+    Eigen::Map<Eigen::VectorXd>(parameters, block.size) -=
+        (learningRate * ratio) * m_update.segment(block.offset, block.size);
+}
+
+void Optimizer::larsBlock(const ParameterBlock& block, double* parameters, const double* gradient,
+                          double learningRate) {
+    const double decay = block.bias ? 0.0 : m_options.weightDecay;
+    const double momentum = m_options.momentum;
+
+    // Layer norms first; the ratio scales the whole block's step
+    double ratio = 1.0;
+    if (!block.bias) {
+        const double parameterNorm = Eigen::Map<const Eigen::VectorXd>(parameters, block.size).norm();
+        const double gradientNorm = Eigen::Map<const Eigen::VectorXd>(gradient, block.size).norm();
+        const double denominator = gradientNorm + decay * parameterNorm;
+        if (parameterNorm > 0.0 && denominator > 0.0) {
+            ratio = m_options.trustCoefficient * parameterNorm / denominator;
+        }
+    }
+    const double scale = learningRate * ratio;
+
+    for (Eigen::Index begin = 0; begin < block.size; begin += kChunk) {
+        const Eigen::Index count = std::min(kChunk, block.size - begin);
+        ArrayMap w(parameters + begin, count);
+        ConstArrayMap g(gradient + begin, count);
+        ArrayMap velocity(m_state[0].data() + block.offset + begin, count);
+        velocity = momentum * velocity + scale * (g + decay * w);
+        w -= velocity;
+    }
+}
+
+} // namespace DistributedML
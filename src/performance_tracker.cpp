@@ -1,33 +1,209 @@
 #include "../include/performance_tracker.h"
 #include <algorithm>
+#include <cmath>
 
 namespace DistributedML {
 
+namespace {
+
+// Distinguishes tracker instances in thread-local caches, even when one is
+// allocated where another used to live
+std::atomic<uint64_t> g_trackerSerial{0};
+
+int highestBit(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
+} // namespace
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos) {
+    if (nanos < kSubBuckets) {
+        return static_cast<size_t>(nanos);
+    }
+    int exponent = highestBit(nanos);
+    uint64_t subBucket = (nanos >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return static_cast<size_t>((exponent - kSubBucketBits + 1) * kSubBuckets + subBucket);
+}
+
+uint64_t LatencyHistogram::bucketMidpoint(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int exponent = static_cast<int>(bucket / kSubBuckets) + kSubBucketBits - 1;
+    uint64_t subBucket = bucket % kSubBuckets;
+    uint64_t width = uint64_t{1} << (exponent - kSubBucketBits);
+    uint64_t lower = (uint64_t{1} << exponent) + subBucket * width;
+    return lower + width / 2;
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    ++m_counts[bucketOf(nanos)];
+    ++m_count;
+    m_total += nanos;
+    m_max = std::max(m_max, nanos);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        m_counts[i] += other.m_counts[i];
+    }
+    m_count += other.m_count;
+    m_total += other.m_total;
+    m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * m_count));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            return std::min(bucketMidpoint(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+PerformanceTracker::PerformanceTracker()
+    : m_serial(++g_trackerSerial) {}
+
+PerformanceTracker::~PerformanceTracker() = default;
+
+MetricId PerformanceTracker::intern(const std::string& metricName) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_ids.find(metricName);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+
+    MetricId id = static_cast<MetricId>(m_metrics.size());
+    m_metrics.push_back({metricName, {}, 0});
+    m_ids.emplace(metricName, id);
+    return id;
+}
+
+PerformanceTracker::ThreadBuffer& PerformanceTracker::registerThread() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_threadBuffers.find(std::this_thread::get_id());
+    if (it != m_threadBuffers.end()) {
+        return *it->second;
+    }
+
+    m_buffers.push_back(std::make_unique<ThreadBuffer>());
+    ThreadBuffer* buffer = m_buffers.back().get();
+    buffer->events.resize(kRingCapacity);
+    m_threadBuffers.emplace(std::this_thread::get_id(), buffer);
+    return *buffer;
+}
+
+void PerformanceTracker::record(MetricId id, uint64_t startNanos, uint64_t durationNanos) {
+    ThreadBuffer& buffer = localBuffer();
+    push(buffer, {startNanos, durationNanos, id, buffer.depth});
+}
+
 void PerformanceTracker::startTracking(const std::string& metricName) {
-    PerformanceMetric metric;
-    metric.name = metricName;
-    metric.startTime = std::chrono::high_resolution_clock::now();
-    m_metrics.push_back(metric);
+    MetricId id = intern(metricName);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_openSpans[id] = now();
 }
 
 void PerformanceTracker::stopTracking(const std::string& metricName) {
-    auto it = std::find_if(m_metrics.begin(), m_metrics.end(), 
-        [&metricName](const PerformanceMetric& metric) { 
-            return metric.name == metricName; 
-        });
+    MetricId id = intern(metricName);
+    uint64_t start = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_openSpans.find(id);
+        if (it == m_openSpans.end()) {
+            return;
+        }
+        start = it->second;
+        m_openSpans.erase(it);
+    }
+    record(id, start, now() - start);
+}
 
-    if (it != m_metrics.end()) {
-        it->endTime = std::chrono::high_resolution_clock::now();
-        it->duration = std::chrono::duration<double>(it->endTime - it->startTime).count();
+void PerformanceTracker::collect() const {
+    // Caller holds m_mutex, which also makes this the only consumer
+    for (size_t thread = 0; thread < m_buffers.size(); ++thread) {
+        ThreadBuffer& buffer = *m_buffers[thread];
+        uint64_t tail = buffer.tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const SpanEvent& event = buffer.events[tail & (kRingCapacity - 1)];
+            MetricState& metric = m_metrics[event.id];
+            metric.histogram.record(event.durationNanos);
+            metric.depth = event.depth;
+
+            if (m_timeline.size() < m_timelineCapacity) {
+                m_timeline.push_back({event.startNanos, event.durationNanos, event.id, event.depth,
+                                      static_cast<uint32_t>(thread), 0});
+            }
+        }
+        buffer.tail.store(head, std::memory_order_release);
     }
 }
 
+void PerformanceTracker::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collect();
+}
+
+void PerformanceTracker::enableTimeline(size_t maxEvents) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_timelineCapacity = maxEvents;
+}
+
+std::vector<PerformanceTracker::TimelineEvent> PerformanceTracker::timeline() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collect();
+    return m_timeline;
+}
+
+std::vector<std::string> PerformanceTracker::metricNames() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    names.reserve(m_metrics.size());
+    for (const auto& metric : m_metrics) {
+        names.push_back(metric.name);
+    }
+    return names;
+}
+
+uint64_t PerformanceTracker::droppedSpans() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t dropped = 0;
+    for (const auto& buffer : m_buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
 nlohmann::json PerformanceTracker::getMetrics() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collect();
+
+    constexpr double kNanosPerMs = 1e6;
     nlohmann::json metricsJson = nlohmann::json::array();
     for (const auto& metric : m_metrics) {
+        const LatencyHistogram& histogram = metric.histogram;
+        if (histogram.count() == 0) {
+            continue;
+        }
         metricsJson.push_back({
             {"name", metric.name},
-            {"duration", metric.duration}
+            {"depth", metric.depth},
+            {"count", histogram.count()},
+            {"total_ms", histogram.total() / kNanosPerMs},
+            {"duration_ms", histogram.mean() / kNanosPerMs},
+            {"p50_ms", histogram.percentile(0.50) / kNanosPerMs},
+            {"p99_ms", histogram.percentile(0.99) / kNanosPerMs},
+            {"p999_ms", histogram.percentile(0.999) / kNanosPerMs},
+            {"max_ms", histogram.max() / kNanosPerMs}
         });
     }
     return metricsJson;
@@ -0,0 +1,147 @@
+#include "../include/rendezvous_store.h"
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+// Holds an flock() on the store's lock file for one operation
+class StoreLock {
+public:
+    StoreLock(int fd, int operation) : m_fd(fd) {
+        while (flock(m_fd, operation) != 0) {
+            if (errno != EINTR) {
+                throw std::runtime_error("Cannot lock rendezvous store");
+            }
+        }
+    }
+    ~StoreLock() { flock(m_fd, LOCK_UN); }
+
+    StoreLock(const StoreLock&) = delete;
+    StoreLock& operator=(const StoreLock&) = delete;
+
+private:
+    int m_fd;
+};
+
+bool isSafeKey(const std::string& key) {
+    if (key.empty() || key[0] == '.') {
+        return false;
+    }
+    for (char c : key) {
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                    c == '_' || c == '-' || c == '.';
+        if (!safe) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+FileRendezvousStore::FileRendezvousStore(const std::string& directory)
+    : m_directory(directory),
+      m_lockFd(-1) {
+
+    if (mkdir(m_directory.c_str(), 0775) != 0 && errno != EEXIST) {
+        BOOST_LOG_TRIVIAL(error) << "Cannot create rendezvous directory " << m_directory;
+        throw std::runtime_error("Cannot create rendezvous directory: " + m_directory);
+    }
+
+    std::string lockPath = m_directory + "/.lock";
+    m_lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0664);
+    if (m_lockFd < 0) {
+        BOOST_LOG_TRIVIAL(error) << "Cannot open rendezvous lock file " << lockPath;
+        throw std::runtime_error("Cannot open rendezvous store: " + m_directory);
+    }
+}
+
+FileRendezvousStore::~FileRendezvousStore() {
+    if (m_lockFd >= 0) {
+        close(m_lockFd);
+    }
+}
+
+std::string FileRendezvousStore::pathOf(const std::string& key) const {
+    if (!isSafeKey(key)) {
+        throw std::invalid_argument("Invalid rendezvous key: " + key);
+    }
+    return m_directory + "/" + key;
+}
+
+std::optional<std::string> FileRendezvousStore::read(const std::string& key) const {
+    std::ifstream stream(pathOf(key), std::ios::binary);
+    if (!stream) {
+        return std::nullopt;
+    }
+    std::ostringstream value;
+    value << stream.rdbuf();
+    return value.str();
+}
+
+void FileRendezvousStore::write(const std::string& key, const std::string& value) {
+    // Write beside the key and rename over it, so the value appears whole
+    const std::string path = pathOf(key);
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+        stream << value;
+        if (!stream.flush()) {
+            throw std::runtime_error("Cannot write rendezvous key: " + key);
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot write rendezvous key: " + key);
+    }
+}
+
+void FileRendezvousStore::set(const std::string& key, const std::string& value) {
+    StoreLock lock(m_lockFd, LOCK_EX);
+    write(key, value);
+}
+
+std::optional<std::string> FileRendezvousStore::get(const std::string& key) const {
+    StoreLock lock(m_lockFd, LOCK_SH);
+    return read(key);
+}
+
+bool FileRendezvousStore::setIfAbsent(const std::string& key, const std::string& value) {
+    StoreLock lock(m_lockFd, LOCK_EX);
+    if (read(key)) {
+        return false;
+    }
+    write(key, value);
+    return true;
+}
+
+int64_t FileRendezvousStore::add(const std::string& key, int64_t delta) {
+    StoreLock lock(m_lockFd, LOCK_EX);
+    int64_t value = 0;
+    if (auto current = read(key)) {
+        try {
+            value = std::stoll(*current);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Rendezvous key is not an integer: " + key);
+        }
+    }
+    value += delta;
+    write(key, std::to_string(value));
+    return value;
+}
+
+void FileRendezvousStore::remove(const std::string& key) {
+    StoreLock lock(m_lockFd, LOCK_EX);
+    std::remove(pathOf(key).c_str());
+}
+
+} // namespace DistributedML
@@ -0,0 +1,253 @@
+#include "../include/result_sink.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+constexpr int kResultRequestTag = 7401;
+constexpr int kResultChunkTag = 7402;
+
+ResultFileHeader resultHeader(Eigen::Index rows, Eigen::Index cols) {
+    ResultFileHeader header{};
+    std::memcpy(header.magic, kResultMagic, sizeof(kResultMagic));
+    header.version = kResultVersion;
+    header.headerBytes = sizeof(ResultFileHeader);
+    header.rows = static_cast<uint64_t>(rows);
+    header.cols = static_cast<uint64_t>(cols);
+    return header;
+}
+
+} // namespace
+
+void MatrixResultSink::begin(Eigen::Index rows, Eigen::Index cols) {
+    m_result.resize(rows, cols);
+}
+
+void MatrixResultSink::write(Eigen::Index firstRow, const double* rows, Eigen::Index count) {
+    using RowMajorMap = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+    m_result.middleRows(firstRow, count) = RowMajorMap(rows, count, m_result.cols());
+}
+
+MappedFileResultSink::MappedFileResultSink(const std::string& path)
+    : m_path(path),
+      m_mapping(MAP_FAILED),
+      m_mappingBytes(0),
+      m_fd(-1),
+      m_rows(nullptr) {
+}
+
+MappedFileResultSink::~MappedFileResultSink() {
+    unmap();
+}
+
+void MappedFileResultSink::unmap() {
+    if (m_mapping != MAP_FAILED) {
+        ::munmap(m_mapping, m_mappingBytes);
+        m_mapping = MAP_FAILED;
+        m_rows = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_flushingBegin = m_flushingEnd = 0;
+}
+
+void MappedFileResultSink::begin(Eigen::Index rows, Eigen::Index cols) {
+    unmap();
+
+    // The descriptor stays open to drive write-back of each chunk
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        BOOST_LOG_TRIVIAL(error) << "Cannot open result file " << m_path;
+        throw std::runtime_error("Cannot open result file: " + m_path);
+    }
+
+    m_mappingBytes = sizeof(ResultFileHeader) + static_cast<size_t>(rows) * static_cast<size_t>(cols) * sizeof(double);
+    if (::ftruncate(m_fd, static_cast<off_t>(m_mappingBytes)) != 0) {
+        unmap();
+        throw std::runtime_error("Cannot size result file: " + m_path);
+    }
+    m_mapping = ::mmap(nullptr, m_mappingBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_mapping == MAP_FAILED) {
+        unmap();
+        throw std::runtime_error("Cannot map result file: " + m_path);
+    }
+
+    ResultFileHeader header = resultHeader(rows, cols);
+    std::memcpy(m_mapping, &header, sizeof(header));
+    m_rows = reinterpret_cast<double*>(static_cast<char*>(m_mapping) + sizeof(ResultFileHeader));
+    m_rowCount = rows;
+    m_cols = cols;
+}
+
+void MappedFileResultSink::write(Eigen::Index firstRow, const double* rows, Eigen::Index count) {
+    if (!m_rows || firstRow < 0 || count < 0 || firstRow + count > m_rowCount) {
+        throw std::out_of_range("Result rows outside the mapped file");
+    }
+    double* target = m_rows + firstRow * m_cols;
+    const size_t bytes = static_cast<size_t>(count * m_cols) * sizeof(double);
+    std::memcpy(target, rows, bytes);
+
+    // Start write-back of this chunk (msync with MS_ASYNC does not on
+    // Linux), then wait for the previous chunk's and drop its clean pages,
+    // so at most two chunks are ever dirty or resident
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char* base = static_cast<char*>(m_mapping);
+    const size_t begin = static_cast<size_t>(reinterpret_cast<char*>(target) - base) / page * page;
+    const size_t end = static_cast<size_t>(reinterpret_cast<char*>(target) - base) + bytes;
+    ::sync_file_range(m_fd, static_cast<off_t>(begin), static_cast<off_t>(end - begin), SYNC_FILE_RANGE_WRITE);
+
+    if (m_flushingEnd > m_flushingBegin) {
+        const off_t flushed = static_cast<off_t>(m_flushingBegin);
+        const off_t length = static_cast<off_t>(m_flushingEnd - m_flushingBegin);
+        ::sync_file_range(m_fd, flushed, length,
+                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        // Unmapping first lets the page cache drop them; a page shared
+        // with the current chunk stays because it is dirty again
+        ::madvise(base + m_flushingBegin, m_flushingEnd - m_flushingBegin, MADV_DONTNEED);
+        ::posix_fadvise(m_fd, flushed, length, POSIX_FADV_DONTNEED);
+    }
+    m_flushingBegin = begin;
+    m_flushingEnd = end;
+}
+
+void MappedFileResultSink::finish() {
+    if (m_mapping == MAP_FAILED) {
+        return;
+    }
+    int result = ::msync(m_mapping, m_mappingBytes, MS_SYNC);
+    unmap();
+    if (result != 0) {
+        throw std::runtime_error("Failed to write result file: " + m_path);
+    }
+    BOOST_LOG_TRIVIAL(info) << "Wrote " << m_rowCount << " result rows to " << m_path;
+}
+
+void StreamResultSink::begin(Eigen::Index rows, Eigen::Index cols) {
+    ResultFileHeader header = resultHeader(rows, cols);
+    m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_cols = cols;
+    m_nextRow = 0;
+}
+
+void StreamResultSink::write(Eigen::Index firstRow, const double* rows, Eigen::Index count) {
+    if (firstRow != m_nextRow) {
+        throw std::logic_error("Stream result sink needs rows in order");
+    }
+    m_stream.write(reinterpret_cast<const char*>(rows),
+                   static_cast<std::streamsize>(count * m_cols * static_cast<Eigen::Index>(sizeof(double))));
+    if (!m_stream) {
+        throw std::runtime_error("Failed to write result rows");
+    }
+    m_nextRow += count;
+}
+
+void StreamResultSink::finish() {
+    m_stream.flush();
+    if (!m_stream) {
+        throw std::runtime_error("Failed to write result rows");
+    }
+}
+
+void gatherResults(MPI_Comm communicator, Eigen::Index localRows, Eigen::Index cols,
+                   const ResultProducer& produce, ResultSink* sink, Eigen::Index chunkRows) {
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(communicator, &rank);
+    MPI_Comm_size(communicator, &size);
+    if (chunkRows <= 0 || cols <= 0 || (rank == 0 && !sink)) {
+        throw std::invalid_argument("Result gather needs a positive chunk and width, and a sink on rank 0");
+    }
+
+    // Every chunk travels as one message
+    chunkRows = std::min<Eigen::Index>(chunkRows, std::numeric_limits<int>::max() / cols);
+
+    long long rowCount = localRows;
+    std::vector<long long> counts(rank == 0 ? size : 0);
+    MPI_Gather(&rowCount, 1, MPI_LONG_LONG, counts.data(), 1, MPI_LONG_LONG, 0, communicator);
+
+    // Two chunk buffers: one in flight while the other is produced or written
+    Eigen::Index largest = rank == 0 ? *std::max_element(counts.begin(), counts.end()) : localRows;
+    std::vector<double> buffers[2];
+    for (auto& buffer : buffers) {
+        buffer.resize(static_cast<size_t>(std::min(chunkRows, largest) * cols));
+    }
+    auto chunkSize = [chunkRows](Eigen::Index rows, Eigen::Index chunk) {
+        return std::min(chunkRows, rows - chunk * chunkRows);
+    };
+
+    if (rank != 0) {
+        if (localRows == 0) {
+            return;
+        }
+        MPI_Recv(nullptr, 0, MPI_INT, 0, kResultRequestTag, communicator, MPI_STATUS_IGNORE);
+
+        MPI_Request sends[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+        const Eigen::Index chunks = (localRows + chunkRows - 1) / chunkRows;
+        for (Eigen::Index chunk = 0; chunk < chunks; ++chunk) {
+            const Eigen::Index count = chunkSize(localRows, chunk);
+            const size_t slot = static_cast<size_t>(chunk % 2);
+            MPI_Wait(&sends[slot], MPI_STATUS_IGNORE);
+            produce(chunk * chunkRows, count, buffers[slot].data());
+            MPI_Isend(buffers[slot].data(), static_cast<int>(count * cols), MPI_DOUBLE, 0, kResultChunkTag,
+                      communicator, &sends[slot]);
+        }
+        MPI_Waitall(2, sends, MPI_STATUSES_IGNORE);
+        return;
+    }
+
+    Eigen::Index total = 0;
+    for (long long count : counts) {
+        total += count;
+    }
+    sink->begin(total, cols);
+
+    // Rank 0's own rows go straight to the sink
+    Eigen::Index offset = 0;
+    for (Eigen::Index first = 0; first < localRows; first += chunkRows) {
+        const Eigen::Index count = std::min(chunkRows, localRows - first);
+        produce(first, count, buffers[0].data());
+        sink->write(first, buffers[0].data(), count);
+    }
+    offset += localRows;
+
+    for (int source = 1; source < size; ++source) {
+        const Eigen::Index rows = counts[source];
+        if (rows == 0) {
+            continue;
+        }
+        MPI_Send(nullptr, 0, MPI_INT, source, kResultRequestTag, communicator);
+
+        MPI_Request receives[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+        auto post = [&](Eigen::Index chunk) {
+            const size_t slot = static_cast<size_t>(chunk % 2);
+            MPI_Irecv(buffers[slot].data(), static_cast<int>(chunkSize(rows, chunk) * cols), MPI_DOUBLE, source,
+                      kResultChunkTag, communicator, &receives[slot]);
+        };
+
+        const Eigen::Index chunks = (rows + chunkRows - 1) / chunkRows;
+        post(0);
+        for (Eigen::Index chunk = 0; chunk < chunks; ++chunk) {
+            if (chunk + 1 < chunks) {
+                post(chunk + 1);
+            }
+            const size_t slot = static_cast<size_t>(chunk % 2);
+            MPI_Wait(&receives[slot], MPI_STATUS_IGNORE);
+            sink->write(offset + chunk * chunkRows, buffers[slot].data(), chunkSize(rows, chunk));
+        }
+        offset += rows;
+    }
+    sink->finish();
+}
+
+} // namespace DistributedML
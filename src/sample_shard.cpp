@@ -0,0 +1,212 @@
+#include "../include/sample_shard.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+ShardWriter::ShardWriter(const std::string& path, int rows, int cols, int channels)
+    : m_stream(path, std::ios::binary | std::ios::trunc),
+      m_header{},
+      m_finished(false) {
+
+    if (!m_stream) {
+        throw std::runtime_error("Cannot open shard for writing: " + path);
+    }
+    if (rows <= 0 || cols <= 0 || channels <= 0) {
+        throw std::invalid_argument("Shard sample dimensions must be positive");
+    }
+
+    size_t sampleFloats = static_cast<size_t>(rows) * cols * channels;
+
+    std::memcpy(m_header.magic, kShardMagic, sizeof(kShardMagic));
+    m_header.version = kShardVersion;
+    m_header.headerBytes = sizeof(ShardHeader);
+    m_header.rows = static_cast<uint32_t>(rows);
+    m_header.cols = static_cast<uint32_t>(cols);
+    m_header.channels = static_cast<uint32_t>(channels);
+    m_header.strideFloats = static_cast<uint32_t>(alignUp(sampleFloats, kShardAlignment / sizeof(float)));
+    m_header.dataOffset = alignUp(sizeof(ShardHeader), kShardAlignment);
+
+    m_scratch.assign(m_header.strideFloats, 0.0f);
+
+    // Reserve the header area; the real header is written by finish()
+    std::vector<char> preamble(m_header.dataOffset, 0);
+    m_stream.write(preamble.data(), preamble.size());
+}
+
+ShardWriter::~ShardWriter() {
+    try {
+        finish();
+    } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to finalize shard: " << e.what();
+    }
+}
+
+void ShardWriter::append(const cv::Mat& sample, int label) {
+    if (m_finished) {
+        throw std::logic_error("Shard is already finished");
+    }
+    if (sample.rows != static_cast<int>(m_header.rows) ||
+        sample.cols != static_cast<int>(m_header.cols) ||
+        sample.channels() != static_cast<int>(m_header.channels)) {
+        throw std::invalid_argument("Sample shape does not match shard");
+    }
+
+    cv::Mat converted;
+    sample.convertTo(converted, CV_32FC(m_header.channels));
+    if (!converted.isContinuous()) {
+        converted = converted.clone();
+    }
+
+    size_t sampleFloats = static_cast<size_t>(m_header.rows) * m_header.cols * m_header.channels;
+    std::copy(converted.ptr<float>(0), converted.ptr<float>(0) + sampleFloats, m_scratch.begin());
+    m_stream.write(reinterpret_cast<const char*>(m_scratch.data()), m_scratch.size() * sizeof(float));
+    if (!m_stream) {
+        throw std::runtime_error("Failed to write shard sample");
+    }
+
+    m_index.push_back({label, 0});
+    ++m_header.sampleCount;
+}
+
+void ShardWriter::finish() {
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+
+    m_header.indexOffset = m_header.dataOffset +
+        m_header.sampleCount * m_header.strideFloats * sizeof(float);
+    m_stream.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(ShardIndexEntry));
+
+    m_stream.seekp(0);
+    m_stream.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_stream.close();
+    if (!m_stream) {
+        throw std::runtime_error("Failed to finalize shard");
+    }
+}
+
+ShardReader::ShardReader(const std::string& path)
+    : m_path(path),
+      m_mapping(MAP_FAILED),
+      m_mappingBytes(0),
+      m_header(nullptr),
+      m_data(nullptr),
+      m_index(nullptr) {
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        BOOST_LOG_TRIVIAL(error) << "Cannot open shard " << path;
+        throw std::runtime_error("Cannot open shard: " + path);
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ShardHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Shard is truncated: " + path);
+    }
+
+    m_mappingBytes = static_cast<size_t>(info.st_size);
+    m_mapping = ::mmap(nullptr, m_mappingBytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map shard: " + path);
+    }
+
+    m_header = static_cast<const ShardHeader*>(m_mapping);
+    const char* base = static_cast<const char*>(m_mapping);
+
+    // The header is untrusted: bound every size by division before any
+    // product, so a crafted count cannot wrap and pass. The shape product
+    // stays below 2^64: rows * cols is checked against the 32-bit stride
+    // before channels multiplies it.
+    const ShardHeader& header = *m_header;
+    const uint64_t strideBytes = static_cast<uint64_t>(header.strideFloats) * sizeof(float);
+    bool valid = std::memcmp(header.magic, kShardMagic, sizeof(kShardMagic)) == 0 &&
+                 header.version == kShardVersion &&
+                 header.headerBytes == sizeof(ShardHeader) &&
+                 header.dataOffset >= sizeof(ShardHeader) && header.dataOffset % kShardAlignment == 0 &&
+                 header.rows > 0 && header.cols > 0 && header.channels > 0 && header.strideFloats > 0 &&
+                 static_cast<uint64_t>(header.rows) * header.cols <= header.strideFloats &&
+                 static_cast<uint64_t>(header.rows) * header.cols * header.channels <= header.strideFloats &&
+                 header.dataOffset <= header.indexOffset &&
+                 header.indexOffset <= m_mappingBytes &&
+                 header.sampleCount <= (header.indexOffset - header.dataOffset) / strideBytes &&
+                 header.sampleCount <= (m_mappingBytes - header.indexOffset) / sizeof(ShardIndexEntry);
+    if (!valid) {
+        ::munmap(m_mapping, m_mappingBytes);
+        BOOST_LOG_TRIVIAL(error) << "Invalid shard header in " << path;
+        throw std::runtime_error("Invalid shard: " + path);
+    }
+
+    m_data = reinterpret_cast<const float*>(base + m_header->dataOffset);
+    m_index = reinterpret_cast<const ShardIndexEntry*>(base + m_header->indexOffset);
+
+    // Labels index the output layer, so a negative one would read out of bounds
+    for (uint64_t i = 0; i < header.sampleCount; ++i) {
+        if (m_index[i].label < 0) {
+            BOOST_LOG_TRIVIAL(error) << "Negative label " << m_index[i].label
+                                     << " at sample " << i << " in " << path;
+            ::munmap(m_mapping, m_mappingBytes);
+            throw std::runtime_error("Invalid shard label: " + path);
+        }
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Mapped shard " << path << " with "
+                             << m_header->sampleCount << " samples";
+}
+
+ShardReader::~ShardReader() {
+    if (m_mapping != MAP_FAILED) {
+        ::munmap(m_mapping, m_mappingBytes);
+    }
+}
+
+const float* ShardReader::sample(size_t index) const {
+    return m_data + index * m_header->strideFloats;
+}
+
+int ShardReader::label(size_t index) const {
+    return m_index[index].label;
+}
+
+std::pair<size_t, size_t> ShardReader::partition(int rank, int worldSize) const {
+    size_t total = sampleCount();
+    size_t perNode = total / worldSize;
+    size_t remainder = total % worldSize;
+    size_t node = static_cast<size_t>(rank);
+
+    size_t begin = node * perNode + std::min(node, remainder);
+    size_t end = begin + perNode + (node < remainder ? 1 : 0);
+    return {begin, end};
+}
+
+void ShardReader::prefetch(size_t begin, size_t end) const {
+    if (begin >= end) {
+        return;
+    }
+
+    // madvise needs a page-aligned start address
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(sample(begin));
+    uintptr_t last = reinterpret_cast<uintptr_t>(sample(end));
+    uintptr_t alignedFirst = first / pageSize * pageSize;
+    ::madvise(reinterpret_cast<void*>(alignedFirst), last - alignedFirst, MADV_WILLNEED);
+}
+
+} // namespace DistributedML
@@ -0,0 +1,75 @@
+#include "../include/step_arena.h"
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace DistributedML {
+
+namespace {
+
+// Smallest block worth taking from the heap
+constexpr std::size_t kMinimumBlockBytes = 64 * 1024;
+
+std::size_t alignUp(std::size_t bytes) {
+    return (bytes + StepArena::kAlignment - 1) / StepArena::kAlignment * StepArena::kAlignment;
+}
+
+} // namespace
+
+StepArena::StepArena(std::size_t initialBytes) {
+    if (initialBytes > 0) {
+        addBlock(initialBytes);
+    }
+}
+
+void* StepArena::allocate(std::size_t bytes) {
+    bytes = alignUp(bytes);
+    while (m_current >= m_blocks.size() || m_offset + bytes > m_blocks[m_current].size) {
+        if (m_current + 1 < m_blocks.size()) {
+            ++m_current;
+        } else {
+            // Grow geometrically so an outgrown step chains few blocks
+            addBlock(std::max(bytes, capacity()));
+            m_current = m_blocks.size() - 1;
+        }
+        m_offset = 0;
+    }
+
+    void* pointer = m_blocks[m_current].data.get() + m_offset;
+    m_offset += bytes;
+    m_used += bytes;
+    m_highWater = std::max(m_highWater, m_used);
+    return pointer;
+}
+
+void StepArena::reset() {
+    // Fold a chain of blocks into one that fits the busiest step
+    if (m_blocks.size() > 1) {
+        m_blocks.clear();
+        addBlock(m_highWater);
+    }
+    m_current = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+std::size_t StepArena::capacity() const {
+    std::size_t total = 0;
+    for (const Block& block : m_blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+void StepArena::addBlock(std::size_t minimumBytes) {
+    Block block;
+    block.size = alignUp(std::max(minimumBytes, kMinimumBlockBytes));
+    block.data.reset(static_cast<unsigned char*>(std::aligned_alloc(kAlignment, block.size)));
+    if (!block.data) {
+        throw std::bad_alloc();
+    }
+    m_blocks.push_back(std::move(block));
+    ++m_blockAllocations;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,267 @@
+#include "../include/task_executor.h"
+#include <algorithm>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+double TaskContext::progress() const {
+    uint64_t total = totalSteps();
+    if (total == 0) {
+        return 0.0;
+    }
+    return 100.0 * static_cast<double>(std::min(stepsDone(), total)) / static_cast<double>(total);
+}
+
+bool TaskExecutor::JobOrder::operator()(const JobPtr& a, const JobPtr& b) const {
+    if (a->options.priority != b->options.priority) {
+        return a->options.priority < b->options.priority;
+    }
+    if (a->options.deadline != b->options.deadline) {
+        return a->options.deadline > b->options.deadline;
+    }
+    return a->sequence > b->sequence;
+}
+
+TaskExecutor::TaskExecutor(TaskManager& tasks, size_t workers, size_t maxQueued,
+                           std::chrono::milliseconds publishInterval)
+    : m_tasks(tasks),
+      m_maxQueued(std::max<size_t>(1, maxQueued)),
+      m_publishInterval(publishInterval) {
+
+    workers = std::max<size_t>(1, workers);
+    m_workers.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+        m_workers.emplace_back([this]() { workerLoop(); });
+    }
+    m_publisher = std::thread([this]() { publisherLoop(); });
+}
+
+TaskExecutor::~TaskExecutor() {
+    std::vector<JobPtr> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        for (auto& [id, job] : m_jobs) {
+            job->context.cancel();
+            if (!job->running) {
+                abandoned.push_back(job);
+            }
+        }
+        for (const auto& job : abandoned) {
+            m_jobs.erase(job->context.taskId());
+        }
+        m_queue = {};
+        m_queued = 0;
+    }
+    for (const auto& job : abandoned) {
+        m_tasks.updateTaskStatus(job->context.taskId(), TaskStatus::CANCELLED);
+    }
+
+    m_workAvailable.notify_all();
+    m_publisherWake.notify_all();
+    m_jobFinished.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_publisher.join();
+}
+
+std::string TaskExecutor::submit(const std::string& type, const nlohmann::json& metadata, TaskFunction fn,
+                                 const TaskOptions& options) {
+    // Reserve a queue slot first so a full queue creates no task
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping || m_queued >= m_maxQueued) {
+            BOOST_LOG_TRIVIAL(warning) << "Task queue full, rejecting " << type << " task";
+            return "";
+        }
+        ++m_queued;
+    }
+
+    std::string taskId = m_tasks.addTask(type, metadata);
+    auto job = std::make_shared<Job>(taskId);
+    job->function = std::move(fn);
+    job->options = options;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job->sequence = ++m_sequence;
+        m_jobs.emplace(taskId, job);
+        m_queue.push(job);
+    }
+    m_workAvailable.notify_one();
+    return taskId;
+}
+
+std::string TaskExecutor::submit(const std::string& type, const nlohmann::json& metadata, const TaskOptions& options) {
+    TaskFunction handler;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_handlers.find(type);
+        if (it == m_handlers.end()) {
+            BOOST_LOG_TRIVIAL(error) << "No handler registered for task type " << type;
+            throw std::invalid_argument("Unknown task type: " + type);
+        }
+        handler = it->second;
+    }
+    return submit(type, metadata, std::move(handler), options);
+}
+
+void TaskExecutor::registerHandler(const std::string& type, TaskFunction handler) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_handlers[type] = std::move(handler);
+}
+
+bool TaskExecutor::hasHandler(const std::string& type) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_handlers.count(type) > 0;
+}
+
+bool TaskExecutor::cancel(const std::string& taskId) {
+    JobPtr job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(taskId);
+        if (it == m_jobs.end()) {
+            return false;
+        }
+        job = it->second;
+        job->context.cancel();
+        if (job->running) {
+            // The task sees the flag and finishes as cancelled
+            return true;
+        }
+
+        // Queued: the worker that pops it skips it
+        m_jobs.erase(it);
+        --m_queued;
+    }
+
+    m_tasks.updateTaskStatus(taskId, TaskStatus::CANCELLED);
+    m_jobFinished.notify_all();
+    return true;
+}
+
+TaskStatus TaskExecutor::wait(const std::string& taskId) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobFinished.wait(lock, [this, &taskId]() { return m_jobs.count(taskId) == 0; });
+    }
+    TaskManager::TaskPtr task = m_tasks.findTask(taskId);
+    return task ? task->status : TaskStatus::FAILED;
+}
+
+size_t TaskExecutor::queuedTasks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queued;
+}
+
+size_t TaskExecutor::runningTasks() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+void TaskExecutor::workerLoop() {
+    while (true) {
+        JobPtr job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = m_queue.top();
+            m_queue.pop();
+            if (job->context.cancelled()) {
+                // Cancelled while queued; already accounted for
+                continue;
+            }
+            --m_queued;
+
+            if (std::chrono::steady_clock::now() > job->options.deadline) {
+                lock.unlock();
+                finish(job, TaskStatus::FAILED, "deadline passed before the task started");
+                continue;
+            }
+            job->running = true;
+            ++m_running;
+        }
+
+        m_tasks.updateTaskStatus(job->context.taskId(), TaskStatus::RUNNING);
+        TaskStatus status = TaskStatus::COMPLETED;
+        std::string error;
+        try {
+            job->function(job->context);
+            if (job->context.cancelled()) {
+                status = TaskStatus::CANCELLED;
+            }
+        } catch (const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Task " << job->context.taskId() << " failed: " << e.what();
+            status = TaskStatus::FAILED;
+            error = e.what();
+        } catch (...) {
+            BOOST_LOG_TRIVIAL(error) << "Task " << job->context.taskId() << " failed";
+            status = TaskStatus::FAILED;
+            error = "unknown error";
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_running;
+        }
+        finish(job, status, error);
+    }
+}
+
+void TaskExecutor::publisherLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        m_publisherWake.wait_for(lock, m_publishInterval, [this]() { return m_stopping; });
+
+        std::vector<JobPtr> running;
+        for (const auto& [id, job] : m_jobs) {
+            if (job->running) {
+                running.push_back(job);
+            }
+        }
+
+        lock.unlock();
+        for (const auto& job : running) {
+            // A job may finish after it was collected; its final update wins
+            std::lock_guard<std::mutex> publishLock(job->publishMutex);
+            if (!job->finished) {
+                publishProgress(*job);
+            }
+        }
+        lock.lock();
+    }
+}
+
+void TaskExecutor::publishProgress(const Job& job, const nlohmann::json& extra) {
+    const TaskContext& context = job.context;
+    nlohmann::json execution = {
+        {"steps_done", context.stepsDone()},
+        {"total_steps", context.totalSteps()},
+        {"epochs_done", context.epochsDone()},
+        {"priority", job.options.priority}
+    };
+    execution.update(extra);
+    m_tasks.updateTaskProgress(context.taskId(), context.progress(), execution);
+}
+
+void TaskExecutor::finish(const JobPtr& job, TaskStatus status, const std::string& error) {
+    {
+        std::lock_guard<std::mutex> publishLock(job->publishMutex);
+        job->finished = true;
+        publishProgress(*job, error.empty() ? nlohmann::json::object() : nlohmann::json{{"error", error}});
+        m_tasks.updateTaskStatus(job->context.taskId(), status);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.erase(job->context.taskId());
+    }
+    m_jobFinished.notify_all();
+}
+
+} // namespace DistributedML
@@ -4,50 +4,233 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <limits>
 #include <algorithm>
 #include <iostream>
 
 namespace DistributedML {
 
+namespace {
+
+const char kTaskIdPrefix[] = "task_";
+
+} // namespace
+
+uint64_t TaskManager::sequenceOf(const std::string& taskId) {
+    constexpr size_t prefixLength = sizeof(kTaskIdPrefix) - 1;
+    if (taskId.size() <= prefixLength || taskId.compare(0, prefixLength, kTaskIdPrefix) != 0) {
+        return 0;
+    }
+
+    uint64_t sequence = 0;
+    for (size_t i = prefixLength; i < taskId.size(); ++i) {
+        char digit = taskId[i];
+        if (digit < '0' || digit > '9' || sequence > std::numeric_limits<uint64_t>::max() / 10) {
+            return 0;
+        }
+        sequence = sequence * 10 + static_cast<uint64_t>(digit - '0');
+    }
+    return sequence;
+}
+
 std::string TaskManager::addTask(const std::string& taskType, const nlohmann::json& metadata) {
-    std::lock_guard<std::mutex> lock(m_taskMutex);
-    
-    Task newTask;
-    newTask.id = "task_" + std::to_string(++m_taskCounter);
-    newTask.type = taskType;
-    newTask.status = TaskStatus::PENDING;
-    newTask.metadata = metadata;
-    newTask.progress = 0.0;
+    const uint64_t sequence = ++m_taskCounter;
+
+    // Build the snapshot before taking the shard lock
+    auto newTask = std::make_shared<Task>();
+    newTask->id = kTaskIdPrefix + std::to_string(sequence);
+    newTask->type = taskType;
+    newTask->status = TaskStatus::PENDING;
+    newTask->metadata = metadata;
+    newTask->progress = 0.0;
+    std::string taskId = newTask->id;
 
-    m_tasks.push_back(std::move(newTask));
-    return m_tasks.back().id;
+    Shard& shard = shardOf(sequence);
+    const size_t slot = slotOf(sequence);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (shard.tasks.size() <= slot) {
+        shard.tasks.resize(slot + 1);
+    }
+    shard.tasks[slot] = std::move(newTask);
+    shard.byStatus[static_cast<size_t>(TaskStatus::PENDING)].insert(sequence);
+    shard.byType[taskType].insert(sequence);
+    while (shard.filledSlots < shard.tasks.size() && shard.tasks[shard.filledSlots]) {
+        ++shard.filledSlots;
+    }
+    m_version.fetch_add(1, std::memory_order_release);
+    return taskId;
 }
 
-void TaskManager::updateTaskStatus(const std::string& taskId, TaskStatus status) {
-    std::lock_guard<std::mutex> lock(m_taskMutex);
-    
-    auto it = std::find_if(m_tasks.begin(), m_tasks.end(), 
-        [&taskId](const Task& task) { return task.id == taskId; });
-    
-    if (it != m_tasks.end()) {
-        it->status = status;
-        it->progress = (status == TaskStatus::COMPLETED) ? 100.0 : 
-                       (status == TaskStatus::RUNNING) ? 50.0 : 0.0;
+void TaskManager::replaceTask(const std::string& taskId, const std::function<void(Task&)>& update) {
+    const uint64_t sequence = sequenceOf(taskId);
+    if (sequence == 0 || sequence > m_taskCounter.load()) {
+        return;
     }
+    Shard& shard = shardOf(sequence);
+    const size_t slot = slotOf(sequence);
+
+    // Copy-on-write: the new snapshot is built outside the lock and only
+    // published if no other update replaced the task in the meantime
+    while (true) {
+        TaskPtr current;
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            if (slot < shard.tasks.size()) {
+                current = shard.tasks[slot];
+            }
+        }
+        if (!current) {
+            return;
+        }
+
+        auto updated = std::make_shared<Task>(*current);
+        update(*updated);
+
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (shard.tasks[slot] != current) {
+            continue;
+        }
+        if (updated->status != current->status) {
+            shard.byStatus[static_cast<size_t>(current->status)].erase(sequence);
+            shard.byStatus[static_cast<size_t>(updated->status)].insert(sequence);
+        }
+        shard.tasks[slot] = std::move(updated);
+        m_version.fetch_add(1, std::memory_order_release);
+        return;
+    }
+}
+
+void TaskManager::updateTaskStatus(const std::string& taskId, TaskStatus status) {
+    replaceTask(taskId, [status](Task& task) {
+        task.status = status;
+        if (status == TaskStatus::COMPLETED) {
+            task.progress = 100.0;
+        }
+    });
+}
+
+void TaskManager::updateTaskProgress(const std::string& taskId, double progress, const nlohmann::json& execution) {
+    replaceTask(taskId, [progress, &execution](Task& task) {
+        task.progress = std::clamp(progress, 0.0, 100.0);
+        if (!task.metadata.is_object()) {
+            task.metadata = nlohmann::json::object();
+        }
+        task.metadata["execution"] = execution;
+    });
+}
+
+std::vector<TaskManager::TaskPtr> TaskManager::getAllTasks() const {
+    TaskQuery query;
+    query.limit = std::numeric_limits<size_t>::max();
+    return listTasks(query).tasks;
 }
 
-std::vector<TaskManager::Task> TaskManager::getAllTasks() const {
-    std::lock_guard<std::mutex> lock(m_taskMutex);
-    return m_tasks;
+TaskManager::TaskPtr TaskManager::findTask(const std::string& taskId) const {
+    const uint64_t sequence = sequenceOf(taskId);
+    if (sequence == 0) {
+        return nullptr;
+    }
+
+    const Shard& shard = shardOf(sequence);
+    const size_t slot = slotOf(sequence);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return slot < shard.tasks.size() ? shard.tasks[slot] : nullptr;
 }
 
 TaskManager::Task TaskManager::getTaskById(const std::string& taskId) const {
-    std::lock_guard<std::mutex> lock(m_taskMutex);
-    
-    auto it = std::find_if(m_tasks.begin(), m_tasks.end(), 
-        [&taskId](const Task& task) { return task.id == taskId; });
-    
-    return (it != m_tasks.end()) ? *it : Task{};
+    TaskPtr task = findTask(taskId);
+    return task ? *task : Task{};
+}
+
+void TaskManager::collectShard(size_t shardIndex, const TaskQuery& query, uint64_t committed, size_t limit,
+                               std::vector<std::pair<uint64_t, TaskPtr>>& output) const {
+    const Shard& shard = m_shards[shardIndex];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+    auto matches = [&query](const Task& task) {
+        return (!query.status || task.status == *query.status) &&
+               (!query.type || task.type == *query.type);
+    };
+
+    // Walk the smallest index that covers the filter
+    const std::set<uint64_t>* index = nullptr;
+    if (query.status) {
+        index = &shard.byStatus[static_cast<size_t>(*query.status)];
+    }
+    if (query.type) {
+        auto it = shard.byType.find(*query.type);
+        if (it == shard.byType.end()) {
+            return;
+        }
+        if (!index || it->second.size() < index->size()) {
+            index = &it->second;
+        }
+    }
+
+    size_t taken = 0;
+    if (index) {
+        for (auto it = index->upper_bound(query.cursor);
+             it != index->end() && *it <= committed && taken < limit; ++it) {
+            const TaskPtr& task = shard.tasks[slotOf(*it)];
+            if (matches(*task)) {
+                output.emplace_back(*it, task);
+                ++taken;
+            }
+        }
+        return;
+    }
+
+    // Unfiltered: slots are already in sequence order
+    const uint64_t first = shardIndex + 1;
+    size_t slot = query.cursor < first ? 0 : static_cast<size_t>((query.cursor - first) / kShardCount + 1);
+    for (; slot < shard.tasks.size() && slot * kShardCount + first <= committed && taken < limit; ++slot) {
+        if (shard.tasks[slot]) {
+            output.emplace_back(slot * kShardCount + first, shard.tasks[slot]);
+            ++taken;
+        }
+    }
+}
+
+TaskManager::TaskPage TaskManager::listTasks(const TaskQuery& query) const {
+    // One extra match per shard tells whether another page follows
+    const size_t limit = query.limit;
+    const size_t perShard = limit == std::numeric_limits<size_t>::max() ? limit : limit + 1;
+
+    // Stop below the oldest task an addTask is still publishing, so the
+    // cursor cannot move past it. Sequences are handed out before their
+    // slots fill, so reading the counter first bounds what can be missing.
+    uint64_t committed = m_taskCounter.load(std::memory_order_acquire);
+    for (size_t shard = 0; shard < kShardCount; ++shard) {
+        std::shared_lock<std::shared_mutex> lock(m_shards[shard].mutex);
+        const uint64_t firstUnfilled = m_shards[shard].filledSlots * kShardCount + shard + 1;
+        committed = std::min(committed, firstUnfilled - 1);
+    }
+
+    std::vector<std::pair<uint64_t, TaskPtr>> candidates;
+    for (size_t shard = 0; shard < kShardCount; ++shard) {
+        collectShard(shard, query, committed, perShard, candidates);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    TaskPage page;
+    page.hasMore = candidates.size() > limit;
+    const size_t count = std::min(candidates.size(), limit);
+    page.tasks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        page.tasks.push_back(std::move(candidates[i].second));
+    }
+    page.nextCursor = count > 0 ? candidates[count - 1].first : query.cursor;
+    return page;
+}
+
+size_t TaskManager::countTasks(TaskStatus status) const {
+    size_t count = 0;
+    for (const auto& shard : m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        count += shard.byStatus[static_cast<size_t>(status)].size();
+    }
+    return count;
 }
 
 } // namespace DistributedML
@@ -0,0 +1,162 @@
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+namespace DistributedML {
+
+ThreadPool::ThreadPool(size_t threads)
+    : m_pending(0),
+      m_stop(false),
+      m_utilizationStart(Clock::now()) {
+
+    if (threads == 0) {
+        throw std::invalid_argument("Thread pool needs at least one thread");
+    }
+
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+        m_workers.back()->tasks.reserve(64);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers[i]->thread = std::thread(&ThreadPool::run, this, i);
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Thread pool started with " << threads << " workers";
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop.store(true);
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+void ThreadPool::dispatch(Job& job, size_t count) {
+    // Deal contiguous index ranges to workers so neighbouring tasks share caches
+    const size_t workers = m_workers.size();
+    for (size_t w = 0; w < workers; ++w) {
+        size_t begin = count * w / workers;
+        size_t end = count * (w + 1) / workers;
+        if (begin == end) {
+            continue;
+        }
+
+        Worker& worker = *m_workers[w];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        for (size_t index = begin; index < end; ++index) {
+            worker.tasks.push_back({&job, index});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_pending.fetch_add(count, std::memory_order_release);
+    }
+    m_wake.notify_all();
+}
+
+bool ThreadPool::popLocal(size_t workerId, Task& task) {
+    Worker& worker = *m_workers[workerId];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.head == worker.tasks.size()) {
+        return false;
+    }
+
+    task = worker.tasks.back();
+    worker.tasks.pop_back();
+    if (worker.head == worker.tasks.size()) {
+        worker.tasks.clear();
+        worker.head = 0;
+    }
+    return true;
+}
+
+bool ThreadPool::steal(size_t thiefId, Task& task) {
+    const size_t workers = m_workers.size();
+    for (size_t offset = 1; offset < workers; ++offset) {
+        Worker& victim = *m_workers[(thiefId + offset) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.head == victim.tasks.size()) {
+            continue;
+        }
+
+        task = victim.tasks[victim.head++];
+        if (victim.head == victim.tasks.size()) {
+            victim.tasks.clear();
+            victim.head = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(const Task& task, size_t workerId) {
+    m_pending.fetch_sub(1, std::memory_order_acq_rel);
+
+    auto start = Clock::now();
+    try {
+        task.job->invoke(task.job->context, task.index, workerId);
+    } catch (...) {
+        // Keep the first failure for parallelFor; the job still counts down
+        if (!task.job->failed.exchange(true, std::memory_order_relaxed)) {
+            task.job->error = std::current_exception();
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    m_workers[workerId]->busyNanos.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+
+    // Last task of a job wakes the thread blocked in parallelFor
+    if (task.job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(m_doneMutex);
+        m_done.notify_all();
+    }
+}
+
+void ThreadPool::run(size_t workerId) {
+    Task task;
+    while (true) {
+        if (popLocal(workerId, task) || steal(workerId, task)) {
+            execute(task, workerId);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait(lock, [this]() {
+            return m_stop.load() || m_pending.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stop.load() && m_pending.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+std::vector<double> ThreadPool::utilization() const {
+    double wallNanos = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_utilizationStart).count());
+
+    std::vector<double> result;
+    result.reserve(m_workers.size());
+    for (const auto& worker : m_workers) {
+        double busy = static_cast<double>(worker->busyNanos.load(std::memory_order_relaxed));
+        result.push_back(wallNanos > 0.0 ? std::min(1.0, busy / wallNanos) : 0.0);
+    }
+    return result;
+}
+
+void ThreadPool::resetUtilization() {
+    for (auto& worker : m_workers) {
+        worker->busyNanos.store(0, std::memory_order_relaxed);
+    }
+    m_utilizationStart = Clock::now();
+}
+
+} // namespace DistributedML
@@ -0,0 +1,197 @@
+#include "../include/timeline_recorder.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <boost/log/trivial.hpp>
+#include <nlohmann/json.hpp>
+
+namespace DistributedML {
+
+namespace {
+
+constexpr int kClockSyncTag = 7301;
+
+using TimelineEvent = PerformanceTracker::TimelineEvent;
+
+} // namespace
+
+TimelineRecorder::TimelineRecorder(MPI_Comm communicator)
+    : m_communicator(communicator),
+      m_rank(0),
+      m_worldSize(1),
+      m_clockOffset(0),
+      m_roundTrip(0) {
+
+    MPI_Comm_rank(m_communicator, &m_rank);
+    MPI_Comm_size(m_communicator, &m_worldSize);
+}
+
+void TimelineRecorder::synchronizeClocks(int rounds) {
+    rounds = std::max(1, rounds);
+    m_clockOffset = 0;
+    m_roundTrip = 0;
+
+    // Rank 0 answers each peer in turn with its current time
+    for (int peer = 1; peer < m_worldSize; ++peer) {
+        if (m_rank == 0) {
+            for (int round = 0; round < rounds; ++round) {
+                uint64_t ping = 0;
+                MPI_Recv(&ping, 1, MPI_UINT64_T, peer, kClockSyncTag, m_communicator, MPI_STATUS_IGNORE);
+                uint64_t rootTime = PerformanceTracker::now();
+                MPI_Send(&rootTime, 1, MPI_UINT64_T, peer, kClockSyncTag, m_communicator);
+            }
+        } else if (m_rank == peer) {
+            m_roundTrip = std::numeric_limits<uint64_t>::max();
+            for (int round = 0; round < rounds; ++round) {
+                uint64_t sent = PerformanceTracker::now();
+                uint64_t rootTime = 0;
+                MPI_Send(&sent, 1, MPI_UINT64_T, 0, kClockSyncTag, m_communicator);
+                MPI_Recv(&rootTime, 1, MPI_UINT64_T, 0, kClockSyncTag, m_communicator, MPI_STATUS_IGNORE);
+                uint64_t received = PerformanceTracker::now();
+
+                // The tightest exchange bounds the offset error best
+                uint64_t roundTrip = received - sent;
+                if (roundTrip < m_roundTrip) {
+                    m_roundTrip = roundTrip;
+                    m_clockOffset = static_cast<int64_t>(rootTime) -
+                                    static_cast<int64_t>(sent + roundTrip / 2);
+                }
+            }
+        }
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "Clock offset to rank 0: " << m_clockOffset << "ns (round trip "
+                            << m_roundTrip << "ns)";
+}
+
+size_t TimelineRecorder::write(const std::string& path, const PerformanceTracker& tracker) const {
+    // Shift local spans onto rank 0's clock before they leave the rank
+    std::vector<TimelineEvent> events = tracker.timeline();
+    for (auto& event : events) {
+        event.startNanos = static_cast<uint64_t>(static_cast<int64_t>(event.startNanos) + m_clockOffset);
+    }
+
+    // Ids are only meaningful with the rank's own name table
+    std::string names;
+    for (const auto& name : tracker.metricNames()) {
+        names += name;
+        names += '\n';
+    }
+
+    int localSizes[2] = {
+        static_cast<int>(events.size() * sizeof(TimelineEvent)),
+        static_cast<int>(names.size())
+    };
+    std::vector<int> sizes(m_rank == 0 ? 2 * m_worldSize : 0);
+    MPI_Gather(localSizes, 2, MPI_INT, sizes.data(), 2, MPI_INT, 0, m_communicator);
+
+    std::vector<int> eventBytes(m_rank == 0 ? m_worldSize : 0);
+    std::vector<int> nameBytes(m_rank == 0 ? m_worldSize : 0);
+    for (int rank = 0; rank < static_cast<int>(eventBytes.size()); ++rank) {
+        eventBytes[rank] = sizes[2 * rank];
+        nameBytes[rank] = sizes[2 * rank + 1];
+    }
+    std::vector<int> eventOffsets(eventBytes.size(), 0);
+    std::vector<int> nameOffsets(nameBytes.size(), 0);
+    for (size_t rank = 1; rank < eventBytes.size(); ++rank) {
+        eventOffsets[rank] = eventOffsets[rank - 1] + eventBytes[rank - 1];
+        nameOffsets[rank] = nameOffsets[rank - 1] + nameBytes[rank - 1];
+    }
+
+    std::vector<char> allEvents(m_rank == 0 ? std::accumulate(eventBytes.begin(), eventBytes.end(), size_t{0}) : 0);
+    std::vector<char> allNames(m_rank == 0 ? std::accumulate(nameBytes.begin(), nameBytes.end(), size_t{0}) : 0);
+    MPI_Gatherv(
+        events.data(),
+        localSizes[0],
+        MPI_BYTE,
+        allEvents.data(),
+        eventBytes.data(),
+        eventOffsets.data(),
+        MPI_BYTE,
+        0,
+        m_communicator
+    );
+    MPI_Gatherv(
+        names.data(),
+        localSizes[1],
+        MPI_CHAR,
+        allNames.data(),
+        nameBytes.data(),
+        nameOffsets.data(),
+        MPI_CHAR,
+        0,
+        m_communicator
+    );
+
+    if (m_rank != 0) {
+        return 0;
+    }
+
+    const auto* merged = reinterpret_cast<const TimelineEvent*>(allEvents.data());
+    const size_t eventCount = allEvents.size() / sizeof(TimelineEvent);
+
+    // Timestamps start at the earliest span across all ranks
+    uint64_t origin = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < eventCount; ++i) {
+        origin = std::min(origin, merged[i].startNanos);
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        BOOST_LOG_TRIVIAL(error) << "Failed to open trace file " << path;
+        throw std::runtime_error("Cannot write trace file");
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&out, &first]() {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+    };
+
+    for (int rank = 0; rank < m_worldSize; ++rank) {
+        separator();
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+            << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+
+        std::vector<std::string> rankNames;
+        std::istringstream nameStream(std::string(allNames.data() + nameOffsets[rank], nameBytes[rank]));
+        for (std::string name; std::getline(nameStream, name);) {
+            rankNames.push_back(nlohmann::json(name).dump());
+        }
+
+        const TimelineEvent* begin = merged + eventOffsets[rank] / sizeof(TimelineEvent);
+        const TimelineEvent* end = begin + eventBytes[rank] / sizeof(TimelineEvent);
+        uint32_t threads = 0;
+        for (const TimelineEvent* event = begin; event != end; ++event) {
+            separator();
+            out << "{\"name\":" << (event->id < rankNames.size() ? rankNames[event->id] : "\"unknown\"")
+                << ",\"ph\":\"X\",\"pid\":" << rank << ",\"tid\":" << event->thread
+                << ",\"ts\":" << (event->startNanos - origin) / 1000.0
+                << ",\"dur\":" << event->durationNanos / 1000.0
+                << ",\"args\":{\"depth\":" << event->depth << "}}";
+            threads = std::max(threads, event->thread + 1);
+        }
+
+        for (uint32_t thread = 0; thread < threads; ++thread) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << rank << ",\"tid\":" << thread
+                << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+        }
+    }
+    out << "]}\n";
+
+    BOOST_LOG_TRIVIAL(info) << "Wrote " << eventCount << " timeline events from " << m_worldSize
+                            << " rank(s) to " << path;
+    return eventCount;
+}
+
+} // namespace DistributedML
@@ -0,0 +1,83 @@
+#include "../include/sample_shard.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <opencv2/opencv.hpp>
+
+namespace fs = boost::filesystem;
+
+// Build a training shard from an image directory laid out as
+// <root>/<class name>/<image>. Classes are labelled in sorted order.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <image_root> <output.shard> [rows] [cols] [channels]" << std::endl;
+        return 1;
+    }
+
+    const fs::path imageRoot(argv[1]);
+    const std::string outputPath(argv[2]);
+    const int rows = argc > 3 ? std::stoi(argv[3]) : 28;
+    const int cols = argc > 4 ? std::stoi(argv[4]) : 28;
+    const int channels = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    try {
+        if (!fs::is_directory(imageRoot)) {
+            throw std::invalid_argument("Not a directory: " + imageRoot.string());
+        }
+        if (channels != 1 && channels != 3) {
+            throw std::invalid_argument("Channels must be 1 or 3");
+        }
+
+        std::vector<fs::path> classDirectories;
+        for (const auto& entry : fs::directory_iterator(imageRoot)) {
+            if (fs::is_directory(entry.path())) {
+                classDirectories.push_back(entry.path());
+            }
+        }
+        std::sort(classDirectories.begin(), classDirectories.end());
+
+        DistributedML::ShardWriter writer(outputPath, rows, cols, channels);
+        const int readMode = channels == 1 ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+
+        for (size_t label = 0; label < classDirectories.size(); ++label) {
+            std::vector<fs::path> images;
+            for (const auto& entry : fs::directory_iterator(classDirectories[label])) {
+                if (fs::is_regular_file(entry.path())) {
+                    images.push_back(entry.path());
+                }
+            }
+            std::sort(images.begin(), images.end());
+
+            for (const auto& imagePath : images) {
+                cv::Mat image = cv::imread(imagePath.string(), readMode);
+                if (image.empty()) {
+                    std::cerr << "Skipping unreadable image " << imagePath << std::endl;
+                    continue;
+                }
+
+                cv::Mat resized;
+                cv::resize(image, resized, cv::Size(cols, rows));
+
+                // Scale 8-bit pixels into [0, 1]
+                cv::Mat sample;
+                resized.convertTo(sample, CV_32FC(channels), 1.0 / 255.0);
+                writer.append(sample, static_cast<int>(label));
+            }
+
+            std::cout << classDirectories[label].filename().string()
+                      << " -> label " << label << std::endl;
+        }
+
+        writer.finish();
+        std::cout << "Wrote " << writer.sampleCount() << " samples to " << outputPath << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}